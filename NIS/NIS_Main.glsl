@@ -38,6 +38,10 @@
 #define NIS_SCALER 1
 #endif
 
+#ifndef NIS_BUFFER_IO
+#define NIS_BUFFER_IO 0
+#endif
+
 layout(set=0,binding=0) uniform const_buffer
 {
     float kDetectRatio;
@@ -77,18 +81,84 @@ layout(set=0,binding=0) uniform const_buffer
     float reserved1;
 };
 
+#if NIS_BUFFER_IO
+// Packed RGBA8 pixels in storage buffers instead of textures, rows kInputViewportWidth
+// and kOutputViewportWidth pixels apart. Sampling is done by hand: clamp to edge
+// addressing and bilinear filtering, as the linear clamp sampler would.
+layout(set=0,binding=2) readonly buffer in_buffer_block { uint in_buffer[]; };
+layout(set=0,binding=3) writeonly buffer out_buffer_block { uint out_buffer[]; };
+
+vec4 NISBufferLoad(ivec2 pos)
+{
+    pos = clamp(pos, ivec2(0), ivec2(kInputViewportWidth, kInputViewportHeight) - 1);
+    return unpackUnorm4x8(in_buffer[uint(pos.y) * kInputViewportWidth + uint(pos.x)]);
+}
+
+vec4 NISBufferSample(vec2 uv)
+{
+    vec2 p = uv * vec2(kInputViewportWidth, kInputViewportHeight) - 0.5f;
+    ivec2 i = ivec2(floor(p));
+    vec2 f = fract(p);
+    vec4 top = mix(NISBufferLoad(i), NISBufferLoad(i + ivec2(1, 0)), f.x);
+    vec4 bottom = mix(NISBufferLoad(i + ivec2(0, 1)), NISBufferLoad(i + ivec2(1, 1)), f.x);
+    return mix(top, bottom, f.y);
+}
+
+void NISBufferStore(vec2 pos, vec4 v)
+{
+    uvec2 p = uvec2(pos);
+    if (p.x < kOutputViewportWidth && p.y < kOutputViewportHeight)
+        out_buffer[p.y * kOutputViewportWidth + p.x] = packUnorm4x8(v);
+}
+
+#define NVTEX_SAMPLE(x, sampler, pos) NISBufferSample(pos)
+#define NVTEX_STORE(x, pos, v) NISBufferStore(pos, v)
+#else
 layout(set=0,binding=1) uniform sampler samplerLinearClamp;
+#if NIS_NV12_SUPPORT && NIS_NV12_LUMA_OUTPUT
+// Luma plane in and sharpened luma out, R8 images
+layout(set=0,binding=2) uniform texture2D in_texture_y;
+#else
 layout(set=0,binding=2) uniform texture2D in_texture;
+#endif
 layout(set=0,binding=3) uniform writeonly image2D out_texture;
+#endif
 
 #if NIS_SCALER
 layout(set=0,binding=4) uniform texture2D coef_scaler;
 layout(set=0,binding=5) uniform texture2D coef_usm;
 #endif
 
+#ifndef NIS_BLOCK_WIDTH
+#define NIS_BLOCK_WIDTH 32
+#endif
+#ifndef NIS_BLOCK_HEIGHT
+#if NIS_SCALER
+#define NIS_BLOCK_HEIGHT 24
+#else
+#define NIS_BLOCK_HEIGHT 32
+#endif
+#endif
+#ifndef NIS_THREAD_GROUP_SIZE
+#define NIS_THREAD_GROUP_SIZE 256
+#endif
+
+// Block width, block height and thread group size are specialization constants 0, 1
+// and 2, so one module runs with whatever sizes the pipeline picks. The values above
+// are only their defaults; the shared memory arrays are sized from the constants.
+#define NIS_SPECIALIZATION_CONSTANTS 1
+layout(constant_id = 0) const int kSpecBlockWidth = NIS_BLOCK_WIDTH;
+layout(constant_id = 1) const int kSpecBlockHeight = NIS_BLOCK_HEIGHT;
+layout(local_size_x = NIS_THREAD_GROUP_SIZE, local_size_x_id = 2) in;
+#undef NIS_BLOCK_WIDTH
+#undef NIS_BLOCK_HEIGHT
+#undef NIS_THREAD_GROUP_SIZE
+#define NIS_BLOCK_WIDTH kSpecBlockWidth
+#define NIS_BLOCK_HEIGHT kSpecBlockHeight
+#define NIS_THREAD_GROUP_SIZE int(gl_WorkGroupSize.x)
+
 #include "NIS_Scaler.h"
 
-layout(local_size_x=NIS_THREAD_GROUP_SIZE) in;
 void main()
 {
     #if NIS_SCALER
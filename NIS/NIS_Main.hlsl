@@ -35,6 +35,10 @@
 #define NIS_DXC 0
 #endif
 
+#ifndef NIS_BUFFER_IO
+#define NIS_BUFFER_IO 0
+#endif
+
 #if NIS_DXC
 #define NIS_PUSH_CONSTANT    [[vk::push_constant]]
 #define NIS_BINDING(bindingIndex) [[vk::binding(bindingIndex, 0)]]
@@ -83,7 +87,56 @@ NIS_BINDING(0) cbuffer cb : register(b0)
     float reserved1;
 };
 
+#if NIS_BUFFER_IO
+// Packed RGBA8 pixels in storage buffers instead of textures, rows kInputViewportWidth
+// and kOutputViewportWidth pixels apart. Sampling is done by hand: clamp to edge
+// addressing and bilinear filtering, as the linear clamp sampler would.
+NIS_BINDING(2) StructuredBuffer<uint> in_buffer    : register(t0);
+NIS_BINDING(3) RWStructuredBuffer<uint> out_buffer : register(u0);
+
+float4 NISUnpackRGBA8(uint v)
+{
+    return float4(v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, v >> 24) * (1.0f / 255.0f);
+}
+
+uint NISPackRGBA8(float4 v)
+{
+    uint4 c = uint4(round(saturate(v) * 255.0f));
+    return c.x | (c.y << 8) | (c.z << 16) | (c.w << 24);
+}
+
+float4 NISBufferLoad(int2 pos)
+{
+    pos = clamp(pos, int2(0, 0), int2(kInputViewportWidth, kInputViewportHeight) - 1);
+    return NISUnpackRGBA8(in_buffer[uint(pos.y) * kInputViewportWidth + uint(pos.x)]);
+}
+
+float4 NISBufferSample(float2 uv)
+{
+    float2 p = uv * float2(kInputViewportWidth, kInputViewportHeight) - 0.5f;
+    int2 i = int2(floor(p));
+    float2 f = p - floor(p);
+    float4 top = lerp(NISBufferLoad(i), NISBufferLoad(i + int2(1, 0)), f.x);
+    float4 bottom = lerp(NISBufferLoad(i + int2(0, 1)), NISBufferLoad(i + int2(1, 1)), f.x);
+    return lerp(top, bottom, f.y);
+}
+
+void NISBufferStore(float2 pos, float4 v)
+{
+    uint2 p = uint2(pos);
+    if (p.x < kOutputViewportWidth && p.y < kOutputViewportHeight)
+        out_buffer[p.y * kOutputViewportWidth + p.x] = NISPackRGBA8(v);
+}
+
+#define NVTEX_SAMPLE(x, sampler, pos) NISBufferSample(pos)
+#define NVTEX_STORE(x, pos, v) NISBufferStore(pos, v)
+#else
 NIS_BINDING(1) SamplerState samplerLinearClamp : register(s0);
+#if NIS_NV12_SUPPORT && NIS_NV12_LUMA_OUTPUT
+// Luma plane in and sharpened luma out, R8 images
+NIS_BINDING(2) Texture2D<float> in_texture_y   : register(t0);
+NIS_BINDING(3) RWTexture2D<float> out_texture  : register(u0);
+#else
 #if NIS_NV12_SUPPORT
 NIS_BINDING(2) Texture2D<float> in_texture_y   : register(t0);
 NIS_BINDING(2) Texture2D<float2> in_texture_uv : register(t3);
@@ -91,6 +144,8 @@ NIS_BINDING(2) Texture2D<float2> in_texture_uv : register(t3);
 NIS_BINDING(2) Texture2D in_texture            : register(t0);
 #endif
 NIS_BINDING(3) RWTexture2D<float4> out_texture : register(u0);
+#endif
+#endif
 #if NIS_SCALER
 NIS_BINDING(4) Texture2D coef_scaler           : register(t1);
 NIS_BINDING(5) Texture2D coef_usm              : register(t2);
@@ -98,6 +153,8 @@ NIS_BINDING(5) Texture2D coef_usm              : register(t2);
 
 
 
+// Unlike NIS_Main.glsl the block and thread group sizes stay compile time defines: DXC
+// can not size groupshared arrays or numthreads from specialization constants.
 #include "NIS_Scaler.h"
 
 [numthreads(NIS_THREAD_GROUP_SIZE, 1, 1)]
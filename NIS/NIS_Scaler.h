@@ -98,7 +98,10 @@
 // NIS_GLSL: (1) enabled, (0) disabled
 // NIS_VIEWPORT_SUPPORT: default(0) disabled, (1) enable input/output viewport support
 // NIS_NV12_SUPPORT: default(0) disabled, (1) enable NV12 input
+// NIS_NV12_LUMA_OUTPUT: default(0) disabled, (1) NVSharpen with NV12 input stores the sharpened luma only
 // NIS_CLAMP_OUTPUT: default(0) disabled, (1) enable output clamp
+// NIS_SPECIALIZATION_CONSTANTS: default(0) disabled, (1) NIS_BLOCK_WIDTH, NIS_BLOCK_HEIGHT and NIS_THREAD_GROUP_SIZE
+//                               are specialization constants rather than literals (GLSL only)
 //
 // Default NVScaler shader constants:
 // [NIS_BLOCK_WIDTH, NIS_BLOCK_HEIGHT, NIS_THREAD_GROUP_SIZE] = [32, 24, 256]
@@ -180,11 +183,15 @@
 #endif // NIS_USE_HALF_PRECISION
 #define NVSHARED groupshared
 #define NVTEX_LOAD(x, pos) x[pos]
+#ifndef NVTEX_SAMPLE
 #define NVTEX_SAMPLE(x, sampler, pos) x.SampleLevel(sampler, pos, 0)
+#endif
 #define NVTEX_SAMPLE_RED(x, sampler, pos) x.GatherRed(sampler, pos)
 #define NVTEX_SAMPLE_GREEN(x, sampler, pos) x.GatherGreen(sampler, pos)
 #define NVTEX_SAMPLE_BLUE(x, sampler, pos) x.GatherBlue(sampler, pos)
+#ifndef NVTEX_STORE
 #define NVTEX_STORE(x, pos, v) x[pos] = v
+#endif
 #ifndef NIS_UNROLL
 #define NIS_UNROLL [unroll]
 #endif
@@ -214,11 +221,15 @@
 #endif  // NIS_USE_HALF_PRECISION
 #define NVSHARED shared
 #define NVTEX_LOAD(x, pos) texelFetch(sampler2D(x, samplerLinearClamp), pos, 0)
+#ifndef NVTEX_SAMPLE
 #define NVTEX_SAMPLE(x, sampler, pos) textureLod(sampler2D(x, sampler), pos, 0)
+#endif
 #define NVTEX_SAMPLE_RED(x, sampler, pos) textureGather(sampler2D(x, sampler), pos, 0)
 #define NVTEX_SAMPLE_GREEN(x, sampler, pos) textureGather(sampler2D(x, sampler), pos, 1)
 #define NVTEX_SAMPLE_BLUE(x, sampler, pos) textureGather(sampler2D(x, sampler), pos, 2)
+#ifndef NVTEX_STORE
 #define NVTEX_STORE(x, pos, v) imageStore(x, NVI2(pos), v)
+#endif
 #define saturate(x) clamp(x, 0, 1)
 #define lerp(a, b, x) mix(a, b, x)
 #define GroupMemoryBarrierWithGroupSync() groupMemoryBarrier(); barrier()
@@ -357,7 +368,10 @@ void LoadFilterBanksSh(NVI i0) {
     // Load up filter banks to shared memory
     // The work is spread over (kPhaseCount * 2) threads
     NVI i = i0;
-#if( kPhaseCount * 2 > NIS_THREAD_GROUP_SIZE )
+#if NIS_SPECIALIZATION_CONSTANTS
+    // The thread group size is not known to the preprocessor
+    for (; i < kPhaseCount * 2; i += NIS_THREAD_GROUP_SIZE)
+#elif( kPhaseCount * 2 > NIS_THREAD_GROUP_SIZE )
     for (; i < kPhaseCount * 2; i += NIS_THREAD_GROUP_SIZE)
 #else
     if (i < kPhaseCount * 2)
@@ -943,7 +957,7 @@ void NVSharpen(NVU2 blockIdx, NVU threadIdx)
                 const NVF ty = (dstBlockY + pos.y + dy + kShift) * kSrcNormY;
 #endif
 #if NIS_NV12_SUPPORT
-                shPixelsY[pos.y + dy][pos.x + dx] = NVTEX_SAMPLE(in_texture_y, samplerLinearClamp, NVF2(tx, ty));
+                shPixelsY[pos.y + dy][pos.x + dx] = NVTEX_SAMPLE(in_texture_y, samplerLinearClamp, NVF2(tx, ty)).x;
 #else
                 const NVF4 px = NVTEX_SAMPLE(in_texture, samplerLinearClamp, NVF2(tx, ty));
                 shPixelsY[pos.y + dy][pos.x + dx] = getY(px.xyz);
@@ -992,9 +1006,14 @@ void NVSharpen(NVU2 blockIdx, NVU threadIdx)
         NVF2 dstCoord = NVF2(dstX, dstY);
 #endif
         {
+#if NIS_NV12_SUPPORT && NIS_NV12_LUMA_OUTPUT
+            // Chroma is left to the caller, only the luma plane is written
+            const NVF y = NVTEX_SAMPLE(in_texture_y, samplerLinearClamp, coord).x;
+            NVTEX_STORE(out_texture, dstCoord, NVCLAMP(NVF4(y + usmY, 0.0f, 0.0f, 1.0f)));
+#else
 #if NIS_NV12_SUPPORT
-            NVF y = NVTEX_SAMPLE(in_texture_y, samplerLinearClamp, coord);
-            NVF2 uv = NVTEX_SAMPLE(in_texture_uv, samplerLinearClamp, coord);
+            NVF y = NVTEX_SAMPLE(in_texture_y, samplerLinearClamp, coord).x;
+            NVF2 uv = NVTEX_SAMPLE(in_texture_uv, samplerLinearClamp, coord).xy;
             NVF4 op = NVF4(YUVtoRGB(NVF3(y, uv)), 1.0f);
 #else
             NVF4 op = NVTEX_SAMPLE(in_texture, samplerLinearClamp, coord);
@@ -1014,6 +1033,7 @@ void NVSharpen(NVU2 blockIdx, NVU threadIdx)
             op.z += usmY;
 #endif
             NVTEX_STORE(out_texture, dstCoord, NVCLAMP(op));
+#endif
         }
     }
 }
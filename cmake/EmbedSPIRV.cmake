@@ -0,0 +1,49 @@
+# Writes OUTPUT, a C++ source holding every SPIR-V module in SHADERS ("|" separated) as a
+# constexpr uint32_t array, and the EmbeddedShaders table of src/vulkan/vulkan_shaders.h
+# naming them by file name. Runs with cmake -P as a build step that depends on the modules.
+if(NOT OUTPUT OR NOT SHADERS)
+    message(FATAL_ERROR "Usage: cmake -DSHADERS=<a.spv|b.spv> -DOUTPUT=<file.cpp> -P EmbedSPIRV.cmake")
+endif()
+string(REPLACE "|" ";" SHADERS "${SHADERS}")
+
+set(ARRAYS "")
+set(TABLE "")
+foreach(SHADER ${SHADERS})
+    get_filename_component(SHADER_NAME "${SHADER}" NAME)
+    string(MAKE_C_IDENTIFIER "${SHADER_NAME}" SHADER_IDENTIFIER)
+
+    file(READ "${SHADER}" HEX HEX)
+    string(LENGTH "${HEX}" HEX_LENGTH)
+    math(EXPR REMAINDER "${HEX_LENGTH} % 8")
+    if(HEX_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0)
+        message(FATAL_ERROR "${SHADER} is not a whole number of SPIR-V words")
+    endif()
+    # glslc and dxc write little endian words, which is what the arrays are read as
+    if(NOT HEX MATCHES "^03022307")
+        message(FATAL_ERROR "${SHADER} does not start with the little endian SPIR-V magic number")
+    endif()
+
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " WORDS "${HEX}")
+    # Eight words a line, CMake regular expressions have no {n}
+    set(LINE "0x........, 0x........, 0x........, 0x........, 0x........, 0x........, 0x........, 0x........, ")
+    string(REGEX REPLACE "(${LINE})" "\\1\n        " WORDS "${WORDS}")
+    string(REGEX REPLACE "[, \n]+$" "" WORDS "${WORDS}")
+    string(REPLACE " \n" "\n" WORDS "${WORDS}")
+
+    string(APPEND ARRAYS "    constexpr uint32_t ${SHADER_IDENTIFIER}[] = {\n        ${WORDS}\n    };\n")
+    string(APPEND TABLE "    { \"${SHADER_NAME}\", ${SHADER_IDENTIFIER}, std::size(${SHADER_IDENTIFIER}) },\n")
+endforeach()
+
+file(WRITE "${OUTPUT}"
+        "// Generated by cmake/EmbedSPIRV.cmake from the compiled shaders, do not edit\n"
+        "#include \"vulkan/vulkan_shaders.h\"\n"
+        "\n"
+        "namespace\n"
+        "{\n"
+        "${ARRAYS}"
+        "}\n"
+        "\n"
+        "const EmbeddedShader EmbeddedShaders[] = {\n"
+        "${TABLE}"
+        "};\n"
+        "const size_t EmbeddedShaderCount = std::size(EmbeddedShaders);\n")
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <unordered_map>
+
+#include "benchmark.h"
+#include "pipeline/atlas_batcher.h"
+
+namespace
+{
+    constexpr uint32_t ImageCount = 1024;
+    constexpr uint32_t AtlasSize = 2048;
+
+    using OutputHashes = std::unordered_map<std::string, uint64_t>;
+
+    // Thumbnail sized inputs of a few different shapes, so the packer has to mix them
+    std::vector<HostImage> CreateInputs()
+    {
+        static constexpr uint32_t sizes[][2] = { {128, 128}, {96, 128}, {128, 72}, {64, 64}, {160, 120} };
+        std::vector<HostImage> inputs;
+        inputs.reserve(ImageCount);
+        for (uint32_t i = 0; i < ImageCount; ++i)
+        {
+            const auto& size = sizes[i % std::size(sizes)];
+            inputs.push_back(CreateSyntheticImage(size[0], size[1], i));
+        }
+        return inputs;
+    }
+
+    void Report(const char* label, std::chrono::steady_clock::duration elapsed)
+    {
+        const double seconds = std::chrono::duration<double>(elapsed).count();
+        std::cout << label << ": " << ImageCount << " images in " << seconds * 1000.0 << " ms, "
+                  << ImageCount / seconds << " images/s" << std::endl;
+    }
+
+    void Run(const BenchmarkOptions& options)
+    {
+        VkNVSharpen sharpen(options.FramesInFlight, options.ImageCacheBudget);
+        sharpen.SetSharpness(options.Sharpness);
+
+        auto hashInto = [](OutputHashes& hashes)
+        {
+            return [&hashes](const ReadbackResult& result)
+            {
+                hashes[result.OutputPath] = HashPixels(result.Data, result.Width, result.Height, result.RowPitch);
+            };
+        };
+
+        // One warm-up pass of each path fills the image cache and staging rings so the
+        // timed passes measure steady state
+        OutputHashes perImage;
+        sharpen.SetCompletionHandler(hashInto(perImage));
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            perImage.clear();
+            std::vector<HostImage> inputs = CreateInputs();
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& image : inputs)
+                sharpen.Submit(image);
+            sharpen.Flush();
+            if (pass == 1)
+                Report("Per-image", std::chrono::steady_clock::now() - start);
+        }
+
+        OutputHashes atlased;
+        AtlasOptions atlasOptions;
+        atlasOptions.Size = AtlasSize;
+        AtlasBatcher batcher(sharpen, atlasOptions);
+        batcher.SetCompletionHandler(hashInto(atlased));
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            atlased.clear();
+            // The batcher takes the inputs and keeps them until their atlas is submitted
+            std::vector<HostImage> inputs = CreateInputs();
+            auto start = std::chrono::steady_clock::now();
+            for (auto& image : inputs)
+                batcher.Submit(std::move(image));
+            batcher.Flush();
+            if (pass == 1)
+                Report("Atlas", std::chrono::steady_clock::now() - start);
+        }
+        std::cout << "Atlases: " << batcher.GetAtlasCount() / 2 << " per pass of " << AtlasSize << "x" << AtlasSize << std::endl;
+
+        uint32_t mismatches = 0;
+        for (const auto& [path, hash] : perImage)
+        {
+            auto it = atlased.find(path);
+            if (it == atlased.end() || it->second != hash)
+                mismatches++;
+        }
+        std::cout << "Outputs differing from the per-image path: " << mismatches << " of " << ImageCount << std::endl;
+    }
+
+    BenchmarkRegistration s_Registration("atlas",
+            "Sharpen 1024 thumbnails one by one and packed into atlases, compare images/s and outputs",
+            &Run);
+}
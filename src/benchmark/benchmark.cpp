@@ -0,0 +1,135 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+
+namespace
+{
+    struct BenchmarkEntry
+    {
+        std::string Description;
+        BenchmarkFunction Function;
+    };
+
+    std::map<std::string, BenchmarkEntry>& GetRegistry()
+    {
+        static std::map<std::string, BenchmarkEntry> registry;
+        return registry;
+    }
+}
+
+BenchmarkRegistration::BenchmarkRegistration(const std::string& name, const std::string& description, BenchmarkFunction function)
+{
+    GetRegistry()[name] = { description, std::move(function) };
+}
+
+bool RunBenchmark(const std::string& name, const BenchmarkOptions& options)
+{
+    auto it = GetRegistry().find(name);
+    if (it == GetRegistry().end())
+        return false;
+
+    it->second.Function(options);
+    return true;
+}
+
+void PrintBenchmarks(std::ostream& os)
+{
+    for (const auto& [name, entry] : GetRegistry())
+        os << "  " << name << ": " << entry.Description << std::endl;
+}
+
+HostImage CreateSyntheticImage(uint32_t width, uint32_t height, uint32_t seed)
+{
+    HostImage image;
+    image.OutputPath = "synthetic#" + std::to_string(seed);
+    image.Width = width;
+    image.Height = height;
+    image.RowPitch = width * 4;
+    image.Data.resize(size_t(image.RowPitch) * height);
+
+    uint32_t state = seed * 2654435761u + 1;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        uint8_t* row = image.Data.data() + size_t(y) * image.RowPitch;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            const uint32_t noise = state & 0x1F;
+            row[x * 4 + 0] = uint8_t((x * 255 / width + noise) & 0xFF);
+            row[x * 4 + 1] = uint8_t((y * 255 / height + noise) & 0xFF);
+            row[x * 4 + 2] = uint8_t(((x ^ y) + seed) & 0xFF);
+            row[x * 4 + 3] = 255;
+        }
+    }
+    return image;
+}
+
+uint64_t HashPixels(const uint8_t* data, uint32_t width, uint32_t height, uint32_t rowPitch)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = data + size_t(y) * rowPitch;
+        for (size_t i = 0; i < size_t(width) * 4; ++i)
+        {
+            hash ^= row[i];
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+std::vector<uint8_t> CopyPixels(const ReadbackResult& result)
+{
+    const size_t rowBytes = size_t(result.Width) * result.Channels;
+    std::vector<uint8_t> pixels(rowBytes * result.Height);
+    for (uint32_t y = 0; y < result.Height; ++y)
+        std::copy_n(result.Data + size_t(y) * result.RowPitch, rowBytes, pixels.data() + y * rowBytes);
+    return pixels;
+}
+
+int MaxChannelDifference(const std::vector<uint8_t>& reference, const ReadbackResult& result)
+{
+    int difference = 0;
+    const size_t rowBytes = size_t(result.Width) * result.Channels;
+    for (uint32_t y = 0; y < result.Height; ++y)
+    {
+        const uint8_t* row = result.Data + size_t(y) * result.RowPitch;
+        const uint8_t* expected = reference.data() + y * rowBytes;
+        for (size_t x = 0; x < rowBytes; ++x)
+            difference = std::max(difference, std::abs(int(row[x]) - int(expected[x])));
+    }
+    return difference;
+}
+
+void FirstImageComparison::OnReadback(const ReadbackResult& result)
+{
+    if (!m_First)
+        return;
+    m_First = false;
+    if (m_Reference)
+        m_ReferencePixels = CopyPixels(result);
+    else
+        m_Difference = MaxChannelDifference(m_ReferencePixels, result);
+}
+
+double TimeSubmissions(VkNVSharpen& sharpen, const std::vector<HostImage>& inputs, const std::function<void()>& beginPass)
+{
+    double ms = 0.0;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        if (beginPass)
+            beginPass();
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& image : inputs)
+            sharpen.Submit(image);
+        sharpen.Flush();
+        ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return ms;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "vk_nv_sharpen.h"
+
+struct BenchmarkOptions
+{
+    uint32_t FramesInFlight = VkNVSharpen::DefaultFramesInFlight;
+    VkDeviceSize ImageCacheBudget = VkNVSharpen::DefaultImageCacheBudget;
+    float Sharpness = 100.0f;
+};
+
+// A batch of synthetic images of one size
+struct BenchmarkResolution
+{
+    const char* Name;
+    uint32_t Width, Height;
+    uint32_t ImageCount;
+};
+
+using BenchmarkFunction = std::function<void(const BenchmarkOptions&)>;
+
+// Benchmarks register themselves from their own translation unit:
+//     static BenchmarkRegistration s_Registration("name", "description", &Run);
+struct BenchmarkRegistration
+{
+    BenchmarkRegistration(const std::string& name, const std::string& description, BenchmarkFunction function);
+};
+
+// Runs the named benchmark. Returns false when no benchmark has that name.
+bool RunBenchmark(const std::string& name, const BenchmarkOptions& options);
+void PrintBenchmarks(std::ostream& os);
+
+// Deterministic noisy gradient, so sharpening has edges to work on
+HostImage CreateSyntheticImage(uint32_t width, uint32_t height, uint32_t seed);
+// FNV-1a over the visible pixels of each row, ignoring row padding
+uint64_t HashPixels(const uint8_t* data, uint32_t width, uint32_t height, uint32_t rowPitch);
+
+// Copy of a readback's visible pixels without row padding, a reference for MaxChannelDifference
+std::vector<uint8_t> CopyPixels(const ReadbackResult& result);
+// Largest difference of any channel between a readback and a CopyPixels copy of the same size
+int MaxChannelDifference(const std::vector<uint8_t>& reference, const ReadbackResult& result);
+// Compares the first image of a pass against the first image of the reference pass,
+// the rest of each pass is only timed. Feed it every readback from the completion handler.
+class FirstImageComparison
+{
+public:
+    // A reference pass replaces the reference image
+    void BeginPass(bool reference) { m_Reference = reference; m_First = true; }
+    void OnReadback(const ReadbackResult& result);
+    // MaxChannelDifference of the last compared pass
+    [[nodiscard]] int GetDifference() const { return m_Difference; }
+
+private:
+    std::vector<uint8_t> m_ReferencePixels;
+    bool m_Reference = true;
+    bool m_First = true;
+    int m_Difference = 0;
+};
+
+// Submits the images and flushes twice, beginPass running before each pass, and returns
+// the wall time of the second in milliseconds. The first fills the image cache and the
+// staging rings.
+double TimeSubmissions(VkNVSharpen& sharpen, const std::vector<HostImage>& inputs, const std::function<void()>& beginPass = {});
@@ -0,0 +1,50 @@
+#include <iomanip>
+#include <iostream>
+
+#include "benchmark.h"
+
+namespace
+{
+    constexpr BenchmarkResolution Resolutions[] = {
+            { "1080p", 1920, 1080, 16 },
+            { "4K", 3840, 2160, 8 },
+            { "8K", 7680, 4320, 4 } };
+
+    void Run(const BenchmarkOptions& options)
+    {
+        VkNVSharpen sharpen(options.FramesInFlight, options.ImageCacheBudget);
+        sharpen.SetSharpness(options.Sharpness);
+        // Whole images on both paths, 8K would otherwise be tiled
+        sharpen.SetTileSize(0);
+
+        for (const BenchmarkResolution& resolution : Resolutions)
+        {
+            std::vector<HostImage> inputs;
+            for (uint32_t i = 0; i < resolution.ImageCount; ++i)
+                inputs.push_back(CreateSyntheticImage(resolution.Width, resolution.Height, i));
+
+            // The image pass is the reference
+            FirstImageComparison comparison;
+            sharpen.SetCompletionHandler([&](const ReadbackResult& result) { comparison.OnReadback(result); });
+            for (bool bufferIO : { false, true })
+            {
+                sharpen.SetBufferIO(bufferIO);
+                const double ms = TimeSubmissions(sharpen, inputs, [&] { comparison.BeginPass(!bufferIO); });
+
+                std::cout << std::left << std::setw(6) << resolution.Name << (bufferIO ? "buffers" : "images ") << ": "
+                          << resolution.ImageCount << " x " << resolution.Width << "x" << resolution.Height
+                          << " in " << std::fixed << std::setprecision(2) << ms << " ms, "
+                          << std::setprecision(1) << resolution.ImageCount * 1000.0 / ms << " images/s";
+                if (bufferIO)
+                    std::cout << ", max difference " << comparison.GetDifference();
+                std::cout << std::endl;
+            }
+        }
+        sharpen.SetBufferIO(false);
+        sharpen.SetCompletionHandler(nullptr);
+    }
+
+    BenchmarkRegistration s_Registration("buffer-io",
+            "Sharpening through images against the storage buffer variant at 1080p, 4K and 8K",
+            &Run);
+}
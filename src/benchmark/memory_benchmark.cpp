@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "benchmark.h"
+#include "vulkan/vulkan_utils.h"
+
+namespace
+{
+    constexpr VkDeviceSize BufferSize = 64ull * 1024 * 1024;
+    constexpr int Repetitions = 5;
+    constexpr uint32_t ImageCount = 16;
+    constexpr uint32_t ImageSize = 2048;
+
+    std::string DescribeFlags(VkMemoryPropertyFlags flags)
+    {
+        static const std::pair<VkMemoryPropertyFlags, const char*> names[] = {
+                { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "DEVICE_LOCAL" },
+                { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "HOST_VISIBLE" },
+                { VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "HOST_COHERENT" },
+                { VK_MEMORY_PROPERTY_HOST_CACHED_BIT, "HOST_CACHED" } };
+        std::string description;
+        for (const auto& [flag, name] : names)
+        {
+            if (flags & flag)
+                description += (description.empty() ? "" : "|") + std::string(name);
+        }
+        return description;
+    }
+
+    // Best of Repetitions runs, in GB/s
+    template<typename Copy>
+    double MeasureBandwidth(Copy&& copy)
+    {
+        double best = 0.0;
+        for (int i = 0; i < Repetitions; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            copy();
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            best = std::max(best, double(BufferSize) / seconds / 1e9);
+        }
+        return best;
+    }
+
+    // Fills a buffer in the memory type on the GPU, then times the host reading it back
+    // and writing it, the two directions staging memory is used in
+    void MeasureMemoryType(VulkanDevice& device, uint32_t memoryType, VkMemoryPropertyFlags flags)
+    {
+        VkDevice vkDevice = device.GetDevice();
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = BufferSize;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        VkBuffer buffer;
+        VK_CHECK_RESULT(vkCreateBuffer(vkDevice, &bufferInfo, nullptr, &buffer));
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(vkDevice, buffer, &requirements);
+        if (!(requirements.memoryTypeBits & (1u << memoryType)))
+        {
+            vkDestroyBuffer(vkDevice, buffer, nullptr);
+            return;
+        }
+
+        // Allocated by hand, the allocator would pick its own type
+        VkMemoryAllocateInfo allocateInfo{};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocateInfo.allocationSize = requirements.size;
+        allocateInfo.memoryTypeIndex = memoryType;
+        VkDeviceMemory memory;
+        if (vkAllocateMemory(vkDevice, &allocateInfo, nullptr, &memory) != VK_SUCCESS)
+        {
+            // Small heaps such as a 256 MiB BAR window may be exhausted
+            std::cout << "  type " << memoryType << ": allocation failed" << std::endl;
+            vkDestroyBuffer(vkDevice, buffer, nullptr);
+            return;
+        }
+        VK_CHECK_RESULT(vkBindBufferMemory(vkDevice, buffer, memory, 0));
+        void* mapped;
+        VK_CHECK_RESULT(vkMapMemory(vkDevice, memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+
+        VkCommandBuffer cmd = device.BeginSingleTimeCommands();
+        vkCmdFillBuffer(cmd, buffer, 0, BufferSize, 0x80808080u);
+        VkBufferMemoryBarrier hostBarrier{};
+        hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        hostBarrier.buffer = buffer;
+        hostBarrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+        device.EndSingleTimeCommand(cmd);
+
+        const bool coherent = flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = memory;
+        range.size = VK_WHOLE_SIZE;
+
+        // The invalidate is part of what a readback costs on non-coherent memory
+        std::vector<uint8_t> host(BufferSize);
+        const double read = MeasureBandwidth([&]
+        {
+            if (!coherent)
+                VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(vkDevice, 1, &range));
+            memcpy(host.data(), mapped, BufferSize);
+        });
+        const double write = MeasureBandwidth([&]
+        {
+            memcpy(mapped, host.data(), BufferSize);
+            if (!coherent)
+                VK_CHECK_RESULT(vkFlushMappedMemoryRanges(vkDevice, 1, &range));
+        });
+
+        std::cout << "  type " << memoryType << " (" << DescribeFlags(flags) << "): read " << std::fixed << std::setprecision(2)
+                  << read << " GB/s, write " << write << " GB/s" << std::endl;
+
+        vkUnmapMemory(vkDevice, memory);
+        vkFreeMemory(vkDevice, memory, nullptr);
+        vkDestroyBuffer(vkDevice, buffer, nullptr);
+    }
+
+    void PrintPolicy(const VulkanMemoryAllocator& allocator, const char* name, MemoryUsage usage)
+    {
+        std::optional<uint32_t> type = allocator.FindMemoryType(~0u, usage);
+        std::cout << "  " << name << ": ";
+        if (type)
+            std::cout << "type " << *type << " (" << DescribeFlags(allocator.GetMemoryProperties().memoryTypes[*type].propertyFlags) << ")" << std::endl;
+        else
+            std::cout << "none" << std::endl;
+    }
+
+    // Times a batch of images through the staged and, where supported, the direct path
+    void MeasureSharpen(const BenchmarkOptions& options)
+    {
+        std::vector<HostImage> inputs;
+        for (uint32_t i = 0; i < ImageCount; ++i)
+            inputs.push_back(CreateSyntheticImage(ImageSize, ImageSize, i));
+
+        VkNVSharpen sharpen(options.FramesInFlight, options.ImageCacheBudget);
+        sharpen.SetSharpness(options.Sharpness);
+        const bool directSupported = sharpen.UsesDirectImages();
+
+        uint64_t reference = 0;
+        for (bool direct : { false, true })
+        {
+            if (direct && !directSupported)
+            {
+                std::cout << "Direct images: not supported on this device" << std::endl;
+                break;
+            }
+            sharpen.SetDirectImages(direct);
+
+            uint64_t hash = 0;
+            sharpen.SetCompletionHandler([&hash](const ReadbackResult& result)
+            {
+                hash ^= HashPixels(result.Data, result.Width, result.Height, result.RowPitch);
+            });
+
+            const double ms = TimeSubmissions(sharpen, inputs, [&hash] { hash = 0; });
+
+            if (!direct)
+                reference = hash;
+            std::cout << (direct ? "Direct images" : "Staged images") << ": " << ImageCount << " x " << ImageSize << "x" << ImageSize
+                      << " in " << std::fixed << std::setprecision(2) << ms << " ms"
+                      << (direct ? (hash == reference ? ", identical" : ", DIFFERS") : "") << std::endl;
+        }
+    }
+
+    void Run(const BenchmarkOptions& options)
+    {
+        {
+            VulkanDevice device;
+            const VulkanMemoryAllocator& allocator = device.GetAllocator();
+            const VkPhysicalDeviceMemoryProperties& properties = allocator.GetMemoryProperties();
+
+            std::cout << "Device: " << device.PhysicalDeviceProperties.deviceName
+                      << (device.HasUnifiedMemory() ? " (unified memory)" : "") << std::endl;
+            std::cout << "Host bandwidth per memory type:" << std::endl;
+            for (uint32_t type = 0; type < properties.memoryTypeCount; ++type)
+            {
+                const VkMemoryPropertyFlags flags = properties.memoryTypes[type].propertyFlags;
+                if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+                    MeasureMemoryType(device, type, flags);
+            }
+
+            std::cout << "Policy:" << std::endl;
+            PrintPolicy(allocator, "GPU only", MemoryUsage::GpuOnly);
+            PrintPolicy(allocator, "Upload", MemoryUsage::Upload);
+            PrintPolicy(allocator, "Readback", MemoryUsage::Readback);
+            PrintPolicy(allocator, "Host mapped", MemoryUsage::HostMapped);
+        }
+
+        MeasureSharpen(options);
+    }
+
+    BenchmarkRegistration s_Registration("memory",
+            "Host read and write bandwidth of every mappable memory type, the type each usage picks, and staged against direct images",
+            &Run);
+}
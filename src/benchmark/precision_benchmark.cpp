@@ -0,0 +1,65 @@
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "benchmark.h"
+
+namespace
+{
+    constexpr BenchmarkResolution Resolutions[] = {
+            { "1080p", 1920, 1080, 16 },
+            { "4K", 3840, 2160, 8 } };
+
+    // Sharpening alone, then the scaler at 1.5x
+    constexpr float Scales[] = { 1.0f, 1.5f };
+
+    void Run(const BenchmarkOptions& options)
+    {
+        VkNVSharpen sharpen(options.FramesInFlight, options.ImageCacheBudget);
+        sharpen.SetSharpness(options.Sharpness);
+        // Whole images, like the scaled runs
+        sharpen.SetTileSize(0);
+        if (!sharpen.SupportsHalfPrecision())
+            std::cout << "shaderFloat16 or 16-bit storage is not supported, timing fp32 only" << std::endl;
+
+        std::vector<NISPrecision> precisions = { NISPrecision::Full };
+        if (sharpen.SupportsHalfPrecision())
+            precisions.push_back(NISPrecision::Half);
+
+        for (float scale : Scales)
+        {
+            sharpen.SetOutputScale(scale);
+            for (const BenchmarkResolution& resolution : Resolutions)
+            {
+                std::vector<HostImage> inputs;
+                for (uint32_t i = 0; i < resolution.ImageCount; ++i)
+                    inputs.push_back(CreateSyntheticImage(resolution.Width, resolution.Height, i));
+
+                // The fp32 pass is the reference
+                FirstImageComparison comparison;
+                sharpen.SetCompletionHandler([&](const ReadbackResult& result) { comparison.OnReadback(result); });
+                for (NISPrecision precision : precisions)
+                {
+                    sharpen.SetPrecision(precision);
+                    const bool half = precision == NISPrecision::Half;
+                    const double ms = TimeSubmissions(sharpen, inputs, [&] { comparison.BeginPass(!half); });
+
+                    std::cout << std::left << std::setw(6) << resolution.Name << std::setw(5) << (half ? "fp16" : "fp32")
+                              << "x" << std::fixed << std::setprecision(1) << scale << ": "
+                              << resolution.ImageCount << " x " << resolution.Width << "x" << resolution.Height
+                              << " in " << std::setprecision(2) << ms << " ms, "
+                              << std::setprecision(1) << resolution.ImageCount * 1000.0 / ms << " images/s";
+                    if (half)
+                        std::cout << ", max difference " << comparison.GetDifference();
+                    std::cout << std::endl;
+                }
+            }
+        }
+        sharpen.SetOutputScale(1.0f);
+        sharpen.SetCompletionHandler(nullptr);
+    }
+
+    BenchmarkRegistration s_Registration("precision",
+            "Sharpening and 1.5x scaling with the fp32 and fp16 shader builds at 1080p and 4K, with the largest fp16 error",
+            &Run);
+}
@@ -0,0 +1,48 @@
+#include <chrono>
+#include <iostream>
+
+#include "benchmark.h"
+
+namespace
+{
+    constexpr uint32_t ImageWidth = 6000;
+    constexpr uint32_t ImageHeight = 4000;
+    constexpr uint32_t TileSizes[] = { 0, 2048, 1024, 509 };
+
+    void Run(const BenchmarkOptions& options)
+    {
+        const HostImage input = CreateSyntheticImage(ImageWidth, ImageHeight, 1);
+
+        uint64_t reference = 0;
+        for (uint32_t tileSize : TileSizes)
+        {
+            // A fresh instance per tile size so the image cache peak is that of the size alone
+            VkNVSharpen sharpen(options.FramesInFlight, options.ImageCacheBudget);
+            sharpen.SetSharpness(options.Sharpness);
+            sharpen.SetTileSize(tileSize);
+
+            uint64_t hash = 0;
+            sharpen.SetCompletionHandler([&hash](const ReadbackResult& result)
+            {
+                hash = HashPixels(result.Data, result.Width, result.Height, result.RowPitch);
+            });
+
+            auto start = std::chrono::steady_clock::now();
+            sharpen.Submit(input);
+            sharpen.Flush();
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            if (tileSize == 0)
+                reference = hash;
+
+            std::cout << (tileSize == 0 ? std::string("Untiled") : "Tiles of " + std::to_string(tileSize))
+                      << ": " << ms << " ms, peak image memory "
+                      << (sharpen.GetImageCacheStats().PeakBytesAllocated >> 20) << " MiB, "
+                      << (hash == reference ? "identical" : "DIFFERS") << std::endl;
+        }
+    }
+
+    BenchmarkRegistration s_Registration("tiles",
+            "Sharpen a 6000x4000 image whole and in tiles of several sizes, compare time, memory and output",
+            &Run);
+}
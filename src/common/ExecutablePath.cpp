@@ -0,0 +1,29 @@
+#include "ExecutablePath.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <vector>
+#endif
+
+std::filesystem::path GetExecutableDirectory()
+{
+    std::error_code error;
+#ifdef _WIN32
+    std::vector<wchar_t> buffer(MAX_PATH);
+    while (true)
+    {
+        const DWORD length = GetModuleFileNameW(nullptr, buffer.data(), DWORD(buffer.size()));
+        if (length == 0)
+            break;
+        if (length < buffer.size())
+            return std::filesystem::path(std::wstring(buffer.data(), length)).parent_path();
+        buffer.resize(buffer.size() * 2);
+    }
+#else
+    const std::filesystem::path executable = std::filesystem::read_symlink("/proc/self/exe", error);
+    if (!error)
+        return executable.parent_path();
+#endif
+    return std::filesystem::current_path(error);
+}
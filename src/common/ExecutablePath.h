@@ -0,0 +1,8 @@
+#pragma once
+
+#include <filesystem>
+
+// Directory of the running executable (/proc/self/exe on Linux, GetModuleFileName on
+// Windows), which argv[0] doesn't give for a program started through PATH. Falls back
+// to the current directory where it cannot be queried.
+std::filesystem::path GetExecutableDirectory();
@@ -26,7 +26,11 @@
 #include <stb_image.h>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
 #include <unordered_map>
+#include "PngStream.h"
 #include "Utilities.h"
 
 namespace img
@@ -138,58 +142,186 @@ namespace img
         return Bpp[fmt];
     }
 
+    template<typename T>
+    void convertRGBA(const uint8_t* input, uint32_t inputRowPitch, uint8_t* output, uint32_t outputRowPitch, uint32_t width, uint32_t height, Fmt outFormat)
+    {
+        constexpr uint32_t channels = 4;
+        switch (outFormat)
+        {
+        case Fmt::R8G8B8A8:
+            if constexpr (std::is_same_v<T, uint8_t>)
+            {
+                // Identity, rows are copied as they are
+                const size_t rowBytes = size_t(width) * channels;
+                if (inputRowPitch == outputRowPitch)
+                {
+                    std::memcpy(output, input, size_t(inputRowPitch) * height);
+                    break;
+                }
+                for (uint32_t y = 0; y < height; ++y)
+                    std::memcpy(output + size_t(y) * outputRowPitch, input + size_t(y) * inputRowPitch, rowBytes);
+            }
+            else
+            {
+                convertToFmt<T, uint8_t>(const_cast<uint8_t*>(input), output, width, height, channels, inputRowPitch, channels, outputRowPitch);
+            }
+            break;
+        case Fmt::R32G32B32A32:
+            convertToFmt<T, float>(const_cast<uint8_t*>(input), output, width, height, channels, inputRowPitch, channels, outputRowPitch);
+            break;
+        case Fmt::R16G16B16A16:
+            convertToFmt<T, fp16_t>(const_cast<uint8_t*>(input), output, width, height, channels, inputRowPitch, channels, outputRowPitch);
+            break;
+        }
+    }
+
     void load(const std::string& fileName, std::vector<uint8_t>& data, uint32_t& width, uint32_t& height, uint32_t& outRowPitch, Fmt outFormat, uint32_t outRowPitchAlignment)
+    {
+        load(fileName, [&](uint32_t w, uint32_t h, uint32_t& rowPitch)
+        {
+            width = w;
+            height = h;
+            rowPitch = outRowPitch = Align(w * bytesPerPixel(outFormat), outRowPitchAlignment);
+            data.resize(size_t(rowPitch) * h);
+            return data.data();
+        }, outFormat);
+    }
+
+    void load(const std::string& fileName, const Destination& destination, Fmt outFormat)
     {
         std::string extension = std::filesystem::path(fileName).extension().string();
         for (auto& e : extension) e = std::tolower(e);
         if (extension == ".exr")
         {
-            loadEXR(fileName, data, width, height, outRowPitch, outFormat, outRowPitchAlignment);
+            loadEXR(fileName, destination, outFormat);
         }
         else if (extension == ".png")
         {
-            loadPNG(fileName, data, width, height, outRowPitch, outFormat, outRowPitchAlignment);
+            loadPNG(fileName, destination, outFormat);
+        }
+        else
+        {
+            loadSTB(fileName, destination, outFormat);
         }
     }
 
-    void loadPNG(const std::string& fileName, std::vector<uint8_t>& data, uint32_t& width, uint32_t& height, uint32_t& outRowPitch, Fmt outFormat, uint32_t outRowPitchAlignment)
+    void loadPNG(const std::string& fileName, const Destination& destination, Fmt outFormat)
     {
-        uint32_t infileChannels;
-        uint8_t* image = stbi_load(fileName.c_str(), (int*)&width, (int*)&height, (int*)&infileChannels, STBI_rgb_alpha);
+        if (outFormat == Fmt::R8G8B8A8)
+        {
+            PngReader reader(fileName);
+            if (!reader.interlaced())
+            {
+                uint32_t rowPitch = 0;
+                uint8_t* output = destination(reader.width(), reader.height(), rowPitch);
+                reader.readRows(output, rowPitch, reader.height());
+                return;
+            }
+        }
+        loadSTB(fileName, destination, outFormat);
+    }
+
+    void loadSTB(const std::string& fileName, const Destination& destination, Fmt outFormat)
+    {
+        int width, height, infileChannels;
+        uint8_t* image = stbi_load(fileName.c_str(), &width, &height, &infileChannels, STBI_rgb_alpha);
 
         if (image == nullptr)
-            throw std::runtime_error("Failed to load PNG Image : " + fileName);
+            throw std::runtime_error("Failed to load Image : " + fileName + " Error: " + stbi_failure_reason());
 
-        uint32_t inChannels = 4; // stb_image has already converted data to RGBA
-        uint32_t inputRowPitch = width * inChannels;
-        uint32_t outChannels = 4; // Hardcoded all output formats have 4 channel
-        outRowPitch = Align(width * bytesPerPixel(outFormat), outRowPitchAlignment);
-        uint32_t imageSize = outRowPitch * height;
-        data.resize(imageSize);
+        try
+        {
+            // stb_image has already converted data to RGBA
+            uint32_t outRowPitch = 0;
+            uint8_t* output = destination(uint32_t(width), uint32_t(height), outRowPitch);
+            convertRGBA<uint8_t>(image, uint32_t(width) * 4, output, outRowPitch, uint32_t(width), uint32_t(height), outFormat);
+        }
+        catch (...)
+        {
+            stbi_image_free(image);
+            throw;
+        }
+        stbi_image_free(image);
+    }
 
-        switch (outFormat)
+    void loadCompact(const std::string& fileName, const CompactDestination& destination)
+    {
+        std::string extension = std::filesystem::path(fileName).extension().string();
+        for (auto& e : extension) e = std::tolower(e);
+        if (extension == ".exr")
         {
-        case Fmt::R8G8B8A8:
-            convertToFmt<uint8_t, uint8_t>(image, data.data(), width, height, inChannels, inputRowPitch, outChannels, outRowPitch);
-            break;
-        case Fmt::R32G32B32A32:
-            convertToFmt<uint8_t, float>(image, data.data(), width, height, inChannels, inputRowPitch, outChannels, outRowPitch);
-            break;
-        case Fmt::R16G16B16A16:
-            convertToFmt<uint8_t, fp16_t>(image, data.data(), width, height, inChannels, inputRowPitch, outChannels, outRowPitch);
-            break;
+            loadEXR(fileName, [&](uint32_t width, uint32_t height, uint32_t& rowPitch)
+            {
+                return destination(width, height, 4, rowPitch);
+            }, Fmt::R8G8B8A8);
+            return;
+        }
+
+        if (extension == ".png")
+        {
+            PngReader reader(fileName);
+            if (!reader.interlaced())
+            {
+                const uint32_t channels = reader.compactChannels();
+                uint32_t rowPitch = 0;
+                uint8_t* output = destination(reader.width(), reader.height(), channels, rowPitch);
+                reader.readRows(output, rowPitch, reader.height(), channels);
+                return;
+            }
         }
 
+        // Gray with alpha has no compact layout of its own and goes to RGBA
+        int width, height, infileChannels;
+        if (!stbi_info(fileName.c_str(), &width, &height, &infileChannels))
+            throw std::runtime_error("Failed to load Image : " + fileName + " Error: " + stbi_failure_reason());
+        const int channels = infileChannels == 1 || infileChannels == 3 ? infileChannels : 4;
+        uint8_t* image = stbi_load(fileName.c_str(), &width, &height, &infileChannels, channels);
+        if (image == nullptr)
+            throw std::runtime_error("Failed to load Image : " + fileName + " Error: " + stbi_failure_reason());
+
+        try
+        {
+            uint32_t outRowPitch = 0;
+            uint8_t* output = destination(uint32_t(width), uint32_t(height), uint32_t(channels), outRowPitch);
+            const size_t rowBytes = size_t(width) * channels;
+            for (int y = 0; y < height; ++y)
+                std::memcpy(output + size_t(y) * outRowPitch, image + size_t(y) * rowBytes, rowBytes);
+        }
+        catch (...)
+        {
+            stbi_image_free(image);
+            throw;
+        }
         stbi_image_free(image);
     }
 
-    void loadEXR(const std::string& fileName, std::vector<uint8_t>& data, uint32_t& width, uint32_t& height, uint32_t& outRowPitch, Fmt outFormat, uint32_t outRowPitchAlignment)
+    void expandRowToRGBA8(const uint8_t* src, uint32_t channels, uint8_t* dst, uint32_t width)
+    {
+        for (uint32_t x = 0; x < width; ++x, src += channels, dst += 4)
+        {
+            dst[0] = src[0];
+            dst[1] = src[channels == 1 ? 0 : 1];
+            dst[2] = src[channels == 1 ? 0 : 2];
+            dst[3] = channels == 4 ? src[3] : 255;
+        }
+    }
+
+    void packRowFromRGBA8(const uint8_t* src, uint8_t* dst, uint32_t channels, uint32_t width)
+    {
+        for (uint32_t x = 0; x < width; ++x, src += 4, dst += channels)
+        {
+            for (uint32_t c = 0; c < channels; ++c)
+                dst[c] = src[c];
+        }
+    }
+
+    void loadEXR(const std::string& fileName, const Destination& destination, Fmt outFormat)
     {
         uint32_t inChannels = 4; // fixed to only 4 channel EXR files
         float* image;
         const char* err = nullptr;
-        int ret = LoadEXR(&image, (int*)&width, (int*)&height, fileName.c_str(), &err);
-        uint32_t inputRowPitch = width * inChannels * sizeof(float);
+        int width, height;
+        int ret = LoadEXR(&image, &width, &height, fileName.c_str(), &err);
 
         if (ret != TINYEXR_SUCCESS) {
             std::string serr = err;
@@ -197,22 +329,17 @@ namespace img
             throw std::runtime_error("Failed to load EXR Image : " + fileName + " Error: " + serr);
         }
 
-        uint32_t outChannels = 4; // Hardcoded all output formats have 4 channel
-        outRowPitch = Align(width * bytesPerPixel(outFormat), outRowPitchAlignment);
-        uint32_t imageSize = outRowPitch * height;
-        data.resize(imageSize);
-
-        switch (outFormat)
+        try
         {
-        case Fmt::R8G8B8A8:
-            convertToFmt<float, uint8_t>((uint8_t*)image, data.data(), width, height, inChannels, inputRowPitch, outChannels, outRowPitch);
-            break;
-        case Fmt::R32G32B32A32:
-            convertToFmt<float, float>((uint8_t*)image, data.data(), width, height, inChannels, inputRowPitch, outChannels, outRowPitch);
-            break;
-        case Fmt::R16G16B16A16:
-            convertToFmt<float, fp16_t>((uint8_t*)image, data.data(), width, height, inChannels, inputRowPitch, outChannels, outRowPitch);
-            break;
+            uint32_t inputRowPitch = uint32_t(width) * inChannels * sizeof(float);
+            uint32_t outRowPitch = 0;
+            uint8_t* output = destination(uint32_t(width), uint32_t(height), outRowPitch);
+            convertRGBA<float>((uint8_t*)image, inputRowPitch, output, outRowPitch, uint32_t(width), uint32_t(height), outFormat);
+        }
+        catch (...)
+        {
+            free(image);
+            throw;
         }
         free(image);
     }
@@ -226,12 +353,12 @@ namespace img
 
     void rgba2yuv420(const std::vector<uint8_t>& input, std::vector<uint8_t>& output, uint32_t width, uint32_t height)
     {
-        uint32_t sizeY = width * height;
-        uint32_t sizeUV = width * height / 4 * 2;
-        output.resize(uint64_t(sizeY) + sizeUV);
-        uint32_t idx = 0;
-        uint32_t idxy = 0;
-        uint32_t idxuv = width * height;
+        size_t sizeY = size_t(width) * height;
+        size_t sizeUV = size_t(width) * height / 4 * 2;
+        output.resize(sizeY + sizeUV);
+        size_t idx = 0;
+        size_t idxy = 0;
+        size_t idxuv = sizeY;
         for (uint32_t yp = 0; yp < height; ++yp) {
             for (uint32_t xp = 0; xp < width; ++xp) {
                 uint8_t y, u, v;
@@ -249,6 +376,80 @@ namespace img
         }
     }
 
+    void loadNV12(const std::string& fileName, uint32_t width, uint32_t height, const Destination& destination)
+    {
+        if (width % 2 != 0 || height % 2 != 0)
+            throw std::runtime_error("NV12 frames need an even width and height: " + fileName);
+
+        std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+        if (!file)
+            throw std::runtime_error("Failed to open file: " + fileName);
+        const uint32_t rows = height + height / 2;
+        if (uint64_t(file.tellg()) != uint64_t(width) * rows)
+            throw std::runtime_error("Not a " + std::to_string(width) + "x" + std::to_string(height) + " NV12 frame: " + fileName);
+        file.seekg(0);
+
+        uint32_t rowPitch = 0;
+        uint8_t* output = destination(width, height, rowPitch);
+        if (rowPitch == width)
+        {
+            file.read(reinterpret_cast<char*>(output), std::streamsize(width) * rows);
+        }
+        else
+        {
+            for (uint32_t y = 0; y < rows; ++y)
+                file.read(reinterpret_cast<char*>(output + size_t(y) * rowPitch), width);
+        }
+        if (!file)
+            throw std::runtime_error("Failed to read file: " + fileName);
+    }
+
+    void saveNV12(const std::string& fileName, const uint8_t* data, uint32_t width, uint32_t height, uint32_t rowPitch)
+    {
+        std::ofstream file(fileName, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Failed to open file: " + fileName);
+        const uint32_t chromaRowBytes = (width + 1) & ~1u;
+        const uint32_t rows = height + (height + 1) / 2;
+        if (rowPitch == width && chromaRowBytes == width)
+        {
+            file.write(reinterpret_cast<const char*>(data), std::streamsize(width) * rows);
+        }
+        else
+        {
+            for (uint32_t y = 0; y < rows; ++y)
+                file.write(reinterpret_cast<const char*>(data + size_t(y) * rowPitch), y < height ? width : chromaRowBytes);
+        }
+        if (!file)
+            throw std::runtime_error("Failed to write file: " + fileName);
+    }
+
+    void convertToNV12(const uint8_t* src, uint32_t srcRowPitch, uint32_t channels, uint32_t width, uint32_t height,
+                       uint8_t* dst, uint32_t dstRowPitch)
+    {
+        uint8_t* chroma = dst + size_t(dstRowPitch) * height;
+        for (uint32_t yp = 0; yp < height; ++yp)
+        {
+            const uint8_t* row = src + size_t(yp) * srcRowPitch;
+            uint8_t* luma = dst + size_t(yp) * dstRowPitch;
+            uint8_t* uv = chroma + size_t(yp / 2) * dstRowPitch;
+            for (uint32_t xp = 0; xp < width; ++xp, row += channels)
+            {
+                uint8_t y, u, v;
+                const uint8_t r = row[0];
+                const uint8_t g = row[channels == 1 ? 0 : 1];
+                const uint8_t b = row[channels == 1 ? 0 : 2];
+                rgb2yuv(r, g, b, y, u, v);
+                luma[xp] = y;
+                if (yp % 2 == 0 && xp % 2 == 0)
+                {
+                    uv[xp] = u;
+                    uv[xp + 1] = v;
+                }
+            }
+        }
+    }
+
     void save(const std::string& fileName, uint8_t* data, uint32_t width, uint32_t height, uint32_t channels, uint32_t rowPitch, Fmt format)
     {
         std::string extension = std::filesystem::path(fileName).extension().string();
@@ -265,6 +466,16 @@ namespace img
 
     void savePNG(const std::string& fileName, uint8_t* data, uint32_t width, uint32_t height, uint32_t channels, uint32_t rowPitch, Fmt format)
     {
+        if (format == Fmt::R8G8B8A8 && (channels == 1 || channels == 3 || channels == 4))
+        {
+            // Already 8-bit: rows are filtered and compressed straight from the caller's
+            // memory, without a converted copy of the image
+            PngWriter writer(fileName, width, height, channels);
+            writer.writeRows(data, rowPitch, height);
+            writer.finish();
+            return;
+        }
+
         constexpr uint32_t outputChannels = 4;
         std::vector<uint8_t> image(size_t(width) * height * outputChannels);
         uint32_t outputRowPitch = width * outputChannels * sizeof(uint8_t);
@@ -295,7 +506,7 @@ namespace img
 
         constexpr uint32_t outputChannels = 4;
         image.num_channels = outputChannels;
-        uint32_t plane_size = width * height;
+        size_t plane_size = size_t(width) * height;
         uint32_t outputRowPitch = width * sizeof(float);
         std::vector<float> images(size_t(outputChannels) * plane_size);
         switch (format)
@@ -26,6 +26,7 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <functional>
 
 namespace img
 {
@@ -38,12 +39,44 @@ namespace img
 
     uint32_t bytesPerPixel(Fmt fmt);
 
+    // Called once the image size is known. Returns where the width x height pixels are
+    // written and sets the row pitch of that memory.
+    using Destination = std::function<uint8_t*(uint32_t width, uint32_t height, uint32_t& rowPitch)>;
+    // Same, also told how many 8-bit channels each pixel is decoded with
+    using CompactDestination = std::function<uint8_t*(uint32_t width, uint32_t height, uint32_t channels, uint32_t& rowPitch)>;
+
     void load(const std::string& fileName, std::vector<uint8_t>& data, uint32_t& width, uint32_t& height, uint32_t& outRowPitch, Fmt outFormat, uint32_t outRowPitchAlignment = 1);
-    void loadPNG(const std::string& fileName, std::vector<uint8_t>& data, uint32_t& width, uint32_t& height, uint32_t& outRowPitch, Fmt outFormat, uint32_t outRowPitchAlignment = 1);
-    void loadEXR(const std::string& fileName, std::vector<uint8_t>& data, uint32_t& width, uint32_t& height, uint32_t& outRowPitch, Fmt outFormat, uint32_t outRowPitchAlignment = 1);
+    // Decodes straight into caller memory, such as mapped staging memory. Non-interlaced
+    // PNGs are decoded row by row into the destination, other files go through the
+    // decoder's own buffer once. R8G8B8A8 output from 8-bit input is copied as is.
+    void load(const std::string& fileName, const Destination& destination, Fmt outFormat);
+    void loadPNG(const std::string& fileName, const Destination& destination, Fmt outFormat);
+    void loadEXR(const std::string& fileName, const Destination& destination, Fmt outFormat);
+    // JPEG, BMP, TGA and the other formats stb_image reads
+    void loadSTB(const std::string& fileName, const Destination& destination, Fmt outFormat);
+    // Decodes 8-bit pixels with as few channels as the file needs: 1 for grayscale, 3
+    // for opaque color and 4 when there is alpha. EXR files always decode to 4.
+    void loadCompact(const std::string& fileName, const CompactDestination& destination);
+    // Row conversions between 8-bit pixels with 1, 3 or 4 channels and RGBA8. Gray goes
+    // to R, G and B and missing alpha is opaque; packing keeps the leading channels.
+    void expandRowToRGBA8(const uint8_t* src, uint32_t channels, uint8_t* dst, uint32_t width);
+    void packRowFromRGBA8(const uint8_t* src, uint8_t* dst, uint32_t channels, uint32_t width);
     void rgba2yuv420(const std::vector<uint8_t>& input, std::vector<uint8_t>& output, uint32_t width, uint32_t height);
+    // Raw NV12 frames: height rows of 8-bit luma, then height / 2 rows of interleaved U
+    // and V, width bytes each. The files have no header, so the frame size is given.
+    // In memory the chroma rows follow the luma rows at the same row pitch.
+    void loadNV12(const std::string& fileName, uint32_t width, uint32_t height, const Destination& destination);
+    // Odd sizes round the chroma plane up: (height + 1) / 2 rows of (width + 1) / 2 pairs
+    void saveNV12(const std::string& fileName, const uint8_t* data, uint32_t width, uint32_t height, uint32_t rowPitch);
+    // Converts 8-bit pixels with 1, 3 or 4 channels to NV12 as rgba2yuv420 does, chroma
+    // from the top left pixel of each 2x2 block. dst holds the chroma rows behind the
+    // luma rows, dstRowPitch apart; dstRowPitch is at least width rounded up to even.
+    void convertToNV12(const uint8_t* src, uint32_t srcRowPitch, uint32_t channels, uint32_t width, uint32_t height,
+                       uint8_t* dst, uint32_t dstRowPitch);
 
     void save(const std::string& fileName, uint8_t* data, uint32_t width, uint32_t height, uint32_t channels, uint32_t rowPitch, Fmt format);
+    // R8G8B8A8 with 1, 3 or 4 channels is encoded directly from data, any row pitch, into
+    // a gray, RGB or RGBA file. Other formats are written as RGBA.
     void savePNG(const std::string& fileName, uint8_t* data, uint32_t width, uint32_t height, uint32_t channels, uint32_t rowPitch, Fmt format);
     void saveEXR(const std::string& fileName, uint8_t* data, uint32_t width, uint32_t height, uint32_t channels, uint32_t rowPitch, Fmt format);
 }
\ No newline at end of file
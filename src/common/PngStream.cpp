@@ -0,0 +1,552 @@
+#include "PngStream.h"
+#include "Image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace img
+{
+    namespace
+    {
+        constexpr uint8_t PngSignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        constexpr size_t InputBufferSize = 64 * 1024;
+        constexpr size_t IdatChunkSize = 256 * 1024;
+
+        uint32_t readBE32(const uint8_t* p)
+        {
+            return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+        }
+
+        void writeBE32(uint8_t* p, uint32_t v)
+        {
+            p[0] = uint8_t(v >> 24);
+            p[1] = uint8_t(v >> 16);
+            p[2] = uint8_t(v >> 8);
+            p[3] = uint8_t(v);
+        }
+
+        uint8_t paeth(int a, int b, int c)
+        {
+            int p = a + b - c;
+            int pa = std::abs(p - a);
+            int pb = std::abs(p - b);
+            int pc = std::abs(p - c);
+            if (pa <= pb && pa <= pc)
+                return uint8_t(a);
+            return uint8_t(pb <= pc ? b : c);
+        }
+    }
+
+    PngReader::PngReader(const std::string& fileName)
+        : m_FileName(fileName)
+    {
+        m_File = std::fopen(fileName.c_str(), "rb");
+        if (m_File == nullptr)
+            throw std::runtime_error("Failed to open PNG Image : " + fileName);
+
+        try
+        {
+            readHeader();
+        }
+        catch (...)
+        {
+            std::fclose(m_File);
+            throw;
+        }
+    }
+
+    PngReader::~PngReader()
+    {
+        if (m_StreamInitialized)
+            mz_inflateEnd(&m_Stream);
+        std::fclose(m_File);
+    }
+
+    void PngReader::readHeader()
+    {
+        uint8_t signature[8];
+        if (std::fread(signature, 1, 8, m_File) != 8 || std::memcmp(signature, PngSignature, 8) != 0)
+            throw std::runtime_error("Not a PNG Image : " + m_FileName);
+
+        uint32_t length;
+        char type[4];
+        std::vector<uint8_t> data;
+        if (!readChunkHeader(length, type) || std::memcmp(type, "IHDR", 4) != 0 || length != 13)
+            throw std::runtime_error("Missing PNG header : " + m_FileName);
+        readChunkData(data, length);
+        skip(4); // CRC
+
+        m_Width = readBE32(&data[0]);
+        m_Height = readBE32(&data[4]);
+        m_BitDepth = data[8];
+        m_ColorType = data[9];
+        m_Interlaced = data[12] != 0;
+
+        switch (m_ColorType)
+        {
+        case 0: m_Channels = 1; break;
+        case 2: m_Channels = 3; break;
+        case 3: m_Channels = 1; break;
+        case 4: m_Channels = 2; break;
+        case 6: m_Channels = 4; break;
+        default: throw std::runtime_error("Unsupported PNG color type : " + m_FileName);
+        }
+        const bool validDepth = m_ColorType == 0 ? (m_BitDepth == 1 || m_BitDepth == 2 || m_BitDepth == 4 || m_BitDepth == 8 || m_BitDepth == 16)
+                              : m_ColorType == 3 ? (m_BitDepth == 1 || m_BitDepth == 2 || m_BitDepth == 4 || m_BitDepth == 8)
+                              : (m_BitDepth == 8 || m_BitDepth == 16);
+        if (m_Width == 0 || m_Height == 0 || !validDepth)
+            throw std::runtime_error("Invalid PNG header : " + m_FileName);
+
+        const uint64_t bitsPerPixel = uint64_t(m_Channels) * m_BitDepth;
+        m_FilterBpp = uint32_t(std::max<uint64_t>(bitsPerPixel / 8, 1));
+        m_Stride = size_t((bitsPerPixel * m_Width + 7) / 8);
+
+        // Ancillary chunks up to the first IDAT
+        for (;;)
+        {
+            if (!readChunkHeader(length, type))
+                throw std::runtime_error("PNG Image has no image data : " + m_FileName);
+
+            if (std::memcmp(type, "IDAT", 4) == 0)
+            {
+                m_ChunkRemaining = length;
+                break;
+            }
+
+            if (std::memcmp(type, "PLTE", 4) == 0)
+            {
+                readChunkData(data, length);
+                m_Palette.assign(size_t(256) * 4, 255);
+                for (uint32_t i = 0; i < length / 3 && i < 256; ++i)
+                    std::memcpy(&m_Palette[i * 4], &data[i * 3], 3);
+            }
+            else if (std::memcmp(type, "tRNS", 4) == 0)
+            {
+                readChunkData(data, length);
+                if (m_ColorType == 3)
+                {
+                    if (m_Palette.empty())
+                        throw std::runtime_error("PNG tRNS before PLTE : " + m_FileName);
+                    for (uint32_t i = 0; i < length && i < 256; ++i)
+                        m_Palette[i * 4 + 3] = data[i];
+                }
+                else if ((m_ColorType == 0 && length >= 2) || (m_ColorType == 2 && length >= 6))
+                {
+                    m_HasColorKey = true;
+                    for (uint32_t c = 0; c < m_Channels; ++c)
+                        m_ColorKey[c] = uint16_t((data[c * 2] << 8) | data[c * 2 + 1]);
+                }
+            }
+            else
+            {
+                skip(length);
+            }
+            skip(4); // CRC
+        }
+
+        if (m_ColorType == 3 && m_Palette.empty())
+            throw std::runtime_error("PNG Image has no palette : " + m_FileName);
+
+        if (mz_inflateInit(&m_Stream) != MZ_OK)
+            throw std::runtime_error("Failed to initialize PNG decompression : " + m_FileName);
+        m_StreamInitialized = true;
+
+        m_Input.resize(InputBufferSize);
+        m_Row.resize(m_Stride + 1);
+        m_PrevRow.assign(m_Stride, 0);
+    }
+
+    bool PngReader::readChunkHeader(uint32_t& length, char type[4])
+    {
+        uint8_t header[8];
+        if (std::fread(header, 1, 8, m_File) != 8)
+            return false;
+        length = readBE32(header);
+        std::memcpy(type, header + 4, 4);
+        return true;
+    }
+
+    void PngReader::readChunkData(std::vector<uint8_t>& data, uint32_t length)
+    {
+        data.resize(length);
+        if (length > 0 && std::fread(data.data(), 1, length, m_File) != length)
+            throw std::runtime_error("Truncated PNG Image : " + m_FileName);
+    }
+
+    void PngReader::skip(uint64_t length)
+    {
+        while (length > 0)
+        {
+            long step = long(std::min<uint64_t>(length, 1u << 30));
+            if (std::fseek(m_File, step, SEEK_CUR) != 0)
+                throw std::runtime_error("Truncated PNG Image : " + m_FileName);
+            length -= uint64_t(step);
+        }
+    }
+
+    void PngReader::fillInput()
+    {
+        // Moves on to the next IDAT chunk once the current one is used up
+        while (m_ChunkRemaining == 0)
+        {
+            skip(4); // CRC of the finished chunk
+            uint32_t length;
+            char type[4];
+            if (!readChunkHeader(length, type) || std::memcmp(type, "IDAT", 4) != 0)
+                throw std::runtime_error("PNG image data ends early : " + m_FileName);
+            m_ChunkRemaining = length;
+        }
+
+        size_t count = size_t(std::min<uint64_t>(m_ChunkRemaining, m_Input.size()));
+        if (std::fread(m_Input.data(), 1, count, m_File) != count)
+            throw std::runtime_error("Truncated PNG Image : " + m_FileName);
+        m_ChunkRemaining -= count;
+        m_Stream.next_in = m_Input.data();
+        m_Stream.avail_in = unsigned(count);
+    }
+
+    void PngReader::inflateRow()
+    {
+        m_Stream.next_out = m_Row.data();
+        m_Stream.avail_out = unsigned(m_Row.size());
+        for (;;)
+        {
+            // Inflate can still have output buffered with no input left, so input is
+            // only refilled once it stops making progress
+            int status = mz_inflate(&m_Stream, MZ_NO_FLUSH);
+            if (m_Stream.avail_out == 0)
+                return;
+            if (status == MZ_STREAM_END)
+                throw std::runtime_error("PNG image data ends early : " + m_FileName);
+            if (status != MZ_OK && status != MZ_BUF_ERROR)
+                throw std::runtime_error("Corrupt PNG image data : " + m_FileName);
+            if (m_Stream.avail_in == 0)
+                fillInput();
+        }
+    }
+
+    void PngReader::unfilterRow()
+    {
+        uint8_t* row = m_Row.data() + 1;
+        const uint8_t* prev = m_PrevRow.data();
+        const size_t bpp = m_FilterBpp;
+        switch (m_Row[0])
+        {
+        case 0:
+            break;
+        case 1:
+            for (size_t i = bpp; i < m_Stride; ++i)
+                row[i] = uint8_t(row[i] + row[i - bpp]);
+            break;
+        case 2:
+            for (size_t i = 0; i < m_Stride; ++i)
+                row[i] = uint8_t(row[i] + prev[i]);
+            break;
+        case 3:
+            for (size_t i = 0; i < m_Stride; ++i)
+                row[i] = uint8_t(row[i] + ((i >= bpp ? row[i - bpp] : 0) + prev[i]) / 2);
+            break;
+        case 4:
+            for (size_t i = 0; i < m_Stride; ++i)
+                row[i] = uint8_t(row[i] + paeth(i >= bpp ? row[i - bpp] : 0, prev[i], i >= bpp ? prev[i - bpp] : 0));
+            break;
+        default:
+            throw std::runtime_error("Corrupt PNG row filter : " + m_FileName);
+        }
+        std::memcpy(m_PrevRow.data(), row, m_Stride);
+    }
+
+    void PngReader::expandRow(uint8_t* dst) const
+    {
+        const uint8_t* row = m_PrevRow.data();
+        if (m_BitDepth == 8 && m_ColorType == 6)
+        {
+            std::memcpy(dst, row, m_Stride);
+            return;
+        }
+        if (m_BitDepth == 8 && m_ColorType == 2 && !m_HasColorKey)
+        {
+            for (uint32_t x = 0; x < m_Width; ++x)
+            {
+                std::memcpy(dst + size_t(x) * 4, row + size_t(x) * 3, 3);
+                dst[size_t(x) * 4 + 3] = 255;
+            }
+            return;
+        }
+
+        auto sample = [&](uint32_t x, uint32_t c) -> uint16_t
+        {
+            const size_t index = size_t(x) * m_Channels + c;
+            if (m_BitDepth == 16)
+                return uint16_t((row[index * 2] << 8) | row[index * 2 + 1]);
+            if (m_BitDepth == 8)
+                return row[index];
+            const size_t bit = index * m_BitDepth;
+            return uint16_t((row[bit / 8] >> (8 - m_BitDepth - bit % 8)) & ((1u << m_BitDepth) - 1));
+        };
+        // Samples to 8 bits: 16-bit keeps the high byte, low depths are scaled up
+        auto to8 = [&](uint16_t v) -> uint8_t
+        {
+            if (m_BitDepth == 16)
+                return uint8_t(v >> 8);
+            return uint8_t(v * (255 / ((1u << m_BitDepth) - 1)));
+        };
+
+        for (uint32_t x = 0; x < m_Width; ++x)
+        {
+            uint8_t* p = dst + size_t(x) * 4;
+            switch (m_ColorType)
+            {
+            case 0:
+            {
+                uint16_t gray = sample(x, 0);
+                p[0] = p[1] = p[2] = to8(gray);
+                p[3] = m_HasColorKey && gray == m_ColorKey[0] ? 0 : 255;
+                break;
+            }
+            case 2:
+            {
+                uint16_t r = sample(x, 0), g = sample(x, 1), b = sample(x, 2);
+                p[0] = to8(r);
+                p[1] = to8(g);
+                p[2] = to8(b);
+                p[3] = m_HasColorKey && r == m_ColorKey[0] && g == m_ColorKey[1] && b == m_ColorKey[2] ? 0 : 255;
+                break;
+            }
+            case 3:
+                std::memcpy(p, &m_Palette[size_t(sample(x, 0)) * 4], 4);
+                break;
+            case 4:
+                p[0] = p[1] = p[2] = to8(sample(x, 0));
+                p[3] = to8(sample(x, 1));
+                break;
+            case 6:
+                for (uint32_t c = 0; c < 4; ++c)
+                    p[c] = to8(sample(x, c));
+                break;
+            }
+        }
+    }
+
+    void PngReader::expandRow(uint8_t* dst, uint32_t channels)
+    {
+        const uint8_t* row = m_PrevRow.data();
+        if (channels == 4)
+        {
+            expandRow(dst);
+            return;
+        }
+        // 8-bit files that already have the compact layout
+        if (m_BitDepth == 8 && (m_ColorType == 0 || m_ColorType == 2))
+        {
+            std::memcpy(dst, row, m_Stride);
+            return;
+        }
+
+        m_Expanded.resize(size_t(m_Width) * 4);
+        expandRow(m_Expanded.data());
+        packRowFromRGBA8(m_Expanded.data(), dst, channels, m_Width);
+    }
+
+    uint32_t PngReader::compactChannels() const
+    {
+        switch (m_ColorType)
+        {
+        case 0:
+            return m_HasColorKey ? 4 : 1;
+        case 2:
+            return m_HasColorKey ? 4 : 3;
+        case 3:
+            for (size_t i = 3; i < m_Palette.size(); i += 4)
+            {
+                if (m_Palette[i] != 255)
+                    return 4;
+            }
+            return 3;
+        default:
+            return 4;
+        }
+    }
+
+    uint32_t PngReader::readRows(uint8_t* dst, uint32_t rowPitch, uint32_t count, uint32_t channels)
+    {
+        if (m_Interlaced)
+            throw std::runtime_error("Interlaced PNGs cannot be streamed : " + m_FileName);
+        if (channels != 4 && channels != compactChannels())
+            throw std::runtime_error("PNG Image cannot be decoded to " + std::to_string(channels) + " channels : " + m_FileName);
+
+        count = std::min(count, m_Height - m_RowsRead);
+        for (uint32_t y = 0; y < count; ++y)
+        {
+            inflateRow();
+            unfilterRow();
+            expandRow(dst + size_t(y) * rowPitch, channels);
+        }
+        m_RowsRead += count;
+        return count;
+    }
+
+    PngWriter::PngWriter(const std::string& fileName, uint32_t width, uint32_t height, uint32_t channels, int compressionLevel)
+        : m_FileName(fileName), m_Width(width), m_Height(height), m_Channels(channels)
+    {
+        if (channels != 1 && channels != 3 && channels != 4)
+            throw std::runtime_error("PNG Images are written with 1, 3 or 4 channels : " + fileName);
+
+        m_File = std::fopen(fileName.c_str(), "wb");
+        if (m_File == nullptr)
+            throw std::runtime_error("Failed to create PNG Image : " + fileName);
+
+        if (mz_deflateInit(&m_Stream, compressionLevel) != MZ_OK)
+        {
+            std::fclose(m_File);
+            throw std::runtime_error("Failed to initialize PNG compression : " + fileName);
+        }
+        m_StreamInitialized = true;
+
+        const size_t stride = size_t(width) * channels;
+        m_PrevRow.assign(stride, 0);
+        m_Filtered.resize(stride + 1);
+        m_Candidate.resize(stride + 1);
+        m_Output.resize(IdatChunkSize);
+        m_Stream.next_out = m_Output.data();
+        m_Stream.avail_out = unsigned(m_Output.size());
+
+        write(PngSignature, 8);
+        uint8_t header[13];
+        writeBE32(&header[0], width);
+        writeBE32(&header[4], height);
+        header[8] = 8;  // bit depth
+        header[9] = channels == 1 ? 0 : channels == 3 ? 2 : 6; // gray, RGB or RGBA
+        header[10] = 0; // deflate
+        header[11] = 0; // adaptive filtering
+        header[12] = 0; // not interlaced
+        writeChunk("IHDR", header, sizeof(header));
+    }
+
+    PngWriter::~PngWriter()
+    {
+        if (m_StreamInitialized)
+            mz_deflateEnd(&m_Stream);
+        if (m_File != nullptr)
+            std::fclose(m_File);
+    }
+
+    void PngWriter::filterRow(const uint8_t* row)
+    {
+        const size_t stride = m_PrevRow.size();
+        const size_t bpp = m_Channels;
+        const uint8_t* prev = m_PrevRow.data();
+        uint64_t bestScore = UINT64_MAX;
+        for (uint8_t filter = 0; filter < 5; ++filter)
+        {
+            uint8_t* out = m_Candidate.data() + 1;
+            for (size_t i = 0; i < stride; ++i)
+            {
+                const int a = i >= bpp ? row[i - bpp] : 0;
+                const int b = prev[i];
+                const int c = i >= bpp ? prev[i - bpp] : 0;
+                int predictor = 0;
+                switch (filter)
+                {
+                case 1: predictor = a; break;
+                case 2: predictor = b; break;
+                case 3: predictor = (a + b) / 2; break;
+                case 4: predictor = paeth(a, b, c); break;
+                }
+                out[i] = uint8_t(row[i] - predictor);
+            }
+
+            uint64_t score = 0;
+            for (size_t i = 0; i < stride; ++i)
+                score += uint64_t(std::abs(int8_t(out[i])));
+            if (score < bestScore)
+            {
+                bestScore = score;
+                m_Candidate[0] = filter;
+                std::swap(m_Candidate, m_Filtered);
+            }
+        }
+        std::memcpy(m_PrevRow.data(), row, stride);
+    }
+
+    void PngWriter::writeRows(const uint8_t* src, uint32_t rowPitch, uint32_t count)
+    {
+        if (m_RowsWritten + uint64_t(count) > m_Height)
+            throw std::runtime_error("Too many rows written to PNG Image : " + m_FileName);
+
+        for (uint32_t y = 0; y < count; ++y)
+        {
+            filterRow(src + size_t(y) * rowPitch);
+            m_Stream.next_in = m_Filtered.data();
+            m_Stream.avail_in = unsigned(m_Filtered.size());
+            compress(MZ_NO_FLUSH);
+        }
+        m_RowsWritten += count;
+    }
+
+    void PngWriter::compress(int flush)
+    {
+        for (;;)
+        {
+            int status = mz_deflate(&m_Stream, flush);
+            if (status != MZ_OK && status != MZ_STREAM_END && status != MZ_BUF_ERROR)
+                throw std::runtime_error("Failed to compress PNG Image : " + m_FileName);
+
+            if (m_Stream.avail_out == 0)
+            {
+                writeChunk("IDAT", m_Output.data(), m_Output.size());
+                m_Stream.next_out = m_Output.data();
+                m_Stream.avail_out = unsigned(m_Output.size());
+                continue;
+            }
+            if (flush == MZ_FINISH ? status == MZ_STREAM_END : m_Stream.avail_in == 0)
+                return;
+        }
+    }
+
+    void PngWriter::finish()
+    {
+        if (m_RowsWritten != m_Height)
+            throw std::runtime_error("PNG Image is missing rows : " + m_FileName);
+
+        compress(MZ_FINISH);
+        const size_t remaining = m_Output.size() - m_Stream.avail_out;
+        if (remaining > 0)
+            writeChunk("IDAT", m_Output.data(), remaining);
+        writeChunk("IEND", nullptr, 0);
+
+        mz_deflateEnd(&m_Stream);
+        m_StreamInitialized = false;
+        if (std::fclose(m_File) != 0)
+        {
+            m_File = nullptr;
+            throw std::runtime_error("Failed to write PNG Image : " + m_FileName);
+        }
+        m_File = nullptr;
+    }
+
+    void PngWriter::writeChunk(const char type[4], const uint8_t* data, size_t length)
+    {
+        uint8_t header[8];
+        writeBE32(header, uint32_t(length));
+        std::memcpy(header + 4, type, 4);
+        write(header, 8);
+        if (length > 0)
+            write(data, length);
+
+        mz_ulong crc = mz_crc32(MZ_CRC32_INIT, header + 4, 4);
+        if (length > 0)
+            crc = mz_crc32(crc, data, length);
+        uint8_t footer[4];
+        writeBE32(footer, uint32_t(crc));
+        write(footer, 4);
+    }
+
+    void PngWriter::write(const void* data, size_t length)
+    {
+        if (std::fwrite(data, 1, length, m_File) != length)
+            throw std::runtime_error("Failed to write PNG Image : " + m_FileName);
+    }
+}
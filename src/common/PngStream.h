@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <miniz.h>
+
+namespace img
+{
+    // Decodes a PNG a few rows at a time, so only the compressed stream window and two
+    // rows are held in memory instead of the whole image. Every color type and bit
+    // depth is converted to RGBA8. Interlaced files cannot be decoded row by row, check
+    // interlaced() before reading.
+    class PngReader
+    {
+    public:
+        explicit PngReader(const std::string& fileName);
+        ~PngReader();
+
+        PngReader(const PngReader&) = delete;
+        PngReader& operator=(const PngReader&) = delete;
+
+        uint32_t width() const { return m_Width; }
+        uint32_t height() const { return m_Height; }
+        bool interlaced() const { return m_Interlaced; }
+        // Fewest 8-bit channels that hold the image without loss: 1 for grayscale, 3 for
+        // opaque color, 4 when any pixel can be transparent
+        uint32_t compactChannels() const;
+
+        // Decodes the next count rows as 8-bit pixels with channels channels, 4 or
+        // compactChannels(), into dst, rows rowPitch bytes apart. Returns the number of
+        // rows decoded, less than count at the end of the image.
+        uint32_t readRows(uint8_t* dst, uint32_t rowPitch, uint32_t count, uint32_t channels = 4);
+
+    private:
+        void readHeader();
+        bool readChunkHeader(uint32_t& length, char type[4]);
+        void readChunkData(std::vector<uint8_t>& data, uint32_t length);
+        void skip(uint64_t length);
+        void fillInput();
+        void inflateRow();
+        void unfilterRow();
+        void expandRow(uint8_t* dst) const;
+        void expandRow(uint8_t* dst, uint32_t channels);
+
+        std::string m_FileName;
+        FILE* m_File = nullptr;
+        mz_stream m_Stream{};
+        bool m_StreamInitialized = false;
+
+        uint32_t m_Width = 0, m_Height = 0;
+        uint8_t m_BitDepth = 0, m_ColorType = 0;
+        bool m_Interlaced = false;
+        uint32_t m_Channels = 0;
+        uint32_t m_FilterBpp = 0; // bytes per complete pixel, at least 1, for the filters
+        size_t m_Stride = 0;      // bytes per unfiltered row
+
+        std::vector<uint8_t> m_Palette; // RGBA entries
+        bool m_HasColorKey = false;
+        uint16_t m_ColorKey[3]{};
+
+        uint64_t m_ChunkRemaining = 0; // bytes of the current IDAT chunk not yet read
+        std::vector<uint8_t> m_Input;
+        std::vector<uint8_t> m_Row;     // filter byte followed by the current row
+        std::vector<uint8_t> m_PrevRow; // previous unfiltered row, zero before the first
+        std::vector<uint8_t> m_Expanded; // RGBA8 row repacked to fewer channels
+        uint32_t m_RowsRead = 0;
+    };
+
+    // Encodes 8-bit gray, RGB or RGBA rows into a PNG as they arrive, compressing into
+    // fixed size IDAT chunks. Each row gets the filter with the smallest sum of absolute
+    // differences, the same heuristic stb_image_write uses.
+    class PngWriter
+    {
+    public:
+        // Rows hold channels channels: 1, 3 or 4. Level 2 already compresses better than
+        // stb_image_write at its default of 8, at a fraction of the time.
+        PngWriter(const std::string& fileName, uint32_t width, uint32_t height, uint32_t channels = 4, int compressionLevel = 2);
+        ~PngWriter();
+
+        PngWriter(const PngWriter&) = delete;
+        PngWriter& operator=(const PngWriter&) = delete;
+
+        void writeRows(const uint8_t* src, uint32_t rowPitch, uint32_t count);
+        // Writes the remaining compressed data and IEND. Every row must have been written.
+        void finish();
+
+    private:
+        void filterRow(const uint8_t* row);
+        void compress(int flush);
+        void writeChunk(const char type[4], const uint8_t* data, size_t length);
+        void write(const void* data, size_t length);
+
+        std::string m_FileName;
+        FILE* m_File = nullptr;
+        mz_stream m_Stream{};
+        bool m_StreamInitialized = false;
+
+        uint32_t m_Width = 0, m_Height = 0;
+        uint32_t m_Channels = 4;
+        uint32_t m_RowsWritten = 0;
+        std::vector<uint8_t> m_PrevRow;
+        std::vector<uint8_t> m_Filtered;  // filter byte followed by the filtered row
+        std::vector<uint8_t> m_Candidate;
+        std::vector<uint8_t> m_Output;    // compressed data of the IDAT chunk being filled
+    };
+}
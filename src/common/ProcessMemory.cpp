@@ -0,0 +1,35 @@
+#include "ProcessMemory.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fstream>
+#include <sstream>
+#include <string>
+#endif
+
+uint64_t GetPeakResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.rfind("VmHWM:", 0) == 0)
+        {
+            std::istringstream fields(line.substr(6));
+            uint64_t kibibytes = 0;
+            fields >> kibibytes;
+            return kibibytes * 1024;
+        }
+    }
+    return 0;
+#endif
+}
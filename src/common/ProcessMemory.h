@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// High-water mark of the process' resident memory in bytes (VmHWM on Linux, peak
+// working set on Windows). Returns 0 where it cannot be queried.
+uint64_t GetPeakResidentBytes();
@@ -3,8 +3,14 @@
 #include <vector>
 #include <algorithm>
 #include "vk_nv_sharpen.h"
+#include "common/ExecutablePath.h"
+#include "pipeline/image_pipeline.h"
+#include "pipeline/atlas_batcher.h"
+#include "pipeline/band_streamer.h"
+#include "benchmark/benchmark.h"
+#include "tuning/autotuner.h"
 
-std::vector<std::string> GetImageFilesInDirectory(const std::string& directoryPath)
+std::vector<std::string> GetImageFilesInDirectory(const std::string& directoryPath, bool includeNV12)
 {
     std::vector<std::string> filePaths;
     for (const auto& entry : std::filesystem::directory_iterator(directoryPath))
@@ -13,7 +19,8 @@ std::vector<std::string> GetImageFilesInDirectory(const std::string& directoryPa
         {
             std::string extension = entry.path().extension().string();
             std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
-            if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".bmp")
+            if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".bmp"
+                || (includeNV12 && extension == ".nv12"))
             {
                 filePaths.push_back(entry.path().string());
             }
@@ -37,34 +44,222 @@ std::filesystem::path CreateOutputDirectory(const std::filesystem::path& executa
     return outputDir;
 }
 
+struct Options
+{
+    std::string DirectoryPath;
+    float Sharpness = 100.0f;  // Default to 100% sharpness
+    uint32_t FramesInFlight = VkNVSharpen::DefaultFramesInFlight;
+    bool LowLatency = false;
+    VkDeviceSize ImageCacheBudget = VkNVSharpen::DefaultImageCacheBudget;
+    uint32_t TileSize = VkNVSharpen::DefaultTileSize;
+    uint32_t StreamBandHeight = 0;
+    bool DirectImages = true;
+    bool HostImport = false;
+    bool BufferIO = false;
+    bool YUVOutput = false;
+    uint32_t NV12Width = 0, NV12Height = 0;
+    std::string Precision = "auto";
+    float OutputScale = 1.0f;
+    uint32_t OutputWidth = 0, OutputHeight = 0;
+    PipelineOptions Pipeline;
+    std::string Benchmark;
+    bool Autotune = false;
+    std::string TuningCache;
+    std::string PipelineCacheDirectory;
+    bool PipelineCache = true;
+    std::string ShaderDirectory;
+};
+
+constexpr const char* DefaultTuningCacheName = "nis_tuning.txt";
+
 void PrintUsage(const char* programName)
 {
-    std::cerr << "Usage: " << programName << " <directory_path> [sharpness]" << std::endl;
-    std::cerr << "  sharpness: Optional value between 0 and 100 (default is 50)" << std::endl;
+    std::cerr << "Usage: " << programName << " <directory_path> [sharpness] [options]" << std::endl;
+    std::cerr << "       " << programName << " --benchmark <name> [options]" << std::endl;
+    std::cerr << "       " << programName << " --autotune [directory_path] [options]" << std::endl;
+    std::cerr << "  sharpness: Optional value between 0 and 100 (default is 100)" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --frames-in-flight <n>  Images kept in flight on the GPU at once (default is "
+              << VkNVSharpen::DefaultFramesInFlight << ")" << std::endl;
+    std::cerr << "  --low-latency           Process one image at a time with a single submission and wait, print each image's latency" << std::endl;
+    std::cerr << "  --image-cache-mb <n>    Memory kept for reusing GPU images between same-sized inputs (default is "
+              << (VkNVSharpen::DefaultImageCacheBudget >> 20) << ")" << std::endl;
+    std::cerr << "  --tile-size <n>         Sharpen larger images as overlapping tiles of at most n x n (default is "
+              << VkNVSharpen::DefaultTileSize << ", 0 only tiles beyond the device limit)" << std::endl;
+    std::cerr << "  --no-direct-images      Stage uploads and readbacks even on devices with unified memory" << std::endl;
+    std::cerr << "  --host-import           Decode into host memory the GPU imports and copies from, where VK_EXT_external_memory_host is available" << std::endl;
+    std::cerr << "  --buffer-io             Sharpen straight from and into the staging buffers, without images or copies" << std::endl;
+    std::cerr << "  --yuv                   Write sharpened images as raw NV12 .yuv files, converted from RGBA on the GPU" << std::endl;
+    std::cerr << "  --precision <p>         NIS shader build: fp16, fp32 or auto, fp16 where the device supports it (default is auto)" << std::endl;
+    std::cerr << "  --scale <factor>        Upscale by 1 to 2 while sharpening, in one NVScaler pass" << std::endl;
+    std::cerr << "  --output-size <w>x<h>   Upscale every image to exactly this size while sharpening, 1x to 2x per axis" << std::endl;
+    std::cerr << "  --nv12 <w>x<h>          Also process .nv12 files as raw NV12 frames of this size, sharpening luma only" << std::endl;
+    std::cerr << "  --stream-band <rows>    Decode, sharpen and encode PNGs in bands of this many rows to bound host memory (default is 0, off; "
+              << BandStreamer::DefaultBandHeight << " is a good start)" << std::endl;
+    std::cerr << "  --decode-threads <n>    Threads decoding input images (default is "
+              << PipelineOptions().DecodeThreads << ", 0 runs every stage on one thread)" << std::endl;
+    std::cerr << "  --encode-threads <n>    Threads encoding output PNGs (default is "
+              << PipelineOptions().EncodeThreads << ", 0 runs every stage on one thread)" << std::endl;
+    std::cerr << "  --queue-depth <n>       Images buffered between pipeline stages (default is "
+              << PipelineOptions().QueueDepth << ")" << std::endl;
+    std::cerr << "  --atlas <size>          Pack small images into size x size atlases sharpened in one pass (default is 0, off)" << std::endl;
+    std::cerr << "  --atlas-max-image <n>   Largest width or height packed into an atlas (default is "
+              << AtlasOptions().MaxImageSize << ")" << std::endl;
+    std::cerr << "  --benchmark <name>      Run a built-in benchmark instead of processing a directory" << std::endl;
+    std::cerr << "  --autotune              Time the NIS shader configurations on this GPU and cache the fastest, which later runs load" << std::endl;
+    std::cerr << "  --tuning-cache <file>   Tuning cache file (default is " << DefaultTuningCacheName << " next to the executable)" << std::endl;
+    std::cerr << "  --pipeline-cache-dir <dir>  Directory of the per-device compiled pipeline cache (default is next to the executable)" << std::endl;
+    std::cerr << "  --no-pipeline-cache     Compile the pipelines on every start instead of caching them on disk" << std::endl;
+    std::cerr << "  --shader-dir <dir>      Load .spv files found in this directory instead of the shaders built into the executable" << std::endl;
+    std::cerr << "Benchmarks:" << std::endl;
+    PrintBenchmarks(std::cerr);
 }
 
-int main(int argc, char* argv[])
+uint32_t ParseCount(const std::string& name, const std::string& value, int minimum = 1)
 {
-    if (argc < 2 || argc > 3)
-    {
-        PrintUsage(argv[0]);
-        return 1;
-    }
+    int count = std::stoi(value);
+    if (count < minimum)
+        throw std::out_of_range(name + " must be at least " + std::to_string(minimum));
+    return static_cast<uint32_t>(count);
+}
 
-    std::string directoryPath = argv[1];
-    if (!std::filesystem::exists(directoryPath) || !std::filesystem::is_directory(directoryPath))
+// "<width>x<height>"
+void ParseSize(const std::string& name, const std::string& value, uint32_t& width, uint32_t& height)
+{
+    size_t separator = value.find('x');
+    if (separator == std::string::npos)
+        throw std::invalid_argument(name + " expects <width>x<height>");
+    width = ParseCount(name, value.substr(0, separator));
+    height = ParseCount(name, value.substr(separator + 1));
+}
+
+bool ParseArguments(int argc, char* argv[], Options& options)
+{
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i)
     {
-        std::cerr << "Error: The specified path is not a valid directory." << std::endl;
-        return 1;
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0)
+        {
+            positional.push_back(arg);
+            continue;
+        }
+
+        if (arg == "--low-latency")
+        {
+            options.LowLatency = true;
+            continue;
+        }
+        if (arg == "--no-direct-images")
+        {
+            options.DirectImages = false;
+            continue;
+        }
+        if (arg == "--host-import")
+        {
+            options.HostImport = true;
+            continue;
+        }
+        if (arg == "--buffer-io")
+        {
+            options.BufferIO = true;
+            continue;
+        }
+        if (arg == "--yuv")
+        {
+            options.YUVOutput = true;
+            continue;
+        }
+        if (arg == "--autotune")
+        {
+            options.Autotune = true;
+            continue;
+        }
+        if (arg == "--no-pipeline-cache")
+        {
+            options.PipelineCache = false;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Error: Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        try
+        {
+            if (arg == "--frames-in-flight")
+                options.FramesInFlight = ParseCount(arg, value);
+            else if (arg == "--image-cache-mb")
+                options.ImageCacheBudget = VkDeviceSize(ParseCount(arg, value, 0)) << 20;
+            else if (arg == "--tile-size")
+                options.TileSize = ParseCount(arg, value, 0);
+            else if (arg == "--precision")
+            {
+                if (value != "auto" && value != "fp16" && value != "fp32")
+                    throw std::invalid_argument("--precision expects fp16, fp32 or auto");
+                options.Precision = value;
+            }
+            else if (arg == "--scale")
+            {
+                options.OutputScale = std::stof(value);
+                if (!(options.OutputScale >= 1.0f && options.OutputScale <= 2.0f))
+                    throw std::out_of_range("--scale must be between 1 and 2");
+            }
+            else if (arg == "--output-size")
+                ParseSize(arg, value, options.OutputWidth, options.OutputHeight);
+            else if (arg == "--nv12")
+                ParseSize(arg, value, options.NV12Width, options.NV12Height);
+            else if (arg == "--stream-band")
+                options.StreamBandHeight = ParseCount(arg, value, 0);
+            else if (arg == "--decode-threads")
+                options.Pipeline.DecodeThreads = ParseCount(arg, value, 0);
+            else if (arg == "--encode-threads")
+                options.Pipeline.EncodeThreads = ParseCount(arg, value, 0);
+            else if (arg == "--queue-depth")
+                options.Pipeline.QueueDepth = ParseCount(arg, value);
+            else if (arg == "--atlas")
+                options.Pipeline.Atlas.Size = ParseCount(arg, value, 0);
+            else if (arg == "--atlas-max-image")
+                options.Pipeline.Atlas.MaxImageSize = ParseCount(arg, value);
+            else if (arg == "--benchmark")
+                options.Benchmark = value;
+            else if (arg == "--tuning-cache")
+                options.TuningCache = value;
+            else if (arg == "--pipeline-cache-dir")
+                options.PipelineCacheDirectory = value;
+            else if (arg == "--shader-dir")
+                options.ShaderDirectory = value;
+            else
+            {
+                std::cerr << "Error: Unknown option " << arg << std::endl;
+                return false;
+            }
+        }
+        catch (const std::exception&)
+        {
+            std::cerr << "Error: Invalid value for " << arg << ": " << value << std::endl;
+            return false;
+        }
     }
 
-    float sharpness = 100.0f;  // Default to 100% sharpness
-    if (argc == 3)
+    if (!options.Benchmark.empty())
+        return positional.empty();
+    // Tuning alone needs no directory
+    if (options.Autotune && positional.empty())
+        return true;
+
+    if (positional.empty() || positional.size() > 2)
+        return false;
+
+    options.DirectoryPath = positional[0];
+    if (positional.size() == 2)
     {
         try
         {
-            sharpness = std::stof(argv[2]);
-            if (sharpness < 0.0f || sharpness > 100.0f)
+            options.Sharpness = std::stof(positional[1]);
+            if (options.Sharpness < 0.0f || options.Sharpness > 100.0f)
             {
                 throw std::out_of_range("Sharpness value out of range");
             }
@@ -72,8 +267,88 @@ int main(int argc, char* argv[])
         catch (const std::exception&)
         {
             std::cerr << "Error: Invalid sharpness value. Must be between 0 and 100." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Tunes the device and stores the winner in the cache file
+bool RunAutotune(VkNVSharpen& app, const std::string& cachePath)
+{
+    try
+    {
+        TuningCache cache(cachePath);
+        cache.Store(app.GetDeviceProperties(), Autotune(app, std::cout));
+        std::cout << "Tuning saved to " << cachePath << std::endl;
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Applies the cached configuration of this device and driver, if it was tuned
+void LoadTunedConfig(VkNVSharpen& app, const std::string& cachePath)
+{
+    std::optional<TunedConfig> config = TuningCache(cachePath).Find(app.GetDeviceProperties());
+    if (!config)
+        return;
+    try
+    {
+        ApplyTunedConfig(app, *config);
+        std::cout << "Tuned configuration: " << FormatTunedConfig(*config) << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Ignoring the tuned configuration in " << cachePath << ": " << e.what() << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!ParseArguments(argc, argv, options))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (!options.Benchmark.empty())
+    {
+        BenchmarkOptions benchmarkOptions;
+        benchmarkOptions.FramesInFlight = options.FramesInFlight;
+        benchmarkOptions.ImageCacheBudget = options.ImageCacheBudget;
+        benchmarkOptions.Sharpness = options.Sharpness;
+        if (!RunBenchmark(options.Benchmark, benchmarkOptions))
+        {
+            std::cerr << "Error: Unknown benchmark " << options.Benchmark << std::endl;
+            PrintUsage(argv[0]);
             return 1;
         }
+        return 0;
+    }
+
+    const std::filesystem::path executableDirectory = GetExecutableDirectory();
+    const std::string tuningCachePath = options.TuningCache.empty()
+            ? (executableDirectory / DefaultTuningCacheName).string()
+            : options.TuningCache;
+    std::optional<std::string> pipelineCacheDirectory;
+    if (options.PipelineCache)
+        pipelineCacheDirectory = options.PipelineCacheDirectory.empty() ? executableDirectory.string() : options.PipelineCacheDirectory;
+    if (options.DirectoryPath.empty())
+    {
+        VkNVSharpen app(options.FramesInFlight, options.ImageCacheBudget, pipelineCacheDirectory, options.ShaderDirectory);
+        return RunAutotune(app, tuningCachePath) ? 0 : 1;
+    }
+
+    const std::string& directoryPath = options.DirectoryPath;
+    if (!std::filesystem::exists(directoryPath) || !std::filesystem::is_directory(directoryPath))
+    {
+        std::cerr << "Error: The specified path is not a valid directory." << std::endl;
+        return 1;
     }
 
     std::filesystem::path outputDir;
@@ -87,10 +362,49 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    auto* app = new VkNVSharpen();
-    app->SetSharpness(sharpness);
+    auto* app = new VkNVSharpen(options.FramesInFlight, options.ImageCacheBudget, pipelineCacheDirectory, options.ShaderDirectory);
+    app->SetSharpness(options.Sharpness);
+    // Before any other setting, so the tuning times the plain image path
+    if (options.Autotune)
+    {
+        if (!RunAutotune(*app, tuningCachePath))
+        {
+            delete app;
+            return 1;
+        }
+    }
+    else
+    {
+        LoadTunedConfig(*app, tuningCachePath);
+    }
+    app->SetLowLatency(options.LowLatency);
+    app->SetTileSize(options.TileSize);
+    app->SetDirectImages(options.DirectImages);
+    app->SetHostImport(options.HostImport);
+    if (options.HostImport && !app->UsesHostImport())
+        std::cout << "VK_EXT_external_memory_host is not supported, staging uploads instead" << std::endl;
+    app->SetBufferIO(options.BufferIO);
+    app->SetYUVOutput(options.YUVOutput);
+    const bool nv12 = options.NV12Width > 0;
+    try
+    {
+        if (options.Precision != "auto")
+            app->SetPrecision(options.Precision == "fp16" ? NISPrecision::Half : NISPrecision::Full);
+        if (options.OutputWidth > 0)
+            app->SetOutputSize(options.OutputWidth, options.OutputHeight);
+        else if (options.OutputScale != 1.0f)
+            app->SetOutputScale(options.OutputScale);
+        if (nv12)
+            app->SetNV12FrameSize(options.NV12Width, options.NV12Height);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        delete app;
+        return 1;
+    }
 
-    std::vector<std::string> filePaths = GetImageFilesInDirectory(directoryPath);
+    std::vector<std::string> filePaths = GetImageFilesInDirectory(directoryPath, nv12);
 
     if (filePaths.empty())
     {
@@ -99,11 +413,49 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-    for (const auto& path : filePaths)
+    if (options.StreamBandHeight > 0)
     {
-        std::cout << "Processing: " << path << std::endl;
-        app->ProcessImage(path, outputDir.string());
+        // Images that cannot be streamed are loaded whole
+        BandStreamer streamer(*app, options.StreamBandHeight);
+        for (const auto& path : filePaths)
+        {
+            std::cout << "Processing: " << path << std::endl;
+            std::string extension = std::filesystem::path(path).extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if (extension != ".png" || !streamer.Process(path, outputDir.string()))
+                app->ProcessImage(path, outputDir.string());
+        }
+        app->Flush();
     }
+    else if (options.LowLatency || options.Pipeline.DecodeThreads == 0 || options.Pipeline.EncodeThreads == 0)
+    {
+        if (options.Pipeline.Atlas.Size > 0 && !options.LowLatency)
+        {
+            AtlasBatcher batcher(*app, options.Pipeline.Atlas);
+            for (const auto& path : filePaths)
+            {
+                std::cout << "Processing: " << path << std::endl;
+                batcher.Submit(app->LoadImage(path, outputDir.string(), false));
+            }
+            batcher.Flush();
+        }
+        else
+        {
+            for (const auto& path : filePaths)
+            {
+                std::cout << "Processing: " << path << std::endl;
+                app->ProcessImage(path, outputDir.string());
+            }
+            app->Flush();
+        }
+    }
+    else
+    {
+        ImagePipeline pipeline(*app, options.Pipeline);
+        pipeline.Run(filePaths, outputDir.string());
+    }
+
+    app->PrintStats(std::cout);
 
     delete app;
     return 0;
@@ -0,0 +1,339 @@
+// The MIT License(MIT)
+//
+// Copyright(c) 2022 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files(the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "NVScaler.h"
+
+#include <iostream>
+#include <array>
+#include <cstring>
+
+#include "VKUtilities.h"
+#include "../vulkan/vulkan_utils.h"
+#include "../vulkan/vulkan_pipeline_cache.h"
+#include "../vulkan/vulkan_staging_ring.h"
+
+
+NVScaler::NVScaler(VulkanDevice& deviceRef, bool glsl, uint32_t frameCount,
+                   NISPrecision precision, NISBlockSize blockSize)
+    : m_DeviceRef(deviceRef), m_Frames(std::max(frameCount, 1u))
+{
+    const NISBlockSize hlslBlockSize = NISBlockSize::GetHLSL(true, precision);
+    m_BlockSize = blockSize.IsSet() ? blockSize : glsl ? NISBlockSize::GetOptimal(true, precision) : hlslBlockSize;
+    if (!glsl && m_BlockSize != hlslBlockSize)
+        throw std::runtime_error("The HLSL NIS shaders only run with the block size they were compiled with");
+    // shPixelsY, shCoefScaler, shCoefUSM and shEdgeMap in NIS_Scaler.h, at fp32
+    m_BlockSize.Validate(m_DeviceRef.PhysicalDeviceProperties.limits,
+                         uint32_t(sizeof(float) * ((m_BlockSize.Width + 6) * (m_BlockSize.Height + 6) + 2 * 64 * 6 +
+                                                   4 * (m_BlockSize.Width + 2) * (m_BlockSize.Height + 2))));
+
+    // Shader
+    {
+        const std::string shaderName = GetNISShaderName("nis_scaler", precision, glsl);
+        m_ShaderModule = m_DeviceRef.CreateShaderModule(shaderName);
+    }
+
+    // Texture sampler
+    {
+        VkSamplerCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        info.magFilter = VK_FILTER_LINEAR;
+        info.minFilter = VK_FILTER_LINEAR;
+        info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        info.minLod = -1000;
+        info.maxLod = 1000;
+        info.maxAnisotropy = 1.0f;
+        VK_CHECK_RESULT(vkCreateSampler(m_DeviceRef.GetDevice(), &info, nullptr, &m_Sampler));
+    }
+
+    // Descriptor set
+    {
+        std::array<VkDescriptorSetLayoutBinding, 6> bindLayout
+        {
+            {
+                VK_COMMON_DESC_LAYOUT(&m_Sampler),
+                { COEF_SCALAR_BINDING, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+                { COEF_USM_BINDING, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT }
+            }
+        };
+
+        VkDescriptorSetLayoutCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        info.bindingCount = (uint32_t)bindLayout.size();
+        info.pBindings = bindLayout.data();
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_DeviceRef.GetDevice(), &info, nullptr, &m_DescriptorSetLayout));
+    }
+
+    for (auto& frame : m_Frames)
+    {
+        VkDescriptorSetAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        info.descriptorPool = m_DeviceRef.GetDescriptorPool();
+        info.descriptorSetCount = 1;
+        info.pSetLayouts = &m_DescriptorSetLayout;
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(m_DeviceRef.GetDevice(), &info, &frame.DescriptorSet));
+    }
+
+    // Constant buffer, one slot per frame in flight
+    {
+        m_ConstantBuffer = std::make_unique<VulkanBuffer>(
+                m_DeviceRef,
+                sizeof(NISConfig),
+                static_cast<uint32_t>(m_Frames.size()),
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                m_DeviceRef.PhysicalDeviceProperties.limits.minUniformBufferOffsetAlignment);
+        m_ConstantBuffer->Map();
+    }
+
+    // The constant buffer slot and the coefficients never change, so they are written
+    // into every frame's set once
+    CreateCoefficientTextures(precision);
+    for (size_t i = 0; i < m_Frames.size(); ++i)
+    {
+        VkDescriptorBufferInfo descBuffInfo = m_ConstantBuffer->DescriptorInfoForIndex(static_cast<int>(i));
+        VkDescriptorImageInfo coefScalerInfo{ VK_NULL_HANDLE, m_CoefScaler.View, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkDescriptorImageInfo coefUsmInfo{ VK_NULL_HANDLE, m_CoefUsm.View, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+        std::array<VkWriteDescriptorSet, 3> writeDescSets{};
+        for (auto& write : writeDescSets)
+        {
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = m_Frames[i].DescriptorSet;
+            write.descriptorCount = 1;
+        }
+        writeDescSets[0].dstBinding = CB_BINDING;
+        writeDescSets[0].descriptorType = CB_DESC_TYPE;
+        writeDescSets[0].pBufferInfo = &descBuffInfo;
+        writeDescSets[1].dstBinding = COEF_SCALAR_BINDING;
+        writeDescSets[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        writeDescSets[1].pImageInfo = &coefScalerInfo;
+        writeDescSets[2].dstBinding = COEF_USM_BINDING;
+        writeDescSets[2].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        writeDescSets[2].pImageInfo = &coefUsmInfo;
+        vkUpdateDescriptorSets(m_DeviceRef.GetDevice(), (uint32_t)writeDescSets.size(), writeDescSets.data(), 0, nullptr);
+    }
+
+    // Pipeline layout
+    {
+        VkPushConstantRange pushConstRange{};
+        pushConstRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstRange.size = sizeof(NISConfig);
+        VkPipelineLayoutCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        info.setLayoutCount = 1;
+        info.pSetLayouts = &m_DescriptorSetLayout;
+        info.pushConstantRangeCount = 1;
+        info.pPushConstantRanges = &pushConstRange;
+
+        VK_CHECK_RESULT(vkCreatePipelineLayout(m_DeviceRef.GetDevice(), &info, nullptr, &m_PipelineLayout));
+    }
+
+    // Compute pipeline
+    {
+        VkPipelineShaderStageCreateInfo pipeShaderStageCreateInfo{};
+        pipeShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipeShaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipeShaderStageCreateInfo.module = m_ShaderModule;
+        pipeShaderStageCreateInfo.pName = "main";
+        const VkSpecializationInfo specializationInfo = m_BlockSize.GetSpecializationInfo();
+        pipeShaderStageCreateInfo.pSpecializationInfo = &specializationInfo;
+
+        VkComputePipelineCreateInfo csPipeCreateInfo{};
+        csPipeCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        csPipeCreateInfo.stage = pipeShaderStageCreateInfo;
+        csPipeCreateInfo.layout = m_PipelineLayout;
+        m_DeviceRef.GetPipelineCache().CreateComputePipeline(csPipeCreateInfo, &m_Pipeline);
+    }
+}
+
+void NVScaler::CreateCoefficientTextures(NISPrecision precision)
+{
+    // kPhaseCount rows of kFilterSize taps, four taps per texel
+    const bool half = precision == NISPrecision::Half;
+    const VkFormat format = half ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R32G32B32A32_SFLOAT;
+    const uint32_t width = kFilterSize / 4;
+    const uint32_t height = kPhaseCount;
+    const VkDeviceSize size = half ? sizeof(coef_scale_fp16) : sizeof(coef_scale);
+
+    VulkanStagingRing& ring = m_DeviceRef.GetUploadRing();
+    const StagingAllocation upload = ring.Allocate(size * 2, 16);
+    std::memcpy(upload.Mapped, half ? static_cast<const void*>(coef_scale_fp16) : coef_scale, size);
+    std::memcpy(static_cast<uint8_t*>(upload.Mapped) + size, half ? static_cast<const void*>(coef_usm_fp16) : coef_usm, size);
+    ring.Flush(upload);
+
+    VkCommandBuffer cmd = m_DeviceRef.BeginSingleTimeCommands();
+    CoefficientTexture* textures[] = { &m_CoefScaler, &m_CoefUsm };
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        CoefficientTexture& texture = *textures[i];
+        {
+            VkImageCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            info.imageType = VK_IMAGE_TYPE_2D;
+            info.extent = { width, height, 1 };
+            info.mipLevels = 1;
+            info.arrayLayers = 1;
+            info.format = format;
+            info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            info.samples = VK_SAMPLE_COUNT_1_BIT;
+            VK_CHECK_RESULT(vkCreateImage(m_DeviceRef.GetDevice(), &info, nullptr, &texture.Image));
+        }
+        texture.Memory = m_DeviceRef.GetAllocator().AllocateForImage(texture.Image, MemoryUsage::GpuOnly);
+        {
+            VkImageViewCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            info.image = texture.Image;
+            info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            info.format = format;
+            info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            info.subresourceRange.layerCount = 1;
+            info.subresourceRange.levelCount = 1;
+            VK_CHECK_RESULT(vkCreateImageView(m_DeviceRef.GetDevice(), &info, nullptr, &texture.View));
+        }
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = texture.Image;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = upload.Offset + size * i;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { width, height, 1 };
+        vkCmdCopyBufferToImage(cmd, upload.Buffer, texture.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+    m_DeviceRef.EndSingleTimeCommand(cmd);
+    ring.Release(upload);
+}
+
+void NVScaler::Cleanup()
+{
+    vkDestroyPipeline(m_DeviceRef.GetDevice(), m_Pipeline, nullptr);
+    vkDestroyPipelineLayout(m_DeviceRef.GetDevice(), m_PipelineLayout, nullptr);
+    for (auto& frame : m_Frames)
+        vkFreeDescriptorSets(m_DeviceRef.GetDevice(), m_DeviceRef.GetDescriptorPool(), 1, &frame.DescriptorSet);
+    vkDestroyDescriptorSetLayout(m_DeviceRef.GetDevice(), m_DescriptorSetLayout, nullptr);
+    for (CoefficientTexture* texture : { &m_CoefScaler, &m_CoefUsm })
+    {
+        vkDestroyImageView(m_DeviceRef.GetDevice(), texture->View, nullptr);
+        vkDestroyImage(m_DeviceRef.GetDevice(), texture->Image, nullptr);
+        m_DeviceRef.GetAllocator().Free(texture->Memory);
+    }
+    vkDestroySampler (m_DeviceRef.GetDevice(), m_Sampler, nullptr);
+    vkDestroyShaderModule(m_DeviceRef.GetDevice(), m_ShaderModule, nullptr);
+}
+
+bool NVScaler::SupportsScale(uint32_t inputWidth, uint32_t inputHeight, uint32_t outputWidth, uint32_t outputHeight)
+{
+    return outputWidth >= inputWidth && outputHeight >= inputHeight &&
+           uint64_t(outputWidth) <= uint64_t(inputWidth) * 2 && uint64_t(outputHeight) <= uint64_t(inputHeight) * 2;
+}
+
+void NVScaler::Update(uint32_t frameIndex, float sharpness, uint32_t inputWidth, uint32_t inputHeight, uint32_t outputWidth, uint32_t outputHeight)
+{
+    FrameState& frame = m_Frames[frameIndex];
+    if (!NVScalerUpdateConfig(frame.NisConfig, sharpness,
+                              0, 0,
+                              inputWidth, inputHeight,
+                              inputWidth, inputHeight,
+                              0, 0,
+                              outputWidth, outputHeight,
+                              outputWidth, outputHeight,
+                              NISHDRMode::None))
+        throw std::runtime_error("NVScaler scales by 1x to 2x, not " + std::to_string(inputWidth) + "x" + std::to_string(inputHeight) +
+                                 " to " + std::to_string(outputWidth) + "x" + std::to_string(outputHeight));
+    frame.OutputWidth = outputWidth;
+    frame.OutputHeight = outputHeight;
+}
+
+void NVScaler::Dispatch(VkCommandBuffer cmdBuffer, uint32_t frameIndex, VkImageView inputImageView, VkImageView outputImageView)
+{
+    FrameState& frame = m_Frames[frameIndex];
+
+    VkWriteDescriptorSet inWriteDescSet{};
+    VkWriteDescriptorSet outWriteDescSet{};
+
+    VkDescriptorImageInfo inDescInfo{};
+    inDescInfo.imageView = inputImageView;
+    inDescInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    inWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    inWriteDescSet.dstSet = frame.DescriptorSet;
+    inWriteDescSet.dstBinding = IN_TEX_BINDING;
+    inWriteDescSet.descriptorCount = 1;
+    inWriteDescSet.descriptorType = IN_TEX_DESC_TYPE;
+    inWriteDescSet.pImageInfo = &inDescInfo;
+
+    VkDescriptorImageInfo outDescInfo{};
+    outDescInfo.imageView = outputImageView;
+    outDescInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    outWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    outWriteDescSet.dstSet = frame.DescriptorSet;
+    outWriteDescSet.dstBinding = OUT_TEX_BINDING;
+    outWriteDescSet.descriptorCount = 1;
+    outWriteDescSet.descriptorType = OUT_TEX_DESC_TYPE;
+    outWriteDescSet.pImageInfo = &outDescInfo;
+    const VkWriteDescriptorSet writeDescSets[] =
+    {
+        inWriteDescSet,
+        outWriteDescSet
+    };
+
+    m_ConstantBuffer->WriteToIndex(&frame.NisConfig, static_cast<int>(frameIndex));
+    vkUpdateDescriptorSets(m_DeviceRef.GetDevice(), static_cast<uint32_t>(std::size(writeDescSets)), writeDescSets, 0, nullptr);
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+    vkCmdBindDescriptorSets(
+            cmdBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_PipelineLayout,
+            0, 1,
+            &frame.DescriptorSet,
+            0,
+            VK_NULL_HANDLE);
+
+    // One block per output tile, the scaler works in output space
+    auto gridX = uint32_t(std::ceil(frame.OutputWidth / float(m_BlockSize.Width)));
+    auto gridY = uint32_t(std::ceil(frame.OutputHeight / float(m_BlockSize.Height)));
+    vkCmdDispatch(cmdBuffer, gridX, gridY, 1);
+}
+
+NVScaler::~NVScaler()
+{
+    Cleanup();
+}
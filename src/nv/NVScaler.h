@@ -0,0 +1,81 @@
+// The MIT License(MIT)
+//
+// Copyright(c) 2022 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files(the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and / or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <iostream>
+#include <memory>
+
+#include "NVSharpen.h"
+#include "VKUtilities.h"
+#include "../../NIS/NIS_Config.h"
+#include "../vulkan/vulkan_device.h"
+#include "../vulkan/vulkan_buffer.h"
+
+// NIS upscaler: scales RGBA8 images by 1x to 2x per axis and sharpens them in the same
+// pass. The filter coefficient textures are uploaded once at construction and bound
+// in every frame's descriptor set, as fp16 for the Half build and fp32 otherwise.
+class NVScaler
+{
+public:
+    // frameCount as for NVSharpen, one descriptor set and constant buffer slot per frame
+    // blockSize defaults as for NVSharpen, with the scaler's sizes
+    NVScaler(VulkanDevice& deviceRef, bool glsl, uint32_t frameCount = 1,
+             NISPrecision precision = NISPrecision::Half, NISBlockSize blockSize = {});
+    ~NVScaler();
+    // The output must be 1x to 2x the input on both axes
+    [[nodiscard]] static bool SupportsScale(uint32_t inputWidth, uint32_t inputHeight, uint32_t outputWidth, uint32_t outputHeight);
+    void Update(uint32_t frameIndex, float sharpness, uint32_t inputWidth, uint32_t inputHeight, uint32_t outputWidth, uint32_t outputHeight);
+    void Dispatch(VkCommandBuffer cmdBuffer, uint32_t frameIndex, VkImageView inputImageView, VkImageView outputImageView);
+    [[nodiscard]] const NISBlockSize& GetBlockSize() const { return m_BlockSize; }
+    void Cleanup();
+private:
+    struct FrameState
+    {
+        NISConfig       NisConfig{};
+        VkDescriptorSet DescriptorSet = VK_NULL_HANDLE;
+        uint32_t        OutputWidth = 1;
+        uint32_t        OutputHeight = 1;
+    };
+
+    struct CoefficientTexture
+    {
+        VkImage          Image = VK_NULL_HANDLE;
+        MemoryAllocation Memory;
+        VkImageView      View = VK_NULL_HANDLE;
+    };
+
+    void CreateCoefficientTextures(NISPrecision precision);
+
+    VulkanDevice&                    m_DeviceRef;
+    std::vector<FrameState>          m_Frames;
+    std::unique_ptr<VulkanBuffer>    m_ConstantBuffer;
+
+    VkShaderModule                      m_ShaderModule = VK_NULL_HANDLE;
+    VkDescriptorSetLayout               m_DescriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout                    m_PipelineLayout = VK_NULL_HANDLE;
+    VkPipeline                          m_Pipeline = VK_NULL_HANDLE;
+    VkSampler                           m_Sampler{};
+    CoefficientTexture                  m_CoefScaler;
+    CoefficientTexture                  m_CoefUsm;
+
+    NISBlockSize                        m_BlockSize;
+};
@@ -23,44 +23,34 @@
 
 #include <iostream>
 #include <array>
-#include <filesystem>
 
 #include "VKUtilities.h"
 #include "../vulkan/vulkan_utils.h"
+#include "../vulkan/vulkan_pipeline_cache.h"
 
 
-NVSharpen::NVSharpen(VulkanDevice& deviceRef, const std::vector<std::string>& shaderPaths, bool glsl)
-    : m_DeviceRef(deviceRef) , m_OutputWidth(1), m_OutputHeight(1)
+NVSharpen::NVSharpen(VulkanDevice& deviceRef, bool glsl, uint32_t frameCount, Variant variant,
+                     NISPrecision precision, NISBlockSize blockSize)
+    : m_DeviceRef(deviceRef), m_Frames(std::max(frameCount, 1u)), m_Variant(variant)
 {
-    NISOptimizer opt(false, NISGPUArchitecture::NVIDIA_Generic);
-    m_BlockWidth = opt.GetOptimalBlockWidth();
-    m_BlockHeight = opt.GetOptimalBlockHeight();
-    uint32_t threadGroupSize = opt.GetOptimalThreadGroupSize();
+    const bool bufferIO = variant == Variant::Buffer;
+    const NISBlockSize hlslBlockSize = NISBlockSize::GetHLSL(false, precision);
+    m_BlockSize = blockSize.IsSet() ? blockSize : glsl ? NISBlockSize::GetOptimal(false, precision) : hlslBlockSize;
+    if (!glsl && m_BlockSize != hlslBlockSize)
+        throw std::runtime_error("The HLSL NIS shaders only run with the block size they were compiled with");
+    // shPixelsY in NIS_Scaler.h, at fp32
+    m_BlockSize.Validate(m_DeviceRef.PhysicalDeviceProperties.limits,
+                         uint32_t(sizeof(float) * (m_BlockSize.Width + 6) * (m_BlockSize.Height + 6)));
 
     // Shader
     {
-        std::string shaderName = glsl ? "/nis_sharpen_glsl.spv" : "/nis_sharpen.spv";
-        std::string shaderPath;
-        for (auto& e : shaderPaths)
-        {
-            if (std::filesystem::exists(e + "/" + shaderName))
-            {
-                shaderPath = e + "/" + shaderName;
-                break;
-            }
-        }
-        if (shaderPath.empty())
-            throw std::runtime_error("Shader file not found" + shaderName);
-
-        auto shaderBytes = readBytes(shaderPath);
-        VkShaderModuleCreateInfo info{};
-        info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        info.codeSize = shaderBytes.size();
-        info.pCode = reinterpret_cast<uint32_t*>(shaderBytes.data());
-        VK_CHECK_RESULT(vkCreateShaderModule(m_DeviceRef.GetDevice(), &info, nullptr, &m_ShaderModule));
+        const char* variantName = bufferIO ? "nis_sharpen_buffer" : variant == Variant::NV12 ? "nis_sharpen_nv12" : "nis_sharpen";
+        const std::string shaderName = GetNISShaderName(variantName, precision, glsl);
+        m_ShaderModule = m_DeviceRef.CreateShaderModule(shaderName);
     }
 
-    // Texture sampler
+    // Texture sampler, the buffer variant filters by hand
+    if (!bufferIO)
     {
         VkSamplerCreateInfo info{};
         info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -82,50 +72,59 @@ NVSharpen::NVSharpen(VulkanDevice& deviceRef, const std::vector<std::string>& sh
         {
             { VK_COMMON_DESC_LAYOUT(&m_Sampler) }
         };
+        std::array<VkDescriptorSetLayoutBinding, 3> bufferBindLayout
+        {
+            { VK_BUFFER_IO_DESC_LAYOUT }
+        };
 
         VkDescriptorSetLayoutCreateInfo info{};
         info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        info.bindingCount = (uint32_t)bindLayout.size();
-        info.pBindings = bindLayout.data();
+        info.bindingCount = bufferIO ? (uint32_t)bufferBindLayout.size() : (uint32_t)bindLayout.size();
+        info.pBindings = bufferIO ? bufferBindLayout.data() : bindLayout.data();
         VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_DeviceRef.GetDevice(), &info, nullptr, &m_DescriptorSetLayout));
     }
 
+    for (auto& frame : m_Frames)
     {
         VkDescriptorSetAllocateInfo info{};
         info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         info.descriptorPool = m_DeviceRef.GetDescriptorPool();
         info.descriptorSetCount = 1;
         info.pSetLayouts = &m_DescriptorSetLayout;
-        VK_CHECK_RESULT(vkAllocateDescriptorSets(m_DeviceRef.GetDevice(), &info, &m_DescriptorSet));
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(m_DeviceRef.GetDevice(), &info, &frame.DescriptorSet));
     }
 
-    // Constant buffer
+    // Constant buffer, one slot per frame in flight
     {
         m_ConstantBuffer = std::make_unique<VulkanBuffer>(
                 m_DeviceRef,
                 sizeof(NISConfig),
-                1,
+                static_cast<uint32_t>(m_Frames.size()),
                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                m_DeviceRef.PhysicalDeviceProperties.limits.minUniformBufferOffsetAlignment);
         m_ConstantBuffer->Map();
 
-        VkDescriptorBufferInfo descBuffInfo = m_ConstantBuffer->DescriptorInfoForIndex(0);
-        VkWriteDescriptorSet writeDescSet{};
-        writeDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writeDescSet.dstSet = m_DescriptorSet;
-        writeDescSet.dstBinding = CB_BINDING;
-        writeDescSet.descriptorCount = 1;
-        writeDescSet.descriptorType = CB_DESC_TYPE;
-        writeDescSet.dstArrayElement = 0;
-        writeDescSet.pBufferInfo = &descBuffInfo;
-        vkUpdateDescriptorSets(m_DeviceRef.GetDevice(), 1, &writeDescSet, 0, nullptr);
+        for (size_t i = 0; i < m_Frames.size(); ++i)
+        {
+            VkDescriptorBufferInfo descBuffInfo = m_ConstantBuffer->DescriptorInfoForIndex(static_cast<int>(i));
+            VkWriteDescriptorSet writeDescSet{};
+            writeDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescSet.dstSet = m_Frames[i].DescriptorSet;
+            writeDescSet.dstBinding = CB_BINDING;
+            writeDescSet.descriptorCount = 1;
+            writeDescSet.descriptorType = CB_DESC_TYPE;
+            writeDescSet.dstArrayElement = 0;
+            writeDescSet.pBufferInfo = &descBuffInfo;
+            vkUpdateDescriptorSets(m_DeviceRef.GetDevice(), 1, &writeDescSet, 0, nullptr);
+        }
     }
 
     // Pipeline layout
     {
         VkPushConstantRange pushConstRange{};
         pushConstRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-        pushConstRange.size = sizeof(m_NisConfig);
+        pushConstRange.size = sizeof(NISConfig);
         VkPipelineLayoutCreateInfo info{};
         info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         info.setLayoutCount = 1;
@@ -143,40 +142,56 @@ NVSharpen::NVSharpen(VulkanDevice& deviceRef, const std::vector<std::string>& sh
         pipeShaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
         pipeShaderStageCreateInfo.module = m_ShaderModule;
         pipeShaderStageCreateInfo.pName = "main";
+        const VkSpecializationInfo specializationInfo = m_BlockSize.GetSpecializationInfo();
+        pipeShaderStageCreateInfo.pSpecializationInfo = &specializationInfo;
 
         VkComputePipelineCreateInfo csPipeCreateInfo{};
         csPipeCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
         csPipeCreateInfo.stage = pipeShaderStageCreateInfo;
         csPipeCreateInfo.layout = m_PipelineLayout;
-        VK_CHECK_RESULT(vkCreateComputePipelines(m_DeviceRef.GetDevice(), VK_NULL_HANDLE, 1, &csPipeCreateInfo, nullptr, &m_Pipeline));
+        m_DeviceRef.GetPipelineCache().CreateComputePipeline(csPipeCreateInfo, &m_Pipeline);
     }
 }
 
+void NISBlockSize::Validate(const VkPhysicalDeviceLimits& limits, uint32_t sharedMemorySize) const
+{
+    const std::string name = std::to_string(Width) + "x" + std::to_string(Height) + " with " + std::to_string(ThreadGroupSize) + " threads";
+    if (Width == 0 || Height == 0 || ThreadGroupSize == 0 || ThreadGroupSize % Width != 0 || Width * Height % ThreadGroupSize != 0)
+        throw std::runtime_error("NIS block " + name + " doesn't split into whole rows per thread group");
+    if (ThreadGroupSize > limits.maxComputeWorkGroupSize[0] || ThreadGroupSize > limits.maxComputeWorkGroupInvocations)
+        throw std::runtime_error("NIS block " + name + " exceeds the device's thread group size");
+    if (sharedMemorySize > limits.maxComputeSharedMemorySize)
+        throw std::runtime_error("NIS block " + name + " needs " + std::to_string(sharedMemorySize) + " bytes of shared memory, the device has " +
+                                 std::to_string(limits.maxComputeSharedMemorySize));
+}
+
 void NVSharpen::Cleanup()
 {
     vkDestroyPipeline(m_DeviceRef.GetDevice(), m_Pipeline, nullptr);
     vkDestroyPipelineLayout(m_DeviceRef.GetDevice(), m_PipelineLayout, nullptr);
-    vkFreeDescriptorSets(m_DeviceRef.GetDevice(), m_DeviceRef.GetDescriptorPool(), 1, &m_DescriptorSet);
+    for (auto& frame : m_Frames)
+        vkFreeDescriptorSets(m_DeviceRef.GetDevice(), m_DeviceRef.GetDescriptorPool(), 1, &frame.DescriptorSet);
     vkDestroyDescriptorSetLayout(m_DeviceRef.GetDevice(), m_DescriptorSetLayout, nullptr);
     vkDestroySampler (m_DeviceRef.GetDevice(), m_Sampler, nullptr);
     vkDestroyShaderModule(m_DeviceRef.GetDevice(), m_ShaderModule, nullptr);
 }
 
-void NVSharpen::Update(float sharpness, uint32_t inputWidth, uint32_t inputHeight)
+void NVSharpen::Update(uint32_t frameIndex, float sharpness, uint32_t inputWidth, uint32_t inputHeight)
 {
-    NVSharpenUpdateConfig(m_NisConfig, sharpness,
+    FrameState& frame = m_Frames[frameIndex];
+    NVSharpenUpdateConfig(frame.NisConfig, sharpness,
                           0, 0,
                           inputWidth, inputHeight,
                           inputWidth, inputHeight,
                           0, 0,
                           NISHDRMode::None);
-    m_OutputWidth = inputWidth;
-    m_OutputHeight = inputHeight;
+    frame.OutputWidth = inputWidth;
+    frame.OutputHeight = inputHeight;
 }
 
-void NVSharpen::Dispatch(VkCommandBuffer cmdBuffer, VkImageView inputImageView, VkImageView outputImageView)
+void NVSharpen::Dispatch(VkCommandBuffer cmdBuffer, uint32_t frameIndex, VkImageView inputImageView, VkImageView outputImageView)
 {
-    m_ConstantBuffer->WriteToBuffer(&m_NisConfig);
+    FrameState& frame = m_Frames[frameIndex];
 
     VkWriteDescriptorSet inWriteDescSet{};
     VkWriteDescriptorSet outWriteDescSet{};
@@ -185,7 +200,7 @@ void NVSharpen::Dispatch(VkCommandBuffer cmdBuffer, VkImageView inputImageView,
     inDescInfo.imageView = inputImageView;
     inDescInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     inWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    inWriteDescSet.dstSet = m_DescriptorSet;
+    inWriteDescSet.dstSet = frame.DescriptorSet;
     inWriteDescSet.dstBinding = IN_TEX_BINDING;
     inWriteDescSet.descriptorCount = 1;
     inWriteDescSet.descriptorType = IN_TEX_DESC_TYPE;
@@ -195,7 +210,7 @@ void NVSharpen::Dispatch(VkCommandBuffer cmdBuffer, VkImageView inputImageView,
     outDescInfo.imageView = outputImageView;
     outDescInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
     outWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    outWriteDescSet.dstSet = m_DescriptorSet;
+    outWriteDescSet.dstSet = frame.DescriptorSet;
     outWriteDescSet.dstBinding = OUT_TEX_BINDING;
     outWriteDescSet.descriptorCount = 1;
     outWriteDescSet.descriptorType = OUT_TEX_DESC_TYPE;
@@ -205,8 +220,40 @@ void NVSharpen::Dispatch(VkCommandBuffer cmdBuffer, VkImageView inputImageView,
         inWriteDescSet,
         outWriteDescSet
     };
-    constexpr auto sizeWriteDescSets = static_cast<uint32_t>(std::size(writeDescSets));
-    vkUpdateDescriptorSets(m_DeviceRef.GetDevice(), sizeWriteDescSets, writeDescSets, 0, nullptr);
+    RecordDispatch(cmdBuffer, frame, frameIndex, writeDescSets);
+}
+
+void NVSharpen::Dispatch(VkCommandBuffer cmdBuffer, uint32_t frameIndex, const VkDescriptorBufferInfo& input, const VkDescriptorBufferInfo& output)
+{
+    FrameState& frame = m_Frames[frameIndex];
+
+    VkWriteDescriptorSet inWriteDescSet{};
+    inWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    inWriteDescSet.dstSet = frame.DescriptorSet;
+    inWriteDescSet.dstBinding = IN_TEX_BINDING;
+    inWriteDescSet.descriptorCount = 1;
+    inWriteDescSet.descriptorType = IN_BUFFER_DESC_TYPE;
+    inWriteDescSet.pBufferInfo = &input;
+
+    VkWriteDescriptorSet outWriteDescSet{};
+    outWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    outWriteDescSet.dstSet = frame.DescriptorSet;
+    outWriteDescSet.dstBinding = OUT_TEX_BINDING;
+    outWriteDescSet.descriptorCount = 1;
+    outWriteDescSet.descriptorType = OUT_BUFFER_DESC_TYPE;
+    outWriteDescSet.pBufferInfo = &output;
+    const VkWriteDescriptorSet writeDescSets[] =
+    {
+        inWriteDescSet,
+        outWriteDescSet
+    };
+    RecordDispatch(cmdBuffer, frame, frameIndex, writeDescSets);
+}
+
+void NVSharpen::RecordDispatch(VkCommandBuffer cmdBuffer, FrameState& frame, uint32_t frameIndex, const VkWriteDescriptorSet (&writes)[2])
+{
+    m_ConstantBuffer->WriteToIndex(&frame.NisConfig, static_cast<int>(frameIndex));
+    vkUpdateDescriptorSets(m_DeviceRef.GetDevice(), static_cast<uint32_t>(std::size(writes)), writes, 0, nullptr);
 
     vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
     vkCmdBindDescriptorSets(
@@ -214,12 +261,12 @@ void NVSharpen::Dispatch(VkCommandBuffer cmdBuffer, VkImageView inputImageView,
             VK_PIPELINE_BIND_POINT_COMPUTE,
             m_PipelineLayout,
             0, 1,
-            &m_DescriptorSet,
+            &frame.DescriptorSet,
             0,
             VK_NULL_HANDLE);
 
-    auto gridX = uint32_t(std::ceil(m_OutputWidth / float(m_BlockWidth)));
-    auto gridY = uint32_t(std::ceil(m_OutputHeight / float(m_BlockHeight)));
+    auto gridX = uint32_t(std::ceil(frame.OutputWidth / float(m_BlockSize.Width)));
+    auto gridY = uint32_t(std::ceil(frame.OutputHeight / float(m_BlockSize.Height)));
     vkCmdDispatch(cmdBuffer, gridX, gridY, 1);
 }
 
@@ -21,7 +21,9 @@
 
 #pragma once
 
+#include <cstddef>
 #include <iostream>
+#include <iterator>
 #include <memory>
 
 #include "VKUtilities.h"
@@ -29,28 +31,124 @@
 #include "../vulkan/vulkan_device.h"
 #include "../vulkan/vulkan_buffer.h"
 
+// Which build of a NIS shader runs. Half does the filter math in float16 with the
+// NVIDIA_Generic_fp16 block sizes and needs VulkanDevice::SupportsFloat16(); Full is
+// fp32 with the NVIDIA_Generic ones.
+enum class NISPrecision
+{
+    Half,
+    Full
+};
+
+inline NISGPUArchitecture GetNISArchitecture(NISPrecision precision)
+{
+    return precision == NISPrecision::Half ? NISGPUArchitecture::NVIDIA_Generic_fp16 : NISGPUArchitecture::NVIDIA_Generic;
+}
+
+// Shader file of a NIS variant, e.g. "nis_sharpen_fp32_glsl.spv"
+inline std::string GetNISShaderName(const std::string& variant, NISPrecision precision, bool glsl)
+{
+    return variant + (precision == NISPrecision::Full ? "_fp32" : "") + (glsl ? "_glsl.spv" : ".spv");
+}
+
+// Block and thread group size of a NIS pipeline. The GLSL builds take them as
+// specialization constants 0, 1 and 2, so any valid size runs from the same module;
+// the HLSL builds have them compiled in and only match GetHLSL.
+struct NISBlockSize
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t ThreadGroupSize = 0;
+
+    // NISOptimizer's sizes for the scaler or the sharpen-only shaders
+    static NISBlockSize GetOptimal(bool scaler, NISPrecision precision)
+    {
+        NISOptimizer opt(scaler, GetNISArchitecture(precision));
+        return { opt.GetOptimalBlockWidth(), opt.GetOptimalBlockHeight(), opt.GetOptimalThreadGroupSize() };
+    }
+
+    // The sizes the HLSL builds were compiled with, see CMakeLists.txt
+    static NISBlockSize GetHLSL(bool scaler, NISPrecision precision)
+    {
+        NISBlockSize size = GetOptimal(scaler, precision);
+        size.ThreadGroupSize = 256;
+        return size;
+    }
+
+    [[nodiscard]] bool IsSet() const { return Width != 0; }
+    bool operator==(const NISBlockSize& other) const
+    {
+        return Width == other.Width && Height == other.Height && ThreadGroupSize == other.ThreadGroupSize;
+    }
+    bool operator!=(const NISBlockSize& other) const { return !(*this == other); }
+
+    // Throws if the shaders can't run with these sizes: every thread must cover whole
+    // block rows and the same number of pixels, within the device's group limits.
+    // sharedMemorySize is what the shader's arrays take at this size.
+    void Validate(const VkPhysicalDeviceLimits& limits, uint32_t sharedMemorySize) const;
+
+    // Points at this struct, which must outlive the pipeline creation
+    [[nodiscard]] VkSpecializationInfo GetSpecializationInfo() const
+    {
+        static const VkSpecializationMapEntry entries[] =
+        {
+            { 0, offsetof(NISBlockSize, Width), sizeof(uint32_t) },
+            { 1, offsetof(NISBlockSize, Height), sizeof(uint32_t) },
+            { 2, offsetof(NISBlockSize, ThreadGroupSize), sizeof(uint32_t) }
+        };
+        return { static_cast<uint32_t>(std::size(entries)), entries, sizeof(NISBlockSize), this };
+    }
+};
+
 class NVSharpen
 {
 public:
-    NVSharpen(VulkanDevice& deviceRef, const std::vector<std::string>& shaderPaths, bool glsl);
+    // Image: RGBA8 images in and out.
+    // Buffer: packed RGBA8 storage buffers, rows as wide as the image, instead of
+    // images; dispatch it with the buffer overload.
+    // NV12: the R8 luma plane of an NV12 frame in, its sharpened luma out.
+    enum class Variant
+    {
+        Image,
+        Buffer,
+        NV12
+    };
+
+    // frameCount is the number of frames that may be in flight at once. Every frame
+    // gets its own descriptor set and constant buffer slot so that recording frame k+1
+    // never touches state still read by the GPU for frame k.
+    // blockSize defaults to NISBlockSize::GetOptimal, or GetHLSL for the HLSL builds
+    // which can't run any other size.
+    NVSharpen(VulkanDevice& deviceRef, bool glsl, uint32_t frameCount = 1, Variant variant = Variant::Image,
+              NISPrecision precision = NISPrecision::Half, NISBlockSize blockSize = {});
     ~NVSharpen();
-    void Update(float sharpness, uint32_t inputWidth, uint32_t inputHeight);
-    void Dispatch(VkCommandBuffer cmdBuffer, VkImageView inputImageView, VkImageView outputImageView);
+    void Update(uint32_t frameIndex, float sharpness, uint32_t inputWidth, uint32_t inputHeight);
+    void Dispatch(VkCommandBuffer cmdBuffer, uint32_t frameIndex, VkImageView inputImageView, VkImageView outputImageView);
+    void Dispatch(VkCommandBuffer cmdBuffer, uint32_t frameIndex, const VkDescriptorBufferInfo& input, const VkDescriptorBufferInfo& output);
+    [[nodiscard]] bool UsesBufferIO() const { return m_Variant == Variant::Buffer; }
+    [[nodiscard]] const NISBlockSize& GetBlockSize() const { return m_BlockSize; }
     void Cleanup();
 private:
+    struct FrameState
+    {
+        NISConfig       NisConfig{};
+        VkDescriptorSet DescriptorSet = VK_NULL_HANDLE;
+        uint32_t        OutputWidth = 1;
+        uint32_t        OutputHeight = 1;
+    };
+
+    void RecordDispatch(VkCommandBuffer cmdBuffer, FrameState& frame, uint32_t frameIndex, const VkWriteDescriptorSet (&writes)[2]);
+
     VulkanDevice&                    m_DeviceRef;
-    NISConfig                        m_NisConfig{};
+    std::vector<FrameState>          m_Frames;
     std::unique_ptr<VulkanBuffer>    m_ConstantBuffer;
 
     VkShaderModule                      m_ShaderModule = VK_NULL_HANDLE;
     VkDescriptorSetLayout               m_DescriptorSetLayout = VK_NULL_HANDLE;
     VkPipelineLayout                    m_PipelineLayout = VK_NULL_HANDLE;
-    VkDescriptorSet                     m_DescriptorSet = VK_NULL_HANDLE;
     VkPipeline                          m_Pipeline = VK_NULL_HANDLE;
     VkSampler                           m_Sampler{};
 
-    uint32_t                            m_OutputWidth;
-    uint32_t                            m_OutputHeight;
-    uint32_t                            m_BlockWidth;
-    uint32_t                            m_BlockHeight;
+    NISBlockSize                        m_BlockSize;
+    Variant                             m_Variant;
 };
\ No newline at end of file
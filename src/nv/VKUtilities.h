@@ -21,7 +21,6 @@
 
 #pragma once
 
-#include <fstream>
 #include <vector>
 #include <cassert>
 #include <vulkan/vulkan.h>
@@ -51,19 +50,12 @@ static const VkDescriptorType OUT_TEX_DESC_TYPE = VK_DESCRIPTOR_TYPE_STORAGE_IMA
     { OUT_TEX_BINDING, OUT_TEX_DESC_TYPE, 1, VK_SHADER_STAGE_COMPUTE_BIT }, \
     { IN_TEX_BINDING, IN_TEX_DESC_TYPE, 1, VK_SHADER_STAGE_COMPUTE_BIT }
 
-// TODO: combine with DXUtilities.h:IncludeHeader::Open()
-inline std::vector<char> readBytes(const std::string& filename)
-{
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if (!file.is_open())
-    {
-        fprintf(stderr, "Failed to open: %s\n", filename.c_str());
-        assert(0);
-    }
-    const auto sizeBytes = file.tellg();
-    std::vector<char> buffer(sizeBytes);
-    file.seekg(0);
-    file.read(buffer.data(), sizeBytes);
-    file.close();
-    return buffer;
-}
+// Shaders built with NIS_BUFFER_IO read and write packed RGBA8 storage buffers in the
+// texture bindings and sample by hand, without a sampler
+static const VkDescriptorType IN_BUFFER_DESC_TYPE = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+static const VkDescriptorType OUT_BUFFER_DESC_TYPE = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+#define VK_BUFFER_IO_DESC_LAYOUT \
+    { CB_BINDING, CB_DESC_TYPE, 1, VK_SHADER_STAGE_COMPUTE_BIT}, \
+    { OUT_TEX_BINDING, OUT_BUFFER_DESC_TYPE, 1, VK_SHADER_STAGE_COMPUTE_BIT }, \
+    { IN_TEX_BINDING, IN_BUFFER_DESC_TYPE, 1, VK_SHADER_STAGE_COMPUTE_BIT }
@@ -0,0 +1,35 @@
+#include "channel_passes.h"
+
+// Work group sizes of expand_rgba8.comp and pack_rgba8.comp
+static constexpr uint32_t ExpandGroupSize = 16;
+static constexpr uint32_t PackGroupWidth = 64;
+
+ChannelPasses::ChannelPasses(VulkanDevice& device, uint32_t frameCount)
+    : m_Expand(device, "expand_rgba8.spv", { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE }, sizeof(PushConstants), frameCount),
+      m_Pack(device, "pack_rgba8.spv", { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER }, sizeof(PushConstants), frameCount)
+{
+}
+
+void ChannelPasses::RecordExpand(VkCommandBuffer cmd, uint32_t frameIndex, const VkDescriptorBufferInfo& source, uint32_t rowPitch,
+                                 uint32_t channels, VkImageView target, uint32_t width, uint32_t height)
+{
+    const PushConstants constants{ width, height, rowPitch, channels };
+    m_Expand.Dispatch(cmd, frameIndex,
+                      { PassResource::FromBuffer(source), PassResource::FromImage(target, VK_IMAGE_LAYOUT_GENERAL) },
+                      &constants,
+                      (width + ExpandGroupSize - 1) / ExpandGroupSize,
+                      (height + ExpandGroupSize - 1) / ExpandGroupSize);
+}
+
+void ChannelPasses::RecordPack(VkCommandBuffer cmd, uint32_t frameIndex, VkImageView source, const VkDescriptorBufferInfo& target,
+                               uint32_t rowPitch, uint32_t channels, uint32_t width, uint32_t height)
+{
+    // One invocation per output word of a row
+    const uint32_t words = (width * channels + 3) / 4;
+    const PushConstants constants{ width, height, rowPitch, channels };
+    m_Pack.Dispatch(cmd, frameIndex,
+                    { PassResource::FromImage(source, VK_IMAGE_LAYOUT_GENERAL), PassResource::FromBuffer(target) },
+                    &constants,
+                    (words + PackGroupWidth - 1) / PackGroupWidth,
+                    height);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "compute_pass.h"
+
+// Moves images with 1 or 3 8-bit channels through staging memory at their own size.
+// Expand widens the packed upload into the RGBA8 input image NVSharpen samples, pack
+// narrows the RGBA8 output back into the readback buffer, so neither the host nor the
+// copies ever handle the padding channels.
+class ChannelPasses
+{
+public:
+    // Rows of packed pixels are a multiple of 4 bytes, the passes read and write words
+    static uint32_t GetRowPitch(uint32_t width, uint32_t channels) { return (width * channels + 3) & ~3u; }
+
+    ChannelPasses(VulkanDevice& device, uint32_t frameCount);
+
+    // source -> target, which must be in the GENERAL layout
+    void RecordExpand(VkCommandBuffer cmd, uint32_t frameIndex, const VkDescriptorBufferInfo& source, uint32_t rowPitch,
+                      uint32_t channels, VkImageView target, uint32_t width, uint32_t height);
+    // source, in the GENERAL layout -> target
+    void RecordPack(VkCommandBuffer cmd, uint32_t frameIndex, VkImageView source, const VkDescriptorBufferInfo& target,
+                    uint32_t rowPitch, uint32_t channels, uint32_t width, uint32_t height);
+
+private:
+    struct PushConstants
+    {
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t RowPitch;
+        uint32_t Channels;
+    };
+
+    ComputePass m_Expand;
+    ComputePass m_Pack;
+};
@@ -0,0 +1,103 @@
+#include "compute_pass.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include "vulkan/vulkan_device.h"
+#include "vulkan/vulkan_pipeline_cache.h"
+#include "vulkan/vulkan_utils.h"
+
+ComputePass::ComputePass(VulkanDevice& device, const std::string& shaderName, const std::vector<VkDescriptorType>& bindings,
+                         uint32_t pushConstantSize, uint32_t frameCount)
+    : m_Device(device), m_Bindings(bindings), m_PushConstantSize(pushConstantSize)
+{
+    VkDevice vkDevice = m_Device.GetDevice();
+
+    m_ShaderModule = m_Device.CreateShaderModule(shaderName);
+
+    {
+        std::vector<VkDescriptorSetLayoutBinding> layoutBindings(m_Bindings.size());
+        for (uint32_t i = 0; i < layoutBindings.size(); ++i)
+            layoutBindings[i] = { i, m_Bindings[i], 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+
+        VkDescriptorSetLayoutCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        info.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+        info.pBindings = layoutBindings.data();
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(vkDevice, &info, nullptr, &m_DescriptorSetLayout));
+    }
+
+    m_DescriptorSets.resize(std::max(frameCount, 1u));
+    for (auto& set : m_DescriptorSets)
+    {
+        VkDescriptorSetAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        info.descriptorPool = m_Device.GetDescriptorPool();
+        info.descriptorSetCount = 1;
+        info.pSetLayouts = &m_DescriptorSetLayout;
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(vkDevice, &info, &set));
+    }
+
+    {
+        VkPushConstantRange pushConstRange{};
+        pushConstRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstRange.size = m_PushConstantSize;
+        VkPipelineLayoutCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        info.setLayoutCount = 1;
+        info.pSetLayouts = &m_DescriptorSetLayout;
+        info.pushConstantRangeCount = m_PushConstantSize > 0 ? 1 : 0;
+        info.pPushConstantRanges = &pushConstRange;
+        VK_CHECK_RESULT(vkCreatePipelineLayout(vkDevice, &info, nullptr, &m_PipelineLayout));
+    }
+
+    {
+        VkComputePipelineCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        info.stage.module = m_ShaderModule;
+        info.stage.pName = "main";
+        info.layout = m_PipelineLayout;
+        m_Device.GetPipelineCache().CreateComputePipeline(info, &m_Pipeline);
+    }
+}
+
+ComputePass::~ComputePass()
+{
+    VkDevice vkDevice = m_Device.GetDevice();
+    vkDestroyPipeline(vkDevice, m_Pipeline, nullptr);
+    vkDestroyPipelineLayout(vkDevice, m_PipelineLayout, nullptr);
+    vkFreeDescriptorSets(vkDevice, m_Device.GetDescriptorPool(), static_cast<uint32_t>(m_DescriptorSets.size()), m_DescriptorSets.data());
+    vkDestroyDescriptorSetLayout(vkDevice, m_DescriptorSetLayout, nullptr);
+    vkDestroyShaderModule(vkDevice, m_ShaderModule, nullptr);
+}
+
+void ComputePass::Dispatch(VkCommandBuffer cmd, uint32_t frameIndex, const std::vector<PassResource>& resources,
+                           const void* pushConstants, uint32_t groupCountX, uint32_t groupCountY)
+{
+    if (resources.size() != m_Bindings.size())
+        throw std::runtime_error("Compute pass expects " + std::to_string(m_Bindings.size()) + " resources");
+
+    const VkDescriptorSet set = m_DescriptorSets[frameIndex];
+    std::vector<VkWriteDescriptorSet> writes(resources.size());
+    for (uint32_t i = 0; i < writes.size(); ++i)
+    {
+        const bool buffer = m_Bindings[i] == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER || m_Bindings[i] == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = m_Bindings[i];
+        writes[i].pBufferInfo = buffer ? &resources[i].Buffer : nullptr;
+        writes[i].pImageInfo = buffer ? nullptr : &resources[i].Image;
+    }
+    vkUpdateDescriptorSets(m_Device.GetDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, 1, &set, 0, nullptr);
+    if (m_PushConstantSize > 0)
+        vkCmdPushConstants(cmd, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, m_PushConstantSize, pushConstants);
+    vkCmdDispatch(cmd, groupCountX, groupCountY, 1);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+class VulkanDevice;
+
+// A descriptor for one binding of a pass, buffer or image depending on the binding's type
+struct PassResource
+{
+    VkDescriptorBufferInfo Buffer{};
+    VkDescriptorImageInfo Image{};
+
+    static PassResource FromBuffer(const VkDescriptorBufferInfo& buffer) { return { buffer, {} }; }
+    static PassResource FromImage(VkImageView view, VkImageLayout layout) { return { {}, { VK_NULL_HANDLE, view, layout } }; }
+};
+
+// One compute shader with a push constant block and a single descriptor set, one copy
+// of the set per frame in flight like NVSharpen. Shaders are named by their .spv file,
+// see VulkanDevice::CreateShaderModule.
+class ComputePass
+{
+public:
+    // Binding i of the set has type bindings[i]
+    ComputePass(VulkanDevice& device, const std::string& shaderName, const std::vector<VkDescriptorType>& bindings,
+                uint32_t pushConstantSize, uint32_t frameCount);
+    ~ComputePass();
+
+    ComputePass(const ComputePass&) = delete;
+    ComputePass& operator=(const ComputePass&) = delete;
+
+    // Writes the frame's descriptors, one resource per binding in binding order, then
+    // records the dispatch
+    void Dispatch(VkCommandBuffer cmd, uint32_t frameIndex, const std::vector<PassResource>& resources,
+                  const void* pushConstants, uint32_t groupCountX, uint32_t groupCountY);
+
+private:
+    VulkanDevice& m_Device;
+    std::vector<VkDescriptorType> m_Bindings;
+    uint32_t m_PushConstantSize;
+
+    VkShaderModule m_ShaderModule = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_DescriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_Pipeline = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_DescriptorSets;
+};
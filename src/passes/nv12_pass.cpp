@@ -0,0 +1,22 @@
+#include "nv12_pass.h"
+
+// Work group width of rgba_to_nv12.comp
+static constexpr uint32_t GroupWidth = 64;
+
+NV12Pass::NV12Pass(VulkanDevice& device, uint32_t frameCount)
+    : m_Pass(device, "rgba_to_nv12.spv", { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER }, sizeof(PushConstants), frameCount)
+{
+}
+
+void NV12Pass::Record(VkCommandBuffer cmd, uint32_t frameIndex, VkImageView source, const VkDescriptorBufferInfo& target,
+                      uint32_t rowPitch, uint32_t width, uint32_t height)
+{
+    // One invocation per word of a luma row pair
+    const uint32_t words = (width + 3) / 4;
+    const PushConstants constants{ width, height, rowPitch };
+    m_Pass.Dispatch(cmd, frameIndex,
+                    { PassResource::FromImage(source, VK_IMAGE_LAYOUT_GENERAL), PassResource::FromBuffer(target) },
+                    &constants,
+                    (words + GroupWidth - 1) / GroupWidth,
+                    (height + 1) / 2);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "compute_pass.h"
+
+// Converts a sharpened RGBA8 image to NV12 in a storage buffer, so only the YUV bytes
+// are read back instead of the RGBA pixels and a host conversion.
+class NV12Pass
+{
+public:
+    // Luma and chroma rows share a pitch the shader can write in whole words
+    static uint32_t GetRowPitch(uint32_t width) { return (width + 3) & ~3u; }
+
+    NV12Pass(VulkanDevice& device, uint32_t frameCount);
+
+    // source, in the GENERAL layout -> target, laid out as PixelLayout::NV12
+    void Record(VkCommandBuffer cmd, uint32_t frameIndex, VkImageView source, const VkDescriptorBufferInfo& target,
+                uint32_t rowPitch, uint32_t width, uint32_t height);
+
+private:
+    struct PushConstants
+    {
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t RowPitch;
+    };
+
+    ComputePass m_Pass;
+};
@@ -0,0 +1,134 @@
+#include "atlas_batcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+AtlasBatcher::AtlasBatcher(VkNVSharpen& sharpen, const AtlasOptions& options)
+    : m_Sharpen(sharpen), m_Options(options), m_Packer(options.Size, options.Size, options.Gutter)
+{
+    m_Sharpen.SetCompletionHandler([this](const ReadbackResult& result) { OnReadback(result); });
+}
+
+AtlasBatcher::~AtlasBatcher()
+{
+    m_Sharpen.SetCompletionHandler(nullptr);
+}
+
+void AtlasBatcher::Submit(HostImage&& image)
+{
+    // Atlases are RGBA, grayscale, opaque and NV12 images keep their compact upload.
+    // YUV output converts whole images on the GPU, which an atlas would undo, and
+    // scaling would move every packed rectangle.
+    if (std::max(image.Width, image.Height) > m_Options.MaxImageSize || image.Channels != 4 || m_Sharpen.UsesYUVOutput()
+        || m_Sharpen.UsesScaling())
+    {
+        m_Sharpen.Submit(std::move(image));
+        return;
+    }
+
+    PackedRect rect;
+    if (!m_Packer.Pack(image.Width, image.Height, rect))
+    {
+        SubmitAtlas();
+        if (!m_Packer.Pack(image.Width, image.Height, rect))
+        {
+            // Bigger than an empty atlas
+            m_Sharpen.Submit(std::move(image));
+            return;
+        }
+    }
+    m_Pending.push_back({ std::move(image), rect });
+}
+
+void AtlasBatcher::Flush()
+{
+    SubmitAtlas();
+    m_Sharpen.Flush();
+}
+
+void AtlasBatcher::SubmitAtlas()
+{
+    if (m_Pending.empty())
+        return;
+
+    // Only the rows covered by shelves are sharpened, rounded up so atlases of similar
+    // fill reuse the same cached images
+    const uint32_t gutter = m_Options.Gutter;
+    HostImage atlas;
+    atlas.Width = m_Packer.GetWidth();
+    atlas.Height = std::min((m_Packer.GetUsedHeight() + 63) / 64 * 64, m_Packer.GetHeight());
+    atlas.RowPitch = atlas.Width * 4;
+    atlas.OutputPath = "atlas#" + std::to_string(m_AtlasCount);
+    atlas.StartTime = m_Pending.front().Image.StartTime;
+    atlas.Data.resize(size_t(atlas.RowPitch) * atlas.Height);
+
+    auto& images = m_InFlight[atlas.OutputPath];
+    for (const auto& packed : m_Pending)
+    {
+        const HostImage& image = packed.Image;
+        const PackedRect& rect = packed.Rect;
+        const size_t rowBytes = size_t(rect.Width) * 4;
+
+        // Content rows, with the first and last pixel replicated into the side gutters
+        for (uint32_t y = 0; y < rect.Height; ++y)
+        {
+            const uint8_t* src = image.GetPixels() + size_t(y) * image.RowPitch;
+            uint8_t* dst = atlas.Data.data() + size_t(rect.Y + y) * atlas.RowPitch + size_t(rect.X) * 4;
+            std::memcpy(dst, src, rowBytes);
+            for (uint32_t g = 1; g <= gutter; ++g)
+            {
+                std::memcpy(dst - g * 4, src, 4);
+                std::memcpy(dst + rowBytes + (g - 1) * 4, src + rowBytes - 4, 4);
+            }
+        }
+
+        // Top and bottom gutters repeat the first and last padded rows, corners included
+        const size_t paddedBytes = rowBytes + size_t(gutter) * 8;
+        uint8_t* firstRow = atlas.Data.data() + size_t(rect.Y) * atlas.RowPitch + size_t(rect.X - gutter) * 4;
+        uint8_t* lastRow = firstRow + size_t(rect.Height - 1) * atlas.RowPitch;
+        for (uint32_t g = 1; g <= gutter; ++g)
+        {
+            std::memcpy(firstRow - size_t(g) * atlas.RowPitch, firstRow, paddedBytes);
+            std::memcpy(lastRow + size_t(g) * atlas.RowPitch, lastRow, paddedBytes);
+        }
+
+        images.emplace_back(image.OutputPath, rect);
+    }
+
+    m_AtlasCount++;
+    m_PackedImageCount += m_Pending.size();
+    m_Pending.clear();
+    m_Packer.Reset();
+
+    m_Sharpen.Submit(atlas);
+}
+
+void AtlasBatcher::OnReadback(const ReadbackResult& result)
+{
+    auto it = m_InFlight.find(result.OutputPath);
+    if (it == m_InFlight.end())
+    {
+        Deliver(result);
+        return;
+    }
+
+    for (const auto& [outputPath, rect] : it->second)
+    {
+        ReadbackResult image{
+                outputPath,
+                result.Data + size_t(rect.Y) * result.RowPitch + size_t(rect.X) * 4,
+                rect.Width,
+                rect.Height,
+                result.RowPitch };
+        Deliver(image);
+    }
+    m_InFlight.erase(it);
+}
+
+void AtlasBatcher::Deliver(const ReadbackResult& result) const
+{
+    if (m_CompletionHandler)
+        m_CompletionHandler(result);
+    else
+        VkNVSharpen::SaveImage(result.OutputPath, result.Data, result.Width, result.Height, result.RowPitch, result.Channels, result.Layout);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shelf_packer.h"
+#include "vk_nv_sharpen.h"
+
+struct AtlasOptions
+{
+    // Side length of the atlas; 0 disables batching
+    uint32_t Size = 0;
+    // Images with a larger side are submitted on their own
+    uint32_t MaxImageSize = 256;
+    // Edge replicated border around each packed image. The sharpen filter reads 2 pixels
+    // out from each output pixel, the extra margin keeps the atlas independent of it.
+    uint32_t Gutter = 4;
+};
+
+// Packs small images into one atlas so a single sharpen pass and a single readback
+// cover many of them. NIS samples at texel centres, so with edge replicated gutters
+// every packed image comes out exactly as it would on its own. The sharpened atlas is
+// split on the host and each image is handed to the completion handler in place.
+class AtlasBatcher
+{
+public:
+    AtlasBatcher(VkNVSharpen& sharpen, const AtlasOptions& options);
+    ~AtlasBatcher();
+
+    AtlasBatcher(const AtlasBatcher&) = delete;
+    AtlasBatcher& operator=(const AtlasBatcher&) = delete;
+
+    // Receives every image, packed or not. Defaults to writing the PNG.
+    void SetCompletionHandler(VkNVSharpen::CompletionHandler handler) { m_CompletionHandler = std::move(handler); }
+
+    void Submit(HostImage&& image);
+    // Submits the partially filled atlas and waits for everything in flight
+    void Flush();
+
+    [[nodiscard]] uint64_t GetAtlasCount() const { return m_AtlasCount; }
+    [[nodiscard]] uint64_t GetPackedImageCount() const { return m_PackedImageCount; }
+
+private:
+    struct PackedImage
+    {
+        HostImage Image;
+        PackedRect Rect;
+    };
+
+    void SubmitAtlas();
+    void OnReadback(const ReadbackResult& result);
+    void Deliver(const ReadbackResult& result) const;
+
+    VkNVSharpen& m_Sharpen;
+    AtlasOptions m_Options;
+    VkNVSharpen::CompletionHandler m_CompletionHandler;
+
+    ShelfPacker m_Packer;
+    std::vector<PackedImage> m_Pending;
+    // Output path -> rectangle of every image in an atlas that is still on the GPU,
+    // keyed by the atlas' placeholder output path
+    std::unordered_map<std::string, std::vector<std::pair<std::string, PackedRect>>> m_InFlight;
+
+    uint64_t m_AtlasCount = 0;
+    uint64_t m_PackedImageCount = 0;
+};
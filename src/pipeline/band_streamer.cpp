@@ -0,0 +1,100 @@
+#include "band_streamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+
+#include "common/PngStream.h"
+#include "passes/channel_passes.h"
+
+BandStreamer::BandStreamer(VkNVSharpen& sharpen, uint32_t bandHeight)
+    : m_Sharpen(sharpen), m_BandHeight(std::max(bandHeight, 1u))
+{
+}
+
+bool BandStreamer::Process(const std::string& inputImagePath, const std::string& outputDirectoryPath)
+{
+    if (m_Sharpen.UsesYUVOutput() || m_Sharpen.UsesScaling())
+        return false;
+    img::PngReader reader(inputImagePath);
+    if (reader.interlaced())
+        return false;
+
+    // Frames submitted before this image must not reach the band handler
+    m_Sharpen.Flush();
+
+    const uint32_t width = reader.width();
+    const uint32_t height = reader.height();
+    const uint32_t halo = VkNVSharpen::TileHalo;
+    // Grayscale and RGB bands stay compact through staging, as whole images do
+    const uint32_t channels = reader.compactChannels();
+
+    HostImage band;
+    band.OutputPath = m_Sharpen.GetOutputPath(inputImagePath, outputDirectoryPath);
+    band.Width = width;
+    band.Channels = channels;
+    band.RowPitch = ChannelPasses::GetRowPitch(width, channels);
+    band.Data.resize(size_t(band.RowPitch) * (m_BandHeight + 2 * halo));
+
+    img::PngWriter writer(band.OutputPath, width, height, channels);
+
+    // Bands retire in submission order; each one knows which of its rows are halo
+    struct BandRows
+    {
+        uint32_t Skip;
+        uint32_t Count;
+    };
+    std::deque<BandRows> inFlight;
+    m_Sharpen.SetCompletionHandler([&](const ReadbackResult& result)
+    {
+        BandRows rows = inFlight.front();
+        inFlight.pop_front();
+        if (result.Channels != channels)
+            throw std::runtime_error("Band of " + band.OutputPath + " read back with " + std::to_string(result.Channels) + " channels");
+        writer.writeRows(result.Data + size_t(rows.Skip) * result.RowPitch, result.RowPitch, rows.Count);
+    });
+
+    try
+    {
+        // band.Data holds source rows [top, top + buffered)
+        uint32_t top = 0;
+        uint32_t buffered = 0;
+        for (uint64_t y = 0; y < height; y += m_BandHeight)
+        {
+            const uint32_t count = uint32_t(std::min<uint64_t>(m_BandHeight, height - y));
+            const uint32_t end = uint32_t(std::min<uint64_t>(y + count + halo, height));
+            while (top + buffered < end)
+            {
+                uint8_t* dst = band.Data.data() + size_t(buffered) * band.RowPitch;
+                buffered += reader.readRows(dst, band.RowPitch, end - (top + buffered), channels);
+            }
+
+            band.Height = buffered;
+            band.StartTime = std::chrono::steady_clock::now();
+            inFlight.push_back({ uint32_t(y - top), count });
+            m_Sharpen.Submit(band);
+
+            // The last rows of this band are the top halo of the next one. Submit has
+            // copied the band into staging memory, so the buffer can be reused.
+            const uint32_t nextTop = uint32_t(y + count - std::min<uint64_t>(y + count, halo));
+            const uint32_t keep = end - nextTop;
+            std::memmove(band.Data.data(), band.Data.data() + size_t(nextTop - top) * band.RowPitch, size_t(keep) * band.RowPitch);
+            top = nextTop;
+            buffered = keep;
+        }
+        m_Sharpen.Flush();
+    }
+    catch (...)
+    {
+        // Drop the bands still in flight rather than writing them as images of their own
+        m_Sharpen.SetCompletionHandler([](const ReadbackResult&) {});
+        m_Sharpen.Flush();
+        m_Sharpen.SetCompletionHandler(nullptr);
+        throw;
+    }
+    m_Sharpen.SetCompletionHandler(nullptr);
+
+    writer.finish();
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+
+#include "vk_nv_sharpen.h"
+
+// Sharpens a PNG in horizontal bands so host memory stays proportional to the band
+// height rather than the image height. Rows are decoded straight into a band buffer,
+// each band is submitted with TileHalo rows of context above and below, and the
+// interior rows of every retired band go to a row streaming PNG encoder. Bands
+// overlap the same way tiles do, so the output matches sharpening the whole image.
+class BandStreamer
+{
+public:
+    static constexpr uint32_t DefaultBandHeight = 256;
+
+    BandStreamer(VkNVSharpen& sharpen, uint32_t bandHeight = DefaultBandHeight);
+
+    // Returns false without touching the output when the file cannot be decoded
+    // row by row (interlaced PNGs), the output is YUV rather than PNG or images are
+    // scaled, the caller then loads it whole.
+    bool Process(const std::string& inputImagePath, const std::string& outputDirectoryPath);
+
+private:
+    VkNVSharpen& m_Sharpen;
+    uint32_t m_BandHeight;
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+// Bounded multi-producer/multi-consumer queue without locks (D. Vyukov's design).
+// Each cell carries a sequence number that tells producers and consumers whether
+// the cell is free or holds a value for the current lap around the ring.
+// Capacity is rounded up to a power of two.
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+
+        m_Mask = size - 1;
+        m_Cells = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; ++i)
+            m_Cells[i].Sequence.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool TryPush(T&& value)
+    {
+        size_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_Cells[pos & m_Mask];
+            size_t sequence = cell.Sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.Data = std::move(value);
+                    cell.Sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = m_EnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool TryPop(T& value)
+    {
+        size_t pos = m_DequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_Cells[pos & m_Mask];
+            size_t sequence = cell.Sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (m_DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = std::move(cell.Data);
+                    cell.Sequence.store(pos + m_Mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = m_DequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    [[nodiscard]] size_t Capacity() const { return m_Mask + 1; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> Sequence;
+        T Data;
+    };
+
+    static constexpr size_t CacheLineSize = 64;
+
+    std::unique_ptr<Cell[]> m_Cells;
+    size_t m_Mask{};
+    alignas(CacheLineSize) std::atomic<size_t> m_EnqueuePos{0};
+    alignas(CacheLineSize) std::atomic<size_t> m_DequeuePos{0};
+};
+
+// Spins, then yields, then sleeps. Used by threads waiting on a full or empty queue
+// so backpressure does not burn a core for long.
+class Backoff
+{
+public:
+    void Pause()
+    {
+        if (m_Count < 64)
+        {
+            ++m_Count;
+        }
+        else if (m_Count < 128)
+        {
+            ++m_Count;
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    void Reset() { m_Count = 0; }
+
+private:
+    uint32_t m_Count = 0;
+};
+
+template<typename T>
+void PushBlocking(BoundedQueue<T>& queue, T&& value)
+{
+    Backoff backoff;
+    while (!queue.TryPush(std::move(value)))
+        backoff.Pause();
+}
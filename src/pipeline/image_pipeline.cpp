@@ -0,0 +1,169 @@
+#include "image_pipeline.h"
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "bounded_queue.h"
+#include "worker_pool.h"
+
+namespace
+{
+    // Result of one decode task. Failed decodes are still queued so the GPU stage
+    // can count every input and knows when it is done.
+    struct DecodedImage
+    {
+        std::string InputPath;
+        HostImage Image;
+    };
+}
+
+ImagePipeline::ImagePipeline(VkNVSharpen& sharpen, const PipelineOptions& options)
+    : m_Sharpen(sharpen), m_Options(options)
+{
+}
+
+void ImagePipeline::Run(const std::vector<std::string>& inputImagePaths, const std::string& outputDirectoryPath)
+{
+    if (inputImagePaths.empty())
+        return;
+
+    WorkerPool decodePool(m_Options.DecodeThreads, m_Options.QueueDepth);
+    WorkerPool encodePool(m_Options.EncodeThreads, m_Options.QueueDepth);
+    BoundedQueue<std::unique_ptr<DecodedImage>> decoded(m_Options.QueueDepth);
+    std::atomic<bool> abort{false};
+
+    // The encoder reads the readback memory directly and recycles it when done. Results
+    // that do not own their memory (tiles, atlas parts) are copied out tightly packed,
+    // since that memory is reused as soon as the handler returns.
+    auto onReadback = [&encodePool](const ReadbackResult& result)
+    {
+        if (result.Staging != nullptr)
+        {
+            auto readback = std::make_shared<StagingHandle>(std::move(*result.Staging));
+            encodePool.Submit([readback, outputPath = result.OutputPath, data = result.Data,
+                               width = result.Width, height = result.Height, rowPitch = result.RowPitch, channels = result.Channels, layout = result.Layout]()
+            {
+                VkNVSharpen::SaveImage(outputPath, data, width, height, rowPitch, channels, layout);
+            });
+            return;
+        }
+
+        auto image = std::make_shared<HostImage>();
+        image->OutputPath = result.OutputPath;
+        image->Width = result.Width;
+        image->Height = result.Height;
+        image->Channels = result.Channels;
+        image->Layout = result.Layout;
+        // Odd-width NV12 chroma rows hold one byte more than the luma rows
+        image->RowPitch = result.Layout == PixelLayout::NV12 ? (result.Width + 1) & ~1u : result.Width * result.Channels;
+        const uint32_t rows = GetRowCount(image->Layout, image->Height);
+        image->Data.resize(size_t(image->RowPitch) * rows);
+        for (uint32_t y = 0; y < rows; ++y)
+            std::memcpy(image->Data.data() + size_t(y) * image->RowPitch, result.Data + size_t(y) * result.RowPitch, image->RowPitch);
+
+        encodePool.Submit([image]()
+        {
+            VkNVSharpen::SaveImage(image->OutputPath, image->Data.data(), image->Width, image->Height, image->RowPitch, image->Channels, image->Layout);
+        });
+    };
+
+    // The batcher takes over the sharpen completion handler and forwards every image,
+    // packed or not
+    std::unique_ptr<AtlasBatcher> batcher;
+    if (m_Options.Atlas.Size > 0)
+    {
+        batcher = std::make_unique<AtlasBatcher>(m_Sharpen, m_Options.Atlas);
+        batcher->SetCompletionHandler(onReadback);
+    }
+    else
+    {
+        m_Sharpen.SetCompletionHandler(onReadback);
+    }
+
+    // Submitting decode tasks blocks once the decode queues are full, so it gets its
+    // own thread rather than stalling GPU submission.
+    std::thread feeder([&]()
+    {
+        for (const auto& path : inputImagePaths)
+        {
+            if (abort.load(std::memory_order_acquire))
+                break;
+
+            decodePool.Submit([&, path]()
+            {
+                auto result = std::make_unique<DecodedImage>();
+                result->InputPath = path;
+                try
+                {
+                    // Atlas packing reads the pixels back, keep them out of staging memory
+                    result->Image = m_Sharpen.LoadImage(path, outputDirectoryPath, m_Options.Atlas.Size == 0);
+                }
+                catch (const std::exception& e)
+                {
+                    std::cerr << "Error: Failed to load " << path << ": " << e.what() << std::endl;
+                    result->Image = {};
+                }
+
+                Backoff backoff;
+                while (!decoded.TryPush(std::move(result)))
+                {
+                    if (abort.load(std::memory_order_acquire))
+                        return;
+                    backoff.Pause();
+                }
+            });
+        }
+    });
+
+    std::exception_ptr error;
+    try
+    {
+        Backoff backoff;
+        for (size_t remaining = inputImagePaths.size(); remaining > 0;)
+        {
+            std::unique_ptr<DecodedImage> result;
+            if (!decoded.TryPop(result))
+            {
+                backoff.Pause();
+                continue;
+            }
+            backoff.Reset();
+            --remaining;
+
+            if (result->Image.IsEmpty())
+            {
+                std::cerr << "Error: Skipping " << result->InputPath << ", it could not be decoded." << std::endl;
+                continue;
+            }
+
+            std::cout << "Processing: " << result->InputPath << std::endl;
+            if (batcher)
+                batcher->Submit(std::move(result->Image));
+            else
+                m_Sharpen.Submit(std::move(result->Image));
+        }
+
+        if (batcher)
+            batcher->Flush();
+        else
+            m_Sharpen.Flush();
+    }
+    catch (...)
+    {
+        // Unblock the decode side so the pools below can drain
+        error = std::current_exception();
+        abort.store(true, std::memory_order_release);
+    }
+
+    feeder.join();
+    decodePool.Wait();
+    encodePool.Wait();
+    batcher.reset();
+    m_Sharpen.SetCompletionHandler(nullptr);
+
+    if (error)
+        std::rethrow_exception(error);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vk_nv_sharpen.h"
+#include "atlas_batcher.h"
+
+struct PipelineOptions
+{
+    uint32_t DecodeThreads = 2;
+    uint32_t EncodeThreads = 2;
+    uint32_t QueueDepth = 8;
+    AtlasOptions Atlas;
+};
+
+// Runs decode, GPU and encode as three overlapping stages. Decode workers turn paths
+// into HostImages and hand them to the calling thread, which owns all GPU submission.
+// Retired frames are copied out of the readback buffer and handed to the encode
+// workers. Every stage boundary is a bounded queue, so a slow stage stalls the one
+// feeding it instead of letting decoded images pile up in memory. With an atlas size
+// set, small images go through an AtlasBatcher on the GPU thread.
+class ImagePipeline
+{
+public:
+    ImagePipeline(VkNVSharpen& sharpen, const PipelineOptions& options);
+
+    void Run(const std::vector<std::string>& inputImagePaths, const std::string& outputDirectoryPath);
+
+private:
+    VkNVSharpen& m_Sharpen;
+    PipelineOptions m_Options;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+// Collects per-image latencies in milliseconds and summarizes them.
+class LatencyStats
+{
+public:
+    void Record(double milliseconds) { m_Samples.push_back(milliseconds); }
+    [[nodiscard]] size_t GetCount() const { return m_Samples.size(); }
+
+    // p in [0, 1], nearest rank
+    [[nodiscard]] double GetPercentile(double p) const
+    {
+        if (m_Samples.empty())
+            return 0.0;
+        std::vector<double> sorted = m_Samples;
+        std::sort(sorted.begin(), sorted.end());
+        auto rank = static_cast<size_t>(p * double(sorted.size() - 1) + 0.5);
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+    [[nodiscard]] double GetMean() const
+    {
+        double total = 0.0;
+        for (double sample : m_Samples)
+            total += sample;
+        return m_Samples.empty() ? 0.0 : total / double(m_Samples.size());
+    }
+
+    void Print(std::ostream& os, const char* label) const
+    {
+        if (m_Samples.empty())
+            return;
+        os << label << ": " << m_Samples.size() << " images, "
+           << std::fixed << std::setprecision(2)
+           << "mean " << GetMean() << " ms, "
+           << "min " << GetPercentile(0.0) << " ms, "
+           << "p50 " << GetPercentile(0.5) << " ms, "
+           << "p95 " << GetPercentile(0.95) << " ms, "
+           << "max " << GetPercentile(1.0) << " ms" << std::endl;
+    }
+
+private:
+    std::vector<double> m_Samples;
+};
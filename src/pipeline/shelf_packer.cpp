@@ -0,0 +1,46 @@
+#include "shelf_packer.h"
+
+ShelfPacker::ShelfPacker(uint32_t width, uint32_t height, uint32_t gutter)
+    : m_Width(width), m_Height(height), m_Gutter(gutter)
+{
+}
+
+void ShelfPacker::Reset()
+{
+    m_Shelves.clear();
+    m_NextShelfY = 0;
+}
+
+bool ShelfPacker::Pack(uint32_t width, uint32_t height, PackedRect& outRect)
+{
+    const uint32_t paddedWidth = width + 2 * m_Gutter;
+    const uint32_t paddedHeight = height + 2 * m_Gutter;
+    if (paddedWidth > m_Width || paddedHeight > m_Height)
+        return false;
+
+    // Best fit: the open shelf that wastes the least height
+    Shelf* best = nullptr;
+    for (auto& shelf : m_Shelves)
+    {
+        if (shelf.Height < paddedHeight || shelf.NextX + paddedWidth > m_Width)
+            continue;
+        if (best == nullptr || shelf.Height < best->Height)
+            best = &shelf;
+    }
+
+    if (best == nullptr)
+    {
+        if (m_NextShelfY + paddedHeight > m_Height)
+            return false;
+        m_Shelves.push_back({ m_NextShelfY, paddedHeight, 0 });
+        m_NextShelfY += paddedHeight;
+        best = &m_Shelves.back();
+    }
+
+    outRect.X = best->NextX + m_Gutter;
+    outRect.Y = best->Y + m_Gutter;
+    outRect.Width = width;
+    outRect.Height = height;
+    best->NextX += paddedWidth;
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Content rectangle of a packed image, not including its gutter.
+struct PackedRect
+{
+    uint32_t X = 0, Y = 0;
+    uint32_t Width = 0, Height = 0;
+};
+
+// Shelf (row) packer for an atlas of fixed size. Each rectangle is surrounded by a
+// gutter of the given width, which the caller fills by replicating the image's edge
+// pixels so filters near the edge see the same values as clamp-to-edge sampling.
+class ShelfPacker
+{
+public:
+    ShelfPacker(uint32_t width, uint32_t height, uint32_t gutter);
+
+    // Returns false when the rectangle no longer fits
+    bool Pack(uint32_t width, uint32_t height, PackedRect& outRect);
+    void Reset();
+
+    [[nodiscard]] uint32_t GetWidth() const { return m_Width; }
+    [[nodiscard]] uint32_t GetHeight() const { return m_Height; }
+    [[nodiscard]] uint32_t GetGutter() const { return m_Gutter; }
+    // Height actually covered by shelves so far
+    [[nodiscard]] uint32_t GetUsedHeight() const { return m_NextShelfY; }
+
+private:
+    struct Shelf
+    {
+        uint32_t Y;
+        uint32_t Height;
+        uint32_t NextX;
+    };
+
+    uint32_t m_Width, m_Height, m_Gutter;
+    std::vector<Shelf> m_Shelves;
+    uint32_t m_NextShelfY = 0;
+};
@@ -0,0 +1,93 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(uint32_t workerCount, size_t queueDepth)
+{
+    workerCount = std::max(workerCount, 1u);
+    m_Queues.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; ++i)
+        m_Queues.push_back(std::make_unique<BoundedQueue<Task>>(queueDepth));
+
+    m_Threads.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; ++i)
+        m_Threads.emplace_back(&WorkerPool::WorkerLoop, this, i);
+}
+
+WorkerPool::~WorkerPool()
+{
+    m_Stop.store(true, std::memory_order_release);
+    for (auto& thread : m_Threads)
+        thread.join();
+}
+
+void WorkerPool::Submit(Task task)
+{
+    m_Pending.fetch_add(1, std::memory_order_relaxed);
+
+    const auto queueCount = static_cast<uint32_t>(m_Queues.size());
+    Backoff backoff;
+    for (;;)
+    {
+        uint32_t start = m_NextQueue.fetch_add(1, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < queueCount; ++i)
+        {
+            if (m_Queues[(start + i) % queueCount]->TryPush(std::move(task)))
+                return;
+        }
+        backoff.Pause();
+    }
+}
+
+void WorkerPool::Wait()
+{
+    Backoff backoff;
+    while (m_Pending.load(std::memory_order_acquire) != 0)
+        backoff.Pause();
+
+    std::lock_guard<std::mutex> lock(m_ErrorMutex);
+    if (m_FirstError)
+    {
+        std::exception_ptr error = m_FirstError;
+        m_FirstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+bool WorkerPool::TryRunOne(uint32_t index)
+{
+    // Own queue first, then steal from the others starting with the next neighbour
+    Task task;
+    const auto queueCount = static_cast<uint32_t>(m_Queues.size());
+    for (uint32_t i = 0; i < queueCount; ++i)
+    {
+        if (!m_Queues[(index + i) % queueCount]->TryPop(task))
+            continue;
+
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_ErrorMutex);
+            if (!m_FirstError)
+                m_FirstError = std::current_exception();
+        }
+        m_Pending.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+    return false;
+}
+
+void WorkerPool::WorkerLoop(uint32_t index)
+{
+    Backoff backoff;
+    while (!m_Stop.load(std::memory_order_acquire) || m_Pending.load(std::memory_order_acquire) != 0)
+    {
+        if (TryRunOne(index))
+            backoff.Reset();
+        else
+            backoff.Pause();
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+
+// Fixed set of worker threads, each with its own bounded task queue. Submit spreads
+// tasks round robin and blocks while every queue is full, which is how a slow stage
+// pushes back on the one feeding it. Workers that run dry steal from the queues of
+// their neighbours, so one long task does not strand the work queued behind it.
+class WorkerPool
+{
+public:
+    using Task = std::function<void()>;
+
+    WorkerPool(uint32_t workerCount, size_t queueDepth);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void Submit(Task task);
+    // Blocks until every submitted task has run. Rethrows the first task exception.
+    void Wait();
+
+    [[nodiscard]] uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_Threads.size()); }
+
+private:
+    void WorkerLoop(uint32_t index);
+    bool TryRunOne(uint32_t index);
+
+    std::vector<std::unique_ptr<BoundedQueue<Task>>> m_Queues;
+    std::vector<std::thread> m_Threads;
+    std::atomic<uint32_t> m_NextQueue{0};
+    std::atomic<size_t> m_Pending{0};
+    std::atomic<bool> m_Stop{false};
+
+    std::mutex m_ErrorMutex;
+    std::exception_ptr m_FirstError;
+};
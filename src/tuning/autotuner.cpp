@@ -0,0 +1,175 @@
+#include "autotuner.h"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "benchmark/benchmark.h"
+
+namespace
+{
+    struct Resolution
+    {
+        uint32_t Width, Height;
+        uint32_t ImageCount;
+    };
+
+    // Small images weigh in too, the per-dispatch overhead differs between sizes
+    constexpr Resolution Resolutions[] = {
+            { 1280, 720, 8 },
+            { 1920, 1080, 6 },
+            { 3840, 2160, 3 } };
+
+    // Blocks stay 32 pixels wide as in every NISOptimizer architecture, only the height
+    // and the thread group size vary. Sizes the device or the shader can't run are skipped.
+    constexpr uint32_t BlockHeights[] = { 16, 24, 32 };
+    constexpr uint32_t ThreadGroupSizes[] = { 64, 128, 256, 512 };
+
+    const char* GetPrecisionName(NISPrecision precision)
+    {
+        return precision == NISPrecision::Half ? "fp16" : "fp32";
+    }
+
+    // GPU milliseconds of one pass over the images, after a warm-up pass
+    double Measure(VkNVSharpen& sharpen, const std::vector<HostImage>& images)
+    {
+        double ms = 0.0;
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            sharpen.ResetGPUTime();
+            for (const auto& image : images)
+                sharpen.Submit(image);
+            sharpen.Flush();
+            ms = sharpen.GetGPUTime();
+        }
+        return ms;
+    }
+}
+
+TuningCache::TuningCache(std::string path)
+    : m_Path(std::move(path))
+{
+    std::ifstream file(m_Path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        Entry entry;
+        std::string precision;
+        NISBlockSize& blockSize = entry.Config.BlockSize;
+        if (fields >> entry.VendorID >> entry.DeviceID >> entry.DriverVersion >> precision
+                   >> blockSize.Width >> blockSize.Height >> blockSize.ThreadGroupSize >> entry.Config.Milliseconds
+            && (precision == "fp16" || precision == "fp32"))
+        {
+            entry.Config.Precision = precision == "fp16" ? NISPrecision::Half : NISPrecision::Full;
+            m_Entries.push_back(entry);
+        }
+    }
+}
+
+std::optional<TunedConfig> TuningCache::Find(const VkPhysicalDeviceProperties& device) const
+{
+    for (const Entry& entry : m_Entries)
+    {
+        if (entry.VendorID == device.vendorID && entry.DeviceID == device.deviceID && entry.DriverVersion == device.driverVersion)
+            return entry.Config;
+    }
+    return std::nullopt;
+}
+
+void TuningCache::Store(const VkPhysicalDeviceProperties& device, const TunedConfig& config)
+{
+    Entry stored{ device.vendorID, device.deviceID, device.driverVersion, config };
+    bool replaced = false;
+    for (Entry& entry : m_Entries)
+    {
+        if (entry.VendorID == device.vendorID && entry.DeviceID == device.deviceID && entry.DriverVersion == device.driverVersion)
+        {
+            entry = stored;
+            replaced = true;
+        }
+    }
+    if (!replaced)
+        m_Entries.push_back(stored);
+
+    std::ofstream file(m_Path, std::ios::trunc);
+    for (const Entry& entry : m_Entries)
+    {
+        const NISBlockSize& blockSize = entry.Config.BlockSize;
+        file << entry.VendorID << " " << entry.DeviceID << " " << entry.DriverVersion << " " << GetPrecisionName(entry.Config.Precision) << " "
+             << blockSize.Width << " " << blockSize.Height << " " << blockSize.ThreadGroupSize << " "
+             << std::fixed << std::setprecision(3) << entry.Config.Milliseconds << "\n";
+    }
+    if (!file)
+        throw std::runtime_error("Failed to write the tuning cache " + m_Path);
+}
+
+void ApplyTunedConfig(VkNVSharpen& sharpen, const TunedConfig& config)
+{
+    sharpen.SetPrecision(config.Precision);
+    sharpen.SetBlockSize(config.BlockSize);
+}
+
+std::string FormatTunedConfig(const TunedConfig& config)
+{
+    std::ostringstream os;
+    os << GetPrecisionName(config.Precision) << ", blocks " << config.BlockSize.Width << "x" << config.BlockSize.Height
+       << " with " << config.BlockSize.ThreadGroupSize << " threads";
+    return os.str();
+}
+
+TunedConfig Autotune(VkNVSharpen& sharpen, std::ostream& log)
+{
+    std::vector<HostImage> images;
+    for (const Resolution& resolution : Resolutions)
+    {
+        for (uint32_t i = 0; i < resolution.ImageCount; ++i)
+            images.push_back(CreateSyntheticImage(resolution.Width, resolution.Height, uint32_t(images.size())));
+    }
+
+    std::vector<NISPrecision> precisions = { NISPrecision::Full };
+    if (sharpen.SupportsHalfPrecision())
+        precisions.push_back(NISPrecision::Half);
+
+    // Nothing is written while tuning
+    sharpen.SetCompletionHandler([](const ReadbackResult&) {});
+    sharpen.SetGPUTiming(true);
+
+    std::optional<TunedConfig> best;
+    for (NISPrecision precision : precisions)
+    {
+        for (uint32_t height : BlockHeights)
+        {
+            for (uint32_t threadGroupSize : ThreadGroupSizes)
+            {
+                TunedConfig candidate;
+                candidate.Precision = precision;
+                candidate.BlockSize = { 32, height, threadGroupSize };
+                try
+                {
+                    ApplyTunedConfig(sharpen, candidate);
+                }
+                catch (const std::exception& e)
+                {
+                    log << "Skipped " << FormatTunedConfig(candidate) << ": " << e.what() << std::endl;
+                    continue;
+                }
+
+                candidate.Milliseconds = Measure(sharpen, images);
+                log << FormatTunedConfig(candidate) << ": " << std::fixed << std::setprecision(3) << candidate.Milliseconds << " ms" << std::endl;
+                if (!best || candidate.Milliseconds < best->Milliseconds)
+                    best = candidate;
+            }
+        }
+    }
+
+    sharpen.SetGPUTiming(false);
+    sharpen.SetCompletionHandler(nullptr);
+    if (!best)
+        throw std::runtime_error("No NIS configuration runs on this device");
+
+    ApplyTunedConfig(sharpen, *best);
+    log << "Fastest: " << FormatTunedConfig(*best) << std::endl;
+    return *best;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "vk_nv_sharpen.h"
+
+// Shader precision and sharpen block size Autotune picked for one device and driver
+struct TunedConfig
+{
+    NISPrecision Precision = NISPrecision::Full;
+    NISBlockSize BlockSize;
+    // GPU time of the winner over the tuning images
+    double Milliseconds = 0.0;
+};
+
+// Tuned configurations in a text file, one line per device and driver:
+//     <vendorID> <deviceID> <driverVersion> <fp16|fp32> <block width> <block height> <threads> <ms>
+// A driver update changes the key, so its device is tuned again.
+class TuningCache
+{
+public:
+    // A missing or unreadable file is an empty cache
+    explicit TuningCache(std::string path);
+
+    [[nodiscard]] std::optional<TunedConfig> Find(const VkPhysicalDeviceProperties& device) const;
+    // Replaces the device's entry and rewrites the file. Throws when it can't be written.
+    void Store(const VkPhysicalDeviceProperties& device, const TunedConfig& config);
+    [[nodiscard]] const std::string& GetPath() const { return m_Path; }
+
+private:
+    struct Entry
+    {
+        uint32_t VendorID{}, DeviceID{}, DriverVersion{};
+        TunedConfig Config;
+    };
+
+    std::string m_Path;
+    std::vector<Entry> m_Entries;
+};
+
+// Sharpens synthetic images at 720p, 1080p and 4K with every precision, block height
+// and thread group size the device can run, times the NIS dispatches with GPU
+// timestamps and returns the fastest. sharpen is left configured with the winner.
+TunedConfig Autotune(VkNVSharpen& sharpen, std::ostream& log);
+
+// Sets the configuration's precision and block size, throws as those setters do
+void ApplyTunedConfig(VkNVSharpen& sharpen, const TunedConfig& config);
+// "fp16, blocks 32x24 with 128 threads"
+std::string FormatTunedConfig(const TunedConfig& config);
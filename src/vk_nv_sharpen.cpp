@@ -1,418 +1,1141 @@
 #include "vk_nv_sharpen.h"
 #include "common/Image.h"
+#include "common/ProcessMemory.h"
 #include "vulkan/vulkan_device.h"
 #include "vulkan/vulkan_utils.h"
+#include "vulkan/vulkan_pipeline_cache.h"
 #include <map>
 #include <filesystem>
 #include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
 
-VkNVSharpen::VkNVSharpen()
+// The GLSL builds take the NIS block sizes as specialization constants, the HLSL ones
+// have them compiled in
+static constexpr bool UseGLSLShaders = true;
+
+std::string FloatToString(float value, int precision = 2)
+{
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(precision) << value;
+    std::string str = oss.str();
+
+    // Remove trailing zeros
+    str.erase(str.find_last_not_of('0') + 1, std::string::npos);
+
+    // If the last character is a decimal point, remove it
+    if (str.back() == '.')
+        str.pop_back();
+
+    return str;
+}
+
+VkNVSharpen::VkNVSharpen(uint32_t framesInFlight, VkDeviceSize imageCacheBudget, const std::optional<std::string>& pipelineCacheDirectory,
+                         const std::string& shaderDirectory)
 {
-    Initialize();
+    Initialize(framesInFlight, imageCacheBudget, pipelineCacheDirectory, shaderDirectory);
 }
 
 VkNVSharpen::~VkNVSharpen()
 {
+    Flush();
     Cleanup();
 }
 
-void VkNVSharpen::Initialize()
+void VkNVSharpen::Initialize(uint32_t framesInFlight, VkDeviceSize imageCacheBudget, const std::optional<std::string>& pipelineCacheDirectory,
+                             const std::string& shaderDirectory)
 {
-    m_Device = new VulkanDevice();
-    m_NVSharpen = new NVSharpen(*m_Device, std::vector<std::string>({ "NIS/", "../../../NIS/", "." }), false);
-    CreateCommandBufferAndFence();
+    framesInFlight = std::max(framesInFlight, 1u);
+    m_Device = new VulkanDevice(pipelineCacheDirectory, shaderDirectory);
+    m_Startup.Instance = m_Device->GetInstanceCreationTime();
+    m_Startup.Device = m_Device->GetDeviceCreationTime();
+    m_Startup.PipelineCacheBytes = m_Device->GetPipelineCache().GetLoadedSize();
+    m_ImageCache = new VulkanImageCache(*m_Device, imageCacheBudget);
+    m_Precision = m_Device->SupportsFloat16() ? NISPrecision::Half : NISPrecision::Full;
+    {
+        const auto start = std::chrono::steady_clock::now();
+        ScopedPipelineBatch batch(m_Device->GetPipelineCache());
+        m_NVSharpen = new NVSharpen(*m_Device, UseGLSLShaders, framesInFlight, NVSharpen::Variant::Image, m_Precision);
+        m_ChannelPasses = new ChannelPasses(*m_Device, framesInFlight);
+        batch.Create();
+        m_Startup.Pipelines = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    CreateFrames(framesInFlight);
+    QueryDirectImageSupport();
+    m_DirectImages = m_DirectImagesSupported;
 }
 
-void VkNVSharpen::LoadInputImage()
+void VkNVSharpen::QueryDirectImageSupport()
 {
-    img::load(m_CurrentFilePath,
-              m_CurrentImageData,
-              m_CurrentImageWidth, m_CurrentImageHeight,
-              m_CurrentImageRowPitchAlignment,
-              img::Fmt::R8G8B8A8);
+    if (!m_Device->HasUnifiedMemory())
+        return;
+
+    // NVSharpen samples the input with a linear filter and stores to the output
+    const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(m_Device->GetPhysicalDevice(), format, &formatProperties);
+    if ((formatProperties.linearTilingFeatures & features) != features)
+        return;
+
+    // Linear images may be limited to smaller sizes than optimal ones, larger images are staged
+    VkImageFormatProperties imageProperties;
+    if (vkGetPhysicalDeviceImageFormatProperties(m_Device->GetPhysicalDevice(), format, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_LINEAR,
+                                                 VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, 0, &imageProperties) != VK_SUCCESS)
+        return;
+
+    m_DirectImageMaxExtent = { imageProperties.maxExtent.width, imageProperties.maxExtent.height };
+    m_DirectImagesSupported = true;
+}
 
-    m_CurrentImageOutputWidth = m_CurrentImageWidth;
-    m_CurrentImageOutputHeight = m_CurrentImageHeight;
+bool VkNVSharpen::UseDirectImages(const Region& region) const
+{
+    return m_DirectImages && !m_BufferIO && !m_YUVOutput && region.Width <= m_DirectImageMaxExtent.width && region.Height <= m_DirectImageMaxExtent.height;
 }
 
-void VkNVSharpen::CreateTextures()
+void VkNVSharpen::SetBufferIO(bool enable)
 {
-    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    if (enable && m_NVSharpenBuffer == nullptr)
+        m_NVSharpenBuffer = new NVSharpen(*m_Device, UseGLSLShaders, static_cast<uint32_t>(m_Frames.size()), NVSharpen::Variant::Buffer, m_Precision,
+                                          m_BlockSize);
+    m_BufferIO = enable;
+}
 
-    // Create input texture
-    CreateTexture2D(
-            m_CurrentImageWidth,
-            m_CurrentImageHeight,
-            format,
-            m_CurrentImageData.data(),
-            m_CurrentImageRowPitchAlignment,
-            m_CurrentImageData.size(),
-            &m_InputImage,
-            &m_InputImageMemory
-    );
+void VkNVSharpen::SetYUVOutput(bool enable)
+{
+    if (enable && m_NV12Pass == nullptr)
+        m_NV12Pass = new NV12Pass(*m_Device, static_cast<uint32_t>(m_Frames.size()));
+    m_YUVOutput = enable;
+}
 
-    // Create input image view
-    CreateSRV(m_InputImage, format, &m_InputImageView);
+void VkNVSharpen::SetOutputScale(float scale)
+{
+    if (!(scale >= 1.0f && scale <= 2.0f))
+        throw std::runtime_error("The output scale must be between 1 and 2");
+    m_OutputScale = scale;
+    m_OutputSize = {};
+    if (UsesScaling())
+        CreateScaler();
+}
 
-    // Create output texture
-    CreateTexture2D(
-            m_CurrentImageOutputWidth,
-            m_CurrentImageOutputHeight,
-            format,
-            &m_OutputImage,
-            &m_OutputImageMemory
-    );
+void VkNVSharpen::SetOutputSize(uint32_t width, uint32_t height)
+{
+    if ((width == 0) != (height == 0))
+        throw std::runtime_error("The output size needs both a width and a height");
+    m_OutputSize = { width, height };
+    m_OutputScale = 1.0f;
+    if (UsesScaling())
+        CreateScaler();
+}
+
+void VkNVSharpen::SetPrecision(NISPrecision precision)
+{
+    if (precision == NISPrecision::Half && !m_Device->SupportsFloat16())
+        throw std::runtime_error("fp16 shaders need shaderFloat16 and 16-bit storage, which the device does not support");
+    if (precision == m_Precision)
+        return;
+    RecreateNISPipelines(precision, m_BlockSize);
+}
+
+void VkNVSharpen::SetBlockSize(const NISBlockSize& blockSize)
+{
+    if (blockSize == m_BlockSize)
+        return;
+    RecreateNISPipelines(m_Precision, blockSize);
+}
+
+void VkNVSharpen::RecreateNISPipelines(NISPrecision precision, const NISBlockSize& blockSize)
+{
+    // No frame may still reference the old descriptor sets
+    Flush();
+    m_Device->GetComputeQueue().WaitIdle();
+
+    // The image variant is built before anything is destroyed, so a size the device
+    // can't run throws with the old pipelines intact. The variants compile together.
+    ScopedPipelineBatch batch(m_Device->GetPipelineCache());
+    const uint32_t frameCount = static_cast<uint32_t>(m_Frames.size());
+    auto* sharpen = new NVSharpen(*m_Device, UseGLSLShaders, frameCount, NVSharpen::Variant::Image, precision, blockSize);
+    delete m_NVSharpen;
+    m_NVSharpen = sharpen;
+    m_Precision = precision;
+    m_BlockSize = blockSize;
+
+    if (m_NVSharpenBuffer != nullptr)
+    {
+        delete m_NVSharpenBuffer;
+        m_NVSharpenBuffer = new NVSharpen(*m_Device, UseGLSLShaders, frameCount, NVSharpen::Variant::Buffer, m_Precision, m_BlockSize);
+    }
+    if (m_NVSharpenNV12 != nullptr)
+    {
+        delete m_NVSharpenNV12;
+        m_NVSharpenNV12 = new NVSharpen(*m_Device, UseGLSLShaders, frameCount, NVSharpen::Variant::NV12, m_Precision, m_BlockSize);
+    }
+    if (m_NVScaler != nullptr)
+    {
+        delete m_NVScaler;
+        m_NVScaler = new NVScaler(*m_Device, UseGLSLShaders, frameCount, m_Precision);
+    }
+    batch.Create();
+}
+
+void VkNVSharpen::SetGPUTiming(bool enable)
+{
+    if (enable && m_TimestampPool == VK_NULL_HANDLE)
+    {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(m_Device->GetPhysicalDevice(), &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(m_Device->GetPhysicalDevice(), &familyCount, families.data());
+        const uint32_t validBits = families[m_Device->GetComputeQueue().GetFamilyIndex()].timestampValidBits;
+        if (validBits == 0)
+            throw std::runtime_error("The compute queue does not support timestamp queries");
+        m_TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+        m_TimestampPeriod = m_Device->PhysicalDeviceProperties.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        info.queryCount = 2 * static_cast<uint32_t>(m_Frames.size());
+        VK_CHECK_RESULT(vkCreateQueryPool(m_Device->GetDevice(), &info, nullptr, &m_TimestampPool));
+    }
+    m_GPUTiming = enable;
+}
+
+void VkNVSharpen::CreateScaler()
+{
+    if (m_NVScaler == nullptr)
+        m_NVScaler = new NVScaler(*m_Device, UseGLSLShaders, static_cast<uint32_t>(m_Frames.size()), m_Precision);
+}
+
+VkExtent2D VkNVSharpen::GetOutputSize(uint32_t inputWidth, uint32_t inputHeight) const
+{
+    if (m_OutputSize.width != 0)
+        return m_OutputSize;
+    return { uint32_t(std::lround(inputWidth * double(m_OutputScale))), uint32_t(std::lround(inputHeight * double(m_OutputScale))) };
+}
+
+void VkNVSharpen::SetNV12FrameSize(uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0 || width % 2 != 0 || height % 2 != 0)
+        throw std::runtime_error("NV12 frames need an even, non-zero width and height");
+
+    // The luma plane is sampled with a linear filter and the sharpened luma stored to
+    const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(m_Device->GetPhysicalDevice(), VK_FORMAT_R8_UNORM, &formatProperties);
+    if ((formatProperties.optimalTilingFeatures & features) != features)
+        throw std::runtime_error("NV12 input needs R8 storage images, which the device does not support");
+
+    if (m_NVSharpenNV12 == nullptr)
+        m_NVSharpenNV12 = new NVSharpen(*m_Device, UseGLSLShaders, static_cast<uint32_t>(m_Frames.size()), NVSharpen::Variant::NV12, m_Precision,
+                                        m_BlockSize);
+    m_NV12FrameSize = { width, height };
+}
+
+bool VkNVSharpen::IsNV12File(const std::string& path)
+{
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".nv12";
+}
+
+bool VkNVSharpen::UseBufferIO(const Region& region) const
+{
+    // One descriptor covers the whole input; the scaler has no buffer variant
+    return m_BufferIO && !UsesScaling() && VkDeviceSize(region.Width) * 4 * region.Height <= m_Device->PhysicalDeviceProperties.limits.maxStorageBufferRange;
+}
+
+uint32_t VkNVSharpen::GetStagingRowPitch(const VulkanStagingRing& ring, uint32_t width, uint32_t channels, bool bufferIO) const
+{
+    if (channels != 4)
+        return ChannelPasses::GetRowPitch(width, channels);
+    return bufferIO ? width * 4 : ring.GetRowPitch(width, 4);
+}
 
-    // Create output image view
-    CreateSRV(m_OutputImage, format, &m_OutputImageView);
+VkDeviceSize VkNVSharpen::GetStagingAlignment(bool storage) const
+{
+    return storage ? m_Device->PhysicalDeviceProperties.limits.minStorageBufferOffsetAlignment : 0;
+}
+
+bool VkNVSharpen::CanBindStaged(const HostImage& image) const
+{
+    // Images decoded before buffer I/O was enabled have the copy layout, and the
+    // buffer shader only reads RGBA
+    return image.Channels == 4 && image.RowPitch == image.Width * 4 && image.Staging.Get().Offset % GetStagingAlignment(true) == 0;
+}
+
+HostImage VkNVSharpen::LoadImage(const std::string& inputImagePath, const std::string& outputDirPath, bool intoStaging) const
+{
+    HostImage image;
+    image.StartTime = std::chrono::steady_clock::now();
+    image.OutputPath = GetOutputPath(inputImagePath, outputDirPath);
+
+    // Pixels land where Submit uploads them from, with the device's preferred row pitch.
+    // Images that will be tiled are gathered tile by tile on the host, so they stay in
+    // cached memory, as do images copied straight into mapped images.
+    // Buffer I/O widens images with fewer channels on the host, so those stay cached too.
+    VulkanStagingRing& ring = m_Device->GetUploadRing();
+    auto allocate = [&](size_t size, VkDeviceSize alignment, bool staged, bool import) -> uint8_t*
+    {
+        if (staged)
+        {
+            if (import)
+            {
+                // Cached host memory the device reads directly; null if the import fails
+                image.Imported = m_Device->GetHostImportPool().Acquire(size);
+                if (image.Imported)
+                    return image.Imported->Data;
+            }
+            image.Staging = StagingHandle(ring, ring.Allocate(size, alignment));
+            return static_cast<uint8_t*>(image.Staging.Get().Mapped);
+        }
+        image.Data.resize(size);
+        return image.Data.data();
+    };
+
+    if (IsNV12File(inputImagePath))
+    {
+        // Copied into R8 images whichever path other images take
+        if (m_NV12FrameSize.width == 0)
+            throw std::runtime_error("No NV12 frame size is set for " + inputImagePath);
+        img::loadNV12(inputImagePath, m_NV12FrameSize.width, m_NV12FrameSize.height, [&](uint32_t width, uint32_t height, uint32_t& rowPitch)
+        {
+            image.Width = width;
+            image.Height = height;
+            image.Channels = 1;
+            image.Layout = PixelLayout::NV12;
+            rowPitch = image.RowPitch = ring.GetRowPitch(width, 1);
+            return allocate(size_t(rowPitch) * GetRowCount(PixelLayout::NV12, height), 0, intoStaging, m_HostImport);
+        });
+        return image;
+    }
+
+    const uint32_t tileSize = GetTileSize();
+    intoStaging = intoStaging && (m_BufferIO || !m_DirectImages || m_YUVOutput);
+    img::loadCompact(inputImagePath, [&](uint32_t width, uint32_t height, uint32_t channels, uint32_t& rowPitch)
+    {
+        image.Width = width;
+        image.Height = height;
+        image.Channels = channels;
+        rowPitch = image.RowPitch = GetStagingRowPitch(ring, width, channels, m_BufferIO);
+        const bool staged = intoStaging && (channels == 4 || !m_BufferIO) && width <= tileSize && height <= tileSize;
+        return allocate(size_t(rowPitch) * height, GetStagingAlignment(m_BufferIO || channels != 4), staged, m_HostImport && !m_BufferIO);
+    });
+    return image;
+}
+
+std::string VkNVSharpen::GetOutputPath(const std::string& inputImagePath, const std::string& outputDirPath) const
+{
+    const char* extension = IsNV12File(inputImagePath) ? ".nv12" : m_YUVOutput ? ".yuv" : ".png";
+    std::string outputName = std::filesystem::path(inputImagePath).stem().string() + "_NVSharpened_" + FloatToString(m_CurrentSharpness) + "%" + extension;
+    return (std::filesystem::path(outputDirPath) / outputName).string();
+}
+
+void VkNVSharpen::UploadInputImage(FrameContext& frame, const HostImage& image, const Region& region, StagingAllocation staged)
+{
+    frame.OutputPath = image.OutputPath;
+    frame.StartTime = image.StartTime;
+    frame.InputWidth = region.Width;
+    frame.InputHeight = region.Height;
+
+    // Written straight into the mapped input image once it is acquired
+    if (frame.Direct)
+        return;
+
+    if (staged.IsValid())
+    {
+        // Decoded in place, nothing to copy
+        frame.InputRowPitch = image.RowPitch;
+        frame.Upload = staged;
+        return;
+    }
+
+    const bool whole = region.Width == image.Width && region.Height == image.Height;
+    if (image.Imported && whole && !frame.BufferIO)
+    {
+        // The copy reads the decoded pixels where they are, the frame keeps them alive
+        frame.InputRowPitch = image.RowPitch;
+        frame.Imported = image.Imported;
+        return;
+    }
+
+    VulkanStagingRing& ring = m_Device->GetUploadRing();
+    const uint32_t channels = frame.GetStagingChannels();
+    const uint32_t rowPitch = GetStagingRowPitch(ring, region.Width, channels, frame.BufferIO);
+    const VkDeviceSize alignment = GetStagingAlignment(frame.BufferIO || frame.Compact);
+    if (whole && image.Channels == channels && (!frame.BufferIO || image.RowPitch == rowPitch))
+    {
+        const size_t size = size_t(image.RowPitch) * GetRowCount(image.Layout, image.Height);
+        frame.InputRowPitch = image.RowPitch;
+        frame.Upload = ring.Allocate(size, alignment);
+        memcpy(frame.Upload.Mapped, image.GetPixels(), size);
+        return;
+    }
+
+    // A tile, or rows repacked or widened to RGBA for the buffer shader, gathered row by
+    // row out of the full image
+    frame.InputRowPitch = rowPitch;
+    frame.Upload = ring.Allocate(VkDeviceSize(frame.InputRowPitch) * region.Height, alignment);
+    const size_t rowBytes = size_t(region.Width) * channels;
+    for (uint32_t y = 0; y < region.Height; ++y)
+    {
+        const uint8_t* src = image.GetPixels() + size_t(region.Y + y) * image.RowPitch + size_t(region.X) * image.Channels;
+        uint8_t* dst = static_cast<uint8_t*>(frame.Upload.Mapped) + size_t(y) * frame.InputRowPitch;
+        if (image.Channels == channels)
+            memcpy(dst, src, rowBytes);
+        else
+            img::expandRowToRGBA8(src, image.Channels, dst, region.Width);
+    }
+}
+
+void VkNVSharpen::WriteInputImage(FrameContext& frame, const HostImage& image, const Region& region)
+{
+    // The frame slot was retired, so the GPU is done with whatever this image held before
+    const CachedImage& input = frame.InputImage;
+    frame.InputRowPitch = uint32_t(input.RowPitch);
+    const size_t rowBytes = size_t(region.Width) * 4;
+    for (uint32_t y = 0; y < region.Height; ++y)
+    {
+        const uint8_t* src = image.GetPixels() + size_t(region.Y + y) * image.RowPitch + size_t(region.X) * image.Channels;
+        uint8_t* dst = input.GetPixels() + size_t(y) * input.RowPitch;
+        if (image.Channels == 4)
+            memcpy(dst, src, rowBytes);
+        else
+            img::expandRowToRGBA8(src, image.Channels, dst, region.Width);
+    }
+    VK_CHECK_RESULT(m_Device->GetAllocator().Flush(input.Memory));
 }
 
+void VkNVSharpen::AllocateReadback(FrameContext& frame)
+{
+    VulkanStagingRing& ring = m_Device->GetReadbackRing();
+    if (frame.NV12)
+    {
+        // Room for the chroma rows behind the luma plane
+        frame.OutputRowPitch = ring.GetRowPitch(frame.OutputWidth, 1);
+        frame.Readback = ring.Allocate(VkDeviceSize(frame.OutputRowPitch) * GetRowCount(PixelLayout::NV12, frame.OutputHeight));
+        return;
+    }
+    if (frame.YUV)
+    {
+        // Written by the conversion pass as a storage buffer
+        frame.OutputRowPitch = NV12Pass::GetRowPitch(frame.OutputWidth);
+        frame.Readback = ring.Allocate(VkDeviceSize(frame.OutputRowPitch) * GetRowCount(PixelLayout::NV12, frame.OutputHeight), GetStagingAlignment(true));
+        return;
+    }
+    frame.OutputRowPitch = GetStagingRowPitch(ring, frame.OutputWidth, frame.GetStagingChannels(), frame.BufferIO);
+    frame.Readback = ring.Allocate(VkDeviceSize(frame.OutputRowPitch) * frame.OutputHeight, GetStagingAlignment(frame.BufferIO || frame.Compact));
+}
 
-void VkNVSharpen::CreateCommandBufferAndFence()
+void VkNVSharpen::CreateTextures(FrameContext& frame)
 {
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.commandPool = m_Device->GetComputeCommandPool();
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandBufferCount = 1;
-    vkAllocateCommandBuffers(m_Device->GetDevice(), &commandBufferAllocateInfo, &m_ComputeCommandBuffer);
+    const VkFormat format = frame.NV12 ? VK_FORMAT_R8_UNORM : VK_FORMAT_R8G8B8A8_UNORM;
+    const VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    const VkImageUsageFlags directUsage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    const ImageKey inputKey{ frame.InputWidth, frame.InputHeight, format, frame.Direct ? directUsage : usage, frame.Direct };
+    const ImageKey outputKey{ frame.OutputWidth, frame.OutputHeight, format, frame.Direct ? directUsage : usage, frame.Direct };
+
+    // Same-sized images released by earlier frames come back from the cache
+    frame.InputImage = m_ImageCache->Acquire(inputKey);
+    frame.OutputImage = m_ImageCache->Acquire(outputKey);
+    if (frame.Direct)
+        frame.OutputRowPitch = uint32_t(frame.OutputImage.RowPitch);
+}
 
-    VkFenceCreateInfo fenceCreateInfo{};
-    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    VK_CHECK_RESULT(vkCreateFence(m_Device->GetDevice(), &fenceCreateInfo, nullptr, &m_ComputeFence));
+void VkNVSharpen::CreateFrames(uint32_t count)
+{
+    m_Frames.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        FrameContext& frame = m_Frames[i];
+        frame.Index = i;
+
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocateInfo.commandPool = m_Device->GetComputeCommandPool();
+        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferAllocateInfo.commandBufferCount = 1;
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(m_Device->GetDevice(), &commandBufferAllocateInfo, &frame.CommandBuffer));
+
+        if (m_Device->HasDedicatedTransferQueue())
+        {
+            commandBufferAllocateInfo.commandPool = m_Device->GetTransferCommandPool();
+            VK_CHECK_RESULT(vkAllocateCommandBuffers(m_Device->GetDevice(), &commandBufferAllocateInfo, &frame.UploadCommandBuffer));
+            VK_CHECK_RESULT(vkAllocateCommandBuffers(m_Device->GetDevice(), &commandBufferAllocateInfo, &frame.ReadbackCommandBuffer));
+        }
+    }
 }
 
-void VkNVSharpen::UpdateNVSharpen()
+void VkNVSharpen::UpdateNVSharpen(FrameContext& frame)
 {
-    m_NVSharpen->Update(
+    if (frame.Scaled)
+    {
+        m_NVScaler->Update(frame.Index, m_CurrentSharpness / 100.0f, frame.InputWidth, frame.InputHeight, frame.OutputWidth, frame.OutputHeight);
+        return;
+    }
+    NVSharpen* sharpen = frame.BufferIO ? m_NVSharpenBuffer : frame.NV12 ? m_NVSharpenNV12 : m_NVSharpen;
+    sharpen->Update(
+            frame.Index,
             m_CurrentSharpness / 100.0f,
-            m_CurrentImageWidth,
-            m_CurrentImageHeight);
+            frame.InputWidth,
+            frame.InputHeight);
 }
 
-void VkNVSharpen::DispatchComputeShader()
+// Makes a device write to a staging region visible to the host reading it after the ticket
+static void HostReadBarrier(VkCommandBuffer cmd, const StagingAllocation& allocation, VkAccessFlags srcAccessMask, VkPipelineStageFlags srcStage)
 {
+    VkBufferMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = srcAccessMask;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = allocation.Buffer;
+    hostBarrier.offset = allocation.Offset;
+    hostBarrier.size = allocation.Size;
+    vkCmdPipelineBarrier(cmd, srcStage, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+}
+
+static void BeginCommandBuffer(VkCommandBuffer cmd)
+{
+    VK_CHECK_RESULT(vkResetCommandBuffer(cmd, 0));
+
     VkCommandBufferBeginInfo cmdBufferBeginInfo{};
     cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    VK_CHECK_RESULT(vkBeginCommandBuffer(m_ComputeCommandBuffer, &cmdBufferBeginInfo));
-
-    // Transition input image to shader read optimal if it's not already
-    TransitionImageLayout(
-            m_ComputeCommandBuffer,
-            m_InputImage,
-            VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-    );
-
-    // Transition output image to general layout for compute shader write
-    TransitionImageLayout(
-            m_ComputeCommandBuffer,
-            m_OutputImage,
-            VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_GENERAL
-    );
+    cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(cmd, &cmdBufferBeginInfo));
+}
 
-    m_NVSharpen->Dispatch(
-            m_ComputeCommandBuffer,
-            m_InputImageView,
-            m_OutputImageView
-    );
+void VkNVSharpen::RecordFrame(FrameContext& frame)
+{
+    if (!UseTransferQueue(frame))
+    {
+        // Everything in one command buffer on the compute queue
+        const bool copies = !frame.Direct && !frame.BufferIO && !frame.Compact;
+        BeginCommandBuffer(frame.CommandBuffer);
+        if (copies)
+            RecordUpload(frame.CommandBuffer, frame);
+        RecordSharpen(frame.CommandBuffer, frame);
+        if (copies && !frame.YUV)
+            RecordReadback(frame.CommandBuffer, frame);
+        VK_CHECK_RESULT(vkEndCommandBuffer(frame.CommandBuffer));
+        return;
+    }
 
-    // Transition output image to transfer src for potential read back
-    TransitionImageLayout(
-            m_ComputeCommandBuffer,
-            m_OutputImage,
-            VK_IMAGE_LAYOUT_GENERAL,
-            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
-    );
+    BeginCommandBuffer(frame.UploadCommandBuffer);
+    RecordUpload(frame.UploadCommandBuffer, frame);
+    VK_CHECK_RESULT(vkEndCommandBuffer(frame.UploadCommandBuffer));
 
-    VK_CHECK_RESULT(vkEndCommandBuffer(m_ComputeCommandBuffer));
+    BeginCommandBuffer(frame.CommandBuffer);
+    RecordSharpen(frame.CommandBuffer, frame);
+    VK_CHECK_RESULT(vkEndCommandBuffer(frame.CommandBuffer));
 
-    SubmitAndWait();
+    BeginCommandBuffer(frame.ReadbackCommandBuffer);
+    RecordReadback(frame.ReadbackCommandBuffer, frame);
+    VK_CHECK_RESULT(vkEndCommandBuffer(frame.ReadbackCommandBuffer));
 }
 
-void VkNVSharpen::SubmitAndWait()
+void VkNVSharpen::RecordUpload(VkCommandBuffer cmd, FrameContext& frame)
 {
-    vkResetFences(m_Device->GetDevice(), 1, &m_ComputeFence);
+    // Upload: staging or imported host buffer -> input image
+    const VkBuffer source = frame.Imported ? frame.Imported->Buffer : frame.Upload.Buffer;
+    const VkDeviceSize sourceOffset = frame.Imported ? 0 : frame.Upload.Offset;
+    TransitionImageLayout(cmd, frame.InputImage.Image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    {
+        VkBufferImageCopy region{};
+        region.bufferOffset = sourceOffset;
+        region.bufferRowLength = frame.InputRowPitch / (frame.NV12 ? 1 : 4);
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { frame.InputWidth, frame.InputHeight, 1 };
+        vkCmdCopyBufferToImage(cmd, source, frame.InputImage.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
 
-    const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pWaitDstStageMask = &waitStageMask;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &m_ComputeCommandBuffer;
-    VK_CHECK_RESULT(vkQueueSubmit(m_Device->GetComputeQueue(), 1, &submitInfo, m_ComputeFence));
-    VK_CHECK_RESULT(vkWaitForFences(m_Device->GetDevice(), 1, &m_ComputeFence, VK_TRUE, UINT64_MAX));
-    vkQueueWaitIdle(m_Device->GetComputeQueue());
+    if (frame.NV12)
+    {
+        // Chroma is not sharpened and goes straight to its place behind the luma rows of
+        // the readback region, one region per row when the two row pitches differ. The
+        // host read barrier after the luma readback covers it.
+        const uint32_t chromaRows = frame.InputHeight / 2;
+        const VkDeviceSize inputChroma = sourceOffset + VkDeviceSize(frame.InputRowPitch) * frame.InputHeight;
+        const VkDeviceSize outputChroma = frame.Readback.Offset + VkDeviceSize(frame.OutputRowPitch) * frame.OutputHeight;
+        std::vector<VkBufferCopy> regions;
+        if (frame.InputRowPitch == frame.OutputRowPitch)
+            regions.push_back({ inputChroma, outputChroma, VkDeviceSize(frame.InputRowPitch) * chromaRows });
+        else
+            for (uint32_t y = 0; y < chromaRows; ++y)
+                regions.push_back({ inputChroma + VkDeviceSize(y) * frame.InputRowPitch, outputChroma + VkDeviceSize(y) * frame.OutputRowPitch, frame.InputWidth });
+        vkCmdCopyBuffer(cmd, source, frame.Readback.Buffer, static_cast<uint32_t>(regions.size()), regions.data());
+    }
+
+    if (UseTransferQueue(frame))
+    {
+        // Release half of the ownership transfer to the compute queue
+        QueueOwnershipBarrier(cmd, frame.InputImage.Image,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                              VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                              m_Device->GetTransferQueue().GetFamilyIndex(), m_Device->GetComputeQueue().GetFamilyIndex());
+    }
+    else
+    {
+        TransitionImageLayout(cmd, frame.InputImage.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
 }
 
-std::string FloatToString(float value, int precision = 2)
+void VkNVSharpen::RecordSharpen(VkCommandBuffer cmd, FrameContext& frame)
 {
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(precision) << value;
-    std::string str = oss.str();
+    if (frame.BufferIO)
+    {
+        // The host wrote the input before submitting, the submission makes the writes
+        // visible. The output lands in the readback region for the host to read.
+        const VkDescriptorBufferInfo input{ frame.Upload.Buffer, frame.Upload.Offset, VkDeviceSize(frame.InputRowPitch) * frame.InputHeight };
+        const VkDescriptorBufferInfo output{ frame.Readback.Buffer, frame.Readback.Offset, VkDeviceSize(frame.OutputRowPitch) * frame.OutputHeight };
+        BeginTimestamp(cmd, frame);
+        m_NVSharpenBuffer->Dispatch(cmd, frame.Index, input, output);
+        EndTimestamp(cmd, frame);
+        HostReadBarrier(cmd, frame.Readback, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        return;
+    }
 
-    // Remove trailing zeros
-    str.erase(str.find_last_not_of('0') + 1, std::string::npos);
+    const bool ownershipTransfer = UseTransferQueue(frame);
+    const uint32_t transferFamily = m_Device->GetTransferQueue().GetFamilyIndex();
+    const uint32_t computeFamily = m_Device->GetComputeQueue().GetFamilyIndex();
 
-    // If the last character is a decimal point, remove it
-    if (str.back() == '.')
-        str.pop_back();
+    if (frame.Direct)
+    {
+        // The host wrote the input before submitting, the submission makes the writes visible
+        ImageBarrier(cmd, frame.InputImage.Image,
+                     frame.InputImage.Layout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     0, VK_ACCESS_SHADER_READ_BIT,
+                     VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+    else if (frame.Compact)
+    {
+        // Widen the packed upload into the input image
+        const VkDescriptorBufferInfo source = frame.Imported
+                ? VkDescriptorBufferInfo{ frame.Imported->Buffer, 0, VkDeviceSize(frame.InputRowPitch) * frame.InputHeight }
+                : VkDescriptorBufferInfo{ frame.Upload.Buffer, frame.Upload.Offset, VkDeviceSize(frame.InputRowPitch) * frame.InputHeight };
+        TransitionImageLayout(cmd, frame.InputImage.Image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+        m_ChannelPasses->RecordExpand(cmd, frame.Index, source, frame.InputRowPitch, frame.Channels,
+                                      frame.InputImage.View, frame.InputWidth, frame.InputHeight);
+        ImageBarrier(cmd, frame.InputImage.Image,
+                     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+    else if (ownershipTransfer)
+    {
+        // Acquire the input from the transfer queue, the submission waits on the upload's ticket
+        QueueOwnershipBarrier(cmd, frame.InputImage.Image,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                              0, VK_ACCESS_SHADER_READ_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              transferFamily, computeFamily);
+    }
 
-    return str;
+    // Sharpen
+    TransitionImageLayout(cmd, frame.OutputImage.Image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    BeginTimestamp(cmd, frame);
+    if (frame.Scaled)
+    {
+        m_NVScaler->Dispatch(cmd, frame.Index, frame.InputImage.View, frame.OutputImage.View);
+    }
+    else
+    {
+        NVSharpen* sharpen = frame.NV12 ? m_NVSharpenNV12 : m_NVSharpen;
+        sharpen->Dispatch(cmd, frame.Index, frame.InputImage.View, frame.OutputImage.View);
+    }
+    EndTimestamp(cmd, frame);
+
+    if (frame.Direct)
+    {
+        // The host reads the output in place. The input goes back to GENERAL for the
+        // host writes of whichever frame acquires it next.
+        ImageBarrier(cmd, frame.OutputImage.Image,
+                     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+                     VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+        ImageBarrier(cmd, frame.InputImage.Image,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+                     0, 0,
+                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+        frame.InputImage.Layout = VK_IMAGE_LAYOUT_GENERAL;
+        frame.OutputImage.Layout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+    else if (frame.YUV)
+    {
+        // Convert the output into the readback region, only the YUV bytes reach the host
+        ImageBarrier(cmd, frame.OutputImage.Image,
+                     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+                     VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        const VkDescriptorBufferInfo target{ frame.Readback.Buffer, frame.Readback.Offset,
+                                             VkDeviceSize(frame.OutputRowPitch) * GetRowCount(PixelLayout::NV12, frame.OutputHeight) };
+        m_NV12Pass->Record(cmd, frame.Index, frame.OutputImage.View, target, frame.OutputRowPitch, frame.OutputWidth, frame.OutputHeight);
+        HostReadBarrier(cmd, frame.Readback, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+    else if (frame.Compact)
+    {
+        // Narrow the output into the readback region for the host to read
+        ImageBarrier(cmd, frame.OutputImage.Image,
+                     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+                     VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        const VkDescriptorBufferInfo target{ frame.Readback.Buffer, frame.Readback.Offset, VkDeviceSize(frame.OutputRowPitch) * frame.OutputHeight };
+        m_ChannelPasses->RecordPack(cmd, frame.Index, frame.OutputImage.View, target, frame.OutputRowPitch, frame.Channels,
+                                    frame.OutputWidth, frame.OutputHeight);
+        HostReadBarrier(cmd, frame.Readback, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+    else if (ownershipTransfer)
+    {
+        QueueOwnershipBarrier(cmd, frame.OutputImage.Image,
+                              VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                              VK_ACCESS_SHADER_WRITE_BIT, 0,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                              computeFamily, transferFamily);
+    }
+    else
+    {
+        TransitionImageLayout(cmd, frame.OutputImage.Image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    }
 }
 
-void VkNVSharpen::SaveOutputImage()
+// The start timestamp waits for the compute work before it, the input conversions and
+// barriers, so the pair brackets the NIS dispatch alone
+void VkNVSharpen::BeginTimestamp(VkCommandBuffer cmd, FrameContext& frame)
 {
-    VkDeviceSize imageSize = m_CurrentImageOutputWidth * m_CurrentImageOutputHeight * 4;
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 &stagingBuffer, &stagingBufferMemory);
+    frame.Timed = m_GPUTiming;
+    if (!frame.Timed)
+        return;
+    vkCmdResetQueryPool(cmd, m_TimestampPool, 2 * frame.Index, 2);
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, m_TimestampPool, 2 * frame.Index);
+}
 
-    VkCommandBuffer cmdBuffer = m_Device->BeginSingleTimeCommands();
+void VkNVSharpen::EndTimestamp(VkCommandBuffer cmd, const FrameContext& frame)
+{
+    if (frame.Timed)
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, m_TimestampPool, 2 * frame.Index + 1);
+}
 
-    VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
+void VkNVSharpen::RecordReadback(VkCommandBuffer cmd, FrameContext& frame)
+{
+    if (UseTransferQueue(frame))
+    {
+        QueueOwnershipBarrier(cmd, frame.OutputImage.Image,
+                              VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                              0, VK_ACCESS_TRANSFER_READ_BIT,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              m_Device->GetComputeQueue().GetFamilyIndex(), m_Device->GetTransferQueue().GetFamilyIndex());
+    }
+
+    // Readback: output image -> host visible buffer
+    VkBufferImageCopy region{};
+    region.bufferOffset = frame.Readback.Offset;
+    region.bufferRowLength = frame.OutputRowPitch / (frame.NV12 ? 1 : 4);
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {m_CurrentImageOutputWidth, m_CurrentImageOutputHeight, 1};
-
-    vkCmdCopyImageToBuffer(
-            cmdBuffer,
-            m_OutputImage,
-            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            stagingBuffer, 1, &region);
-
-    m_Device->EndSingleTimeCommand(cmdBuffer);
-
-    // Transition the image back to SHADER_READ_ONLY_OPTIMAL layout if needed
-    cmdBuffer = m_Device->BeginSingleTimeCommands();
-    TransitionImageLayout(cmdBuffer,
-                          m_OutputImage,
-                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    m_Device->EndSingleTimeCommand(cmdBuffer);
-
-    void* data;
-    vkMapMemory(m_Device->GetDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-
-    VkMappedMemoryRange memoryRange = {};
-    memoryRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    memoryRange.memory = stagingBufferMemory;
-    memoryRange.size = VK_WHOLE_SIZE;
-    vkInvalidateMappedMemoryRanges(m_Device->GetDevice(), 1, &memoryRange);
-
-    std::string outputName = m_CurrentInputImageName + "_NVSharpened_" + FloatToString(m_CurrentSharpness) + "%.png";
-    std::filesystem::path outputPath = std::filesystem::path(m_OutputDirectory) / outputName;
-    std::string fullOutputPath = outputPath.string();
-    img::savePNG(
-            fullOutputPath,
-            static_cast<uint8_t*>(data),
-            m_CurrentImageOutputWidth,
-            m_CurrentImageOutputHeight,
-            4,
-            m_CurrentImageOutputWidth * 4,
-            img::Fmt::R8G8B8A8);
-    vkUnmapMemory(m_Device->GetDevice(), stagingBufferMemory);
+    region.imageExtent = { frame.OutputWidth, frame.OutputHeight, 1 };
+    vkCmdCopyImageToBuffer(cmd, frame.OutputImage.Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.Readback.Buffer, 1, &region);
+    HostReadBarrier(cmd, frame.Readback, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+}
+
+void VkNVSharpen::SubmitFrame(FrameContext& frame)
+{
+    frame.InFlight = true;
+
+    // Host writes to non-coherent upload memory must reach the device first
+    m_Device->GetUploadRing().Flush(frame.Upload);
 
-    vkDestroyBuffer(m_Device->GetDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), stagingBufferMemory, nullptr);
+    if (!UseTransferQueue(frame))
+    {
+        frame.Ticket = m_Device->GetComputeQueue().Submit(frame.CommandBuffer);
+
+        // The upload region can be reused once this submission completes
+        m_Device->GetUploadRing().Release(frame.Upload, frame.Ticket);
+        frame.Upload = {};
+
+        // A copied image before this one still waits for its readback to go in
+        if (m_PendingReadback != nullptr)
+            SubmitReadback(*m_PendingReadback);
+        return;
+    }
+
+    VulkanQueue& transferQueue = m_Device->GetTransferQueue();
+    VulkanQueue& computeQueue = m_Device->GetComputeQueue();
+
+    QueueTicket uploadTicket = transferQueue.Submit(frame.UploadCommandBuffer);
+    m_Device->GetUploadRing().Release(frame.Upload, uploadTicket);
+    frame.Upload = {};
+
+    frame.SharpenTicket = computeQueue.Submit(frame.CommandBuffer,
+            { { transferQueue.GetTimeline(), uploadTicket.Value, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT } });
+
+    // The previous image's readback goes in behind this upload. Submitting it first
+    // would park the transfer queue on its wait for the previous dispatch and keep
+    // this upload from overlapping with it.
+    if (m_PendingReadback != nullptr)
+        SubmitReadback(*m_PendingReadback);
+    m_PendingReadback = &frame;
 }
 
-void VkNVSharpen::Cleanup()
+void VkNVSharpen::SubmitReadback(FrameContext& frame)
 {
-    vkDestroyFence(m_Device->GetDevice(), m_ComputeFence, nullptr);
-    vkFreeCommandBuffers(m_Device->GetDevice(), m_Device->GetComputeCommandPool(), 1, &m_ComputeCommandBuffer);
-    delete m_NVSharpen;
-    delete m_Device;
+    VulkanQueue& computeQueue = m_Device->GetComputeQueue();
+    frame.Ticket = m_Device->GetTransferQueue().Submit(frame.ReadbackCommandBuffer,
+            { { computeQueue.GetTimeline(), frame.SharpenTicket.Value, VK_PIPELINE_STAGE_TRANSFER_BIT } });
+    if (m_PendingReadback == &frame)
+        m_PendingReadback = nullptr;
 }
 
-void VkNVSharpen::ProcessImage(const std::string& inputImagePath, const std::string& outputDirPath)
+void VkNVSharpen::RetireFrame(FrameContext& frame)
 {
-    m_CurrentFilePath = inputImagePath;
-    m_OutputDirectory = outputDirPath;
-    std::filesystem::path path(inputImagePath);
-    m_CurrentInputImageName = path.stem().string();
+    if (!frame.InFlight)
+        return;
 
-    LoadInputImage();
-    CreateTextures();
-    UpdateNVSharpen();
-    DispatchComputeShader();
-    SaveOutputImage();
+    if (m_PendingReadback == &frame)
+        SubmitReadback(frame);
 
-    FreeImageResources();
+    frame.Ticket.Wait();
+    frame.InFlight = false;
+    if (frame.Timed)
+    {
+        uint64_t timestamps[2]{};
+        VK_CHECK_RESULT(vkGetQueryPoolResults(m_Device->GetDevice(), m_TimestampPool, 2 * frame.Index, 2, sizeof(timestamps), timestamps,
+                                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        m_GPUTime += double((timestamps[1] - timestamps[0]) & m_TimestampMask) * m_TimestampPeriod * 1e-6;
+        frame.Timed = false;
+    }
+    SaveOutputImage(frame);
+    FreeImageResources(frame);
+}
+
+const uint8_t* VkNVSharpen::MapOutput(FrameContext& frame)
+{
+    // Cached readback memory may still hold stale lines of the previous image
+    if (frame.Direct)
+    {
+        VK_CHECK_RESULT(m_Device->GetAllocator().Invalidate(frame.OutputImage.Memory));
+        return frame.OutputImage.GetPixels();
+    }
+    m_Device->GetReadbackRing().Invalidate(frame.Readback);
+    return static_cast<const uint8_t*>(frame.Readback.Mapped);
 }
 
-void VkNVSharpen::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags buffUsage, VkMemoryPropertyFlags memProps, VkBuffer* outBuffer, VkDeviceMemory* outBuffMem)
+void VkNVSharpen::SaveOutputImage(FrameContext& frame)
 {
+    if (frame.Tiled)
     {
-        VkBufferCreateInfo info{};
-        info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        info.size = size;
-        info.usage = buffUsage;
-        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-        VK_CHECK_RESULT(vkCreateBuffer(m_Device->GetDevice(), &info, nullptr, outBuffer));
+        StoreTile(frame);
+        return;
     }
+
+    if (frame.Channels != frame.GetStagingChannels())
     {
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements(m_Device->GetDevice(), *outBuffer, &memReqs);
+        // Direct and buffer I/O frames hold RGBA, narrowed here to the input's channels
+        const uint8_t* pixels = MapOutput(frame);
+        const uint32_t rowPitch = frame.OutputWidth * frame.Channels;
+        std::vector<uint8_t> packed(size_t(rowPitch) * frame.OutputHeight);
+        for (uint32_t y = 0; y < frame.OutputHeight; ++y)
+            img::packRowFromRGBA8(pixels + size_t(y) * frame.OutputRowPitch, packed.data() + size_t(y) * rowPitch, frame.Channels, frame.OutputWidth);
+        m_Device->GetReadbackRing().Release(frame.Readback);
+        frame.Readback = {};
+
+        ReadbackResult result{ frame.OutputPath, packed.data(), frame.OutputWidth, frame.OutputHeight, rowPitch, nullptr, frame.Channels };
+        CompleteImage(result, frame.StartTime);
+        return;
+    }
 
-        VkMemoryAllocateInfo info{};
-        info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        info.allocationSize = memReqs.size;
-        info.memoryTypeIndex = m_Device->FindMemoryType(memReqs.memoryTypeBits, memProps);
-        VK_CHECK_RESULT(vkAllocateMemory(m_Device->GetDevice(), &info, nullptr, outBuffMem));
+    if (frame.Direct)
+    {
+        // Read in place; the image goes back to the cache after the handler returns
+        ReadbackResult result{ frame.OutputPath, MapOutput(frame), frame.OutputWidth, frame.OutputHeight, frame.OutputRowPitch };
+        CompleteImage(result, frame.StartTime);
+        return;
     }
 
-    VK_CHECK_RESULT(vkBindBufferMemory(m_Device->GetDevice(), *outBuffer, *outBuffMem, 0));
+    // The ticket has completed, so the region is free to go once the host is done
+    // reading it, here or wherever the handler moves the handle to
+    const uint8_t* pixels = MapOutput(frame);
+    StagingHandle readback(m_Device->GetReadbackRing(), frame.Readback);
+    frame.Readback = {};
+
+    ReadbackResult result{
+            frame.OutputPath,
+            pixels,
+            frame.OutputWidth,
+            frame.OutputHeight,
+            frame.OutputRowPitch,
+            &readback,
+            frame.NV12 || frame.YUV ? 1 : frame.Channels,
+            frame.NV12 || frame.YUV ? PixelLayout::NV12 : PixelLayout::Packed };
+    CompleteImage(result, frame.StartTime);
 }
 
-void VkNVSharpen::CreateTexture2D(int w, int h, VkFormat format, const void* data, uint32_t rowPitch, uint32_t imageSize, VkImage* outImage, VkDeviceMemory* outDeviceMemory)
+void VkNVSharpen::StoreTile(FrameContext& frame)
 {
-    auto width = static_cast<uint32_t>(w);
-    auto height = static_cast<uint32_t>(h);
+    TiledOutput& tiled = *frame.Tiled;
+    const Region& interior = frame.TileInterior;
+    const uint8_t* readback = MapOutput(frame);
+    const uint32_t channels = frame.GetStagingChannels();
+    const size_t rowBytes = size_t(interior.Width) * channels;
+    for (uint32_t y = 0; y < interior.Height; ++y)
+    {
+        const uint8_t* src = readback + size_t(interior.Y + y) * frame.OutputRowPitch + size_t(interior.X) * channels;
+        uint8_t* dst = tiled.Data.data() + size_t(frame.TileOriginY + y) * tiled.RowPitch + size_t(frame.TileOriginX) * tiled.Channels;
+        if (channels == tiled.Channels)
+            memcpy(dst, src, rowBytes);
+        else
+            img::packRowFromRGBA8(src, dst, tiled.Channels, interior.Width);
+    }
 
-    VkBuffer stagingBuff;
-    VkDeviceMemory stagingBuffMem;
-
-    CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 &stagingBuff, &stagingBuffMem);
-
-    void* mappedMem;
-    VK_CHECK_RESULT(vkMapMemory(m_Device->GetDevice(), stagingBuffMem, 0, imageSize, 0, &mappedMem));
-    memcpy(mappedMem, data, imageSize);
-    vkUnmapMemory(m_Device->GetDevice(), stagingBuffMem);
+    m_Device->GetReadbackRing().Release(frame.Readback);
+    frame.Readback = {};
 
-    // Create texture image object and backing memory
+    if (--tiled.RemainingTiles == 0)
     {
-        VkImageCreateInfo info{};
-        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-        info.imageType = VK_IMAGE_TYPE_2D;
-        info.extent.width = width;
-        info.extent.height = height;
-        info.extent.depth = 1;
-        info.mipLevels = 1;
-        info.arrayLayers = 1;
-        info.format = format;
-        info.tiling = VK_IMAGE_TILING_OPTIMAL;
-        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        ReadbackResult result{ tiled.OutputPath, tiled.Data.data(), tiled.Width, tiled.Height, tiled.RowPitch, nullptr, tiled.Channels };
+        CompleteImage(result, tiled.StartTime);
+    }
+    frame.Tiled.reset();
+}
+
+void VkNVSharpen::CompleteImage(const ReadbackResult& result, std::chrono::steady_clock::time_point startTime)
+{
+    if (m_YUVOutput && result.Layout == PixelLayout::Packed)
+    {
+        // Tiles and buffer I/O frames come back as packed pixels
+        const uint32_t rowPitch = NV12Pass::GetRowPitch(result.Width);
+        std::vector<uint8_t> yuv(size_t(rowPitch) * GetRowCount(PixelLayout::NV12, result.Height));
+        img::convertToNV12(result.Data, result.RowPitch, result.Channels, result.Width, result.Height, yuv.data(), rowPitch);
+        ReadbackResult converted{ result.OutputPath, yuv.data(), result.Width, result.Height, rowPitch, nullptr, 1, PixelLayout::NV12 };
+        CompleteImage(converted, startTime);
+        return;
+    }
 
-        VK_CHECK_RESULT(vkCreateImage(m_Device->GetDevice(), &info, nullptr, outImage));
+    if (m_CompletionHandler)
+        m_CompletionHandler(result);
+    else
+        SaveImage(result.OutputPath, result.Data, result.Width, result.Height, result.RowPitch, result.Channels, result.Layout);
+
+    double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    m_Latency.Record(latency);
+    if (m_LowLatency)
+        std::cout << "Latency: " << std::fixed << std::setprecision(2) << latency << " ms" << std::endl;
+}
+
+void VkNVSharpen::SaveImage(const std::string& outputPath, const uint8_t* data, uint32_t width, uint32_t height, uint32_t rowPitch,
+                            uint32_t channels, PixelLayout layout)
+{
+    if (layout == PixelLayout::NV12)
+    {
+        img::saveNV12(outputPath, data, width, height, rowPitch);
+        return;
     }
+    img::savePNG(
+            outputPath,
+            const_cast<uint8_t*>(data),
+            width,
+            height,
+            channels,
+            rowPitch,
+            img::Fmt::R8G8B8A8);
+}
+
+void VkNVSharpen::Flush()
+{
+    // Retire in submission order, oldest first
+    for (size_t i = 0; i < m_Frames.size(); ++i)
+        RetireFrame(m_Frames[(m_FrameIndex + i) % m_Frames.size()]);
+}
+
+void VkNVSharpen::PrintStats(std::ostream& os) const
+{
+    os << std::fixed << std::setprecision(1) << "Startup: instance " << m_Startup.Instance << " ms, device " << m_Startup.Device
+       << " ms, pipelines " << m_Startup.Pipelines << " ms ("
+       << (m_Startup.PipelineCacheBytes > 0 ? std::to_string(m_Startup.PipelineCacheBytes >> 10) + " KiB pipeline cache" : std::string("cold"))
+       << "), first dispatch " << m_Startup.FirstDispatch << " ms" << std::endl;
+    m_Latency.Print(os, "Latency");
+
+    const ImageCacheStats& cacheStats = m_ImageCache->GetStats();
+    os << "Image cache: " << cacheStats.Hits << " hits, " << cacheStats.Misses << " misses, "
+       << cacheStats.Evictions << " evictions, peak " << (cacheStats.PeakBytesAllocated >> 20) << " MiB" << std::endl;
+    m_Device->GetAllocator().PrintStats(os);
+    const NISBlockSize& blockSize = m_NVSharpen->GetBlockSize();
+    os << "Shaders: " << (m_Precision == NISPrecision::Half ? "fp16" : "fp32") << ", sharpen blocks " << blockSize.Width << "x"
+       << blockSize.Height << " with " << blockSize.ThreadGroupSize << " threads" << std::endl;
+    if (m_BufferIO)
+        os << "Images: skipped, the shader reads and writes the staging buffers" << std::endl;
+    else if (m_DirectImages && !m_YUVOutput)
+        os << "Staging: skipped, images are mapped in unified memory" << std::endl;
+    os << "Peak resident memory: " << (GetPeakResidentBytes() >> 20) << " MiB" << std::endl;
+}
+
+void VkNVSharpen::Cleanup()
+{
+    m_Device->GetComputeQueue().WaitIdle();
+    m_Device->GetTransferQueue().WaitIdle();
+    for (auto& frame : m_Frames)
+        FreeFrame(frame);
+    m_Frames.clear();
+    vkDestroyQueryPool(m_Device->GetDevice(), m_TimestampPool, nullptr);
+    delete m_ImageCache;
+    delete m_NVSharpen;
+    delete m_NVSharpenBuffer;
+    delete m_NVSharpenNV12;
+    delete m_ChannelPasses;
+    delete m_NV12Pass;
+    delete m_NVScaler;
+    delete m_Device;
+}
+
+void VkNVSharpen::ProcessImage(const std::string& inputImagePath, const std::string& outputDirPath)
+{
+    Submit(LoadImage(inputImagePath, outputDirPath));
+}
+
+void VkNVSharpen::Submit(const HostImage& image)
+{
+    const Region whole{ 0, 0, image.Width, image.Height };
+    if (image.Layout == PixelLayout::NV12 || UsesScaling())
     {
-        VkMemoryRequirements memReq{};
-        vkGetImageMemoryRequirements(m_Device->GetDevice(), *outImage, &memReq);
+        // The chroma copy works on whole planes and tiles would need their halos
+        // scaled, so neither is tiled
+        SubmitRegion(image, whole, nullptr, whole);
+        return;
+    }
 
-        VkMemoryAllocateInfo info{};
-        info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        info.allocationSize = memReq.size;
-        info.memoryTypeIndex = m_Device->FindMemoryType(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        VK_CHECK_RESULT(vkAllocateMemory(m_Device->GetDevice(), &info, nullptr, outDeviceMemory));
-        VK_CHECK_RESULT(vkBindImageMemory(m_Device->GetDevice(), *outImage, *outDeviceMemory, 0));
+    const uint32_t tileSize = GetTileSize();
+    if (image.Width > tileSize || image.Height > tileSize)
+    {
+        SubmitTiled(image, tileSize);
+        return;
     }
-    VkCommandBuffer cmdBuff = m_Device->BeginSingleTimeCommands();
+
+    SubmitRegion(image, whole, nullptr, whole);
+}
+
+void VkNVSharpen::Submit(HostImage&& image)
+{
+    const uint32_t tileSize = GetTileSize();
+    const Region whole{ 0, 0, image.Width, image.Height };
+    const bool packed = image.Layout == PixelLayout::Packed;
+    const bool tiled = packed && !UsesScaling() && (image.Width > tileSize || image.Height > tileSize);
+    if (!image.Staging || (packed && (tiled || UseDirectImages(whole)
+        || (UseBufferIO(whole) && !CanBindStaged(image)))))
     {
-        VkImageMemoryBarrier transferBarrier{};
-        transferBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        transferBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        transferBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        transferBarrier.srcAccessMask = 0;
-        transferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        transferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        transferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        transferBarrier.image = *outImage;
-        transferBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        transferBarrier.subresourceRange.levelCount = 1;
-        transferBarrier.subresourceRange.layerCount = 1;
-        vkCmdPipelineBarrier(cmdBuff, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &transferBarrier);
+        Submit(static_cast<const HostImage&>(image));
+        return;
+    }
+
+    SubmitRegion(image, whole, nullptr, whole, image.Staging.Detach());
+}
 
-        VkBufferImageCopy buffImageCopyRegion{};
-        buffImageCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        buffImageCopyRegion.imageSubresource.layerCount = 1;
-        buffImageCopyRegion.imageExtent = { width, height, 1 };
-        vkCmdCopyBufferToImage(cmdBuff, stagingBuff, *outImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &buffImageCopyRegion);
+uint32_t VkNVSharpen::GetTileSize() const
+{
+    const uint32_t maxDimension = m_Device->PhysicalDeviceProperties.limits.maxImageDimension2D;
+    return m_TileSize == 0 ? maxDimension : std::min(m_TileSize, maxDimension);
+}
 
-        VkImageMemoryBarrier useBarrier{};
-        useBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        useBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        useBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        useBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        useBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        useBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        useBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        useBarrier.image = *outImage;
-        useBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        useBarrier.subresourceRange.levelCount = 1;
-        useBarrier.subresourceRange.layerCount = 1;
-        vkCmdPipelineBarrier(cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &useBarrier);
+void VkNVSharpen::SubmitTiled(const HostImage& image, uint32_t tileSize)
+{
+    // Each tile sharpens its interior plus a halo on every side that is not an image
+    // edge. The halo gives border pixels the same neighbourhood as in the full image,
+    // and at image edges the tile edge is the image edge, so the clamp matches too.
+    if (tileSize <= 2 * TileHalo)
+        throw std::runtime_error("Tile size must be larger than " + std::to_string(2 * TileHalo));
+    const uint32_t step = tileSize - 2 * TileHalo;
+    const uint64_t tilesX = (uint64_t(image.Width) + step - 1) / step;
+    const uint64_t tilesY = (uint64_t(image.Height) + step - 1) / step;
+
+    auto tiled = std::make_shared<TiledOutput>();
+    tiled->OutputPath = image.OutputPath;
+    tiled->Width = image.Width;
+    tiled->Height = image.Height;
+    tiled->Channels = image.Channels;
+    tiled->RowPitch = image.Width * image.Channels;
+    tiled->Data.resize(size_t(tiled->RowPitch) * image.Height);
+    tiled->RemainingTiles = tilesX * tilesY;
+    tiled->StartTime = image.StartTime;
+
+    // 64-bit positions, the last step of a row may pass UINT32_MAX on huge images
+    for (uint64_t y = 0; y < image.Height; y += step)
+    {
+        for (uint64_t x = 0; x < image.Width; x += step)
+        {
+            const uint64_t width = std::min<uint64_t>(step, image.Width - x);
+            const uint64_t height = std::min<uint64_t>(step, image.Height - y);
+
+            Region source;
+            source.X = uint32_t(x - std::min<uint64_t>(x, TileHalo));
+            source.Y = uint32_t(y - std::min<uint64_t>(y, TileHalo));
+            source.Width = uint32_t(std::min<uint64_t>(x + width + TileHalo, image.Width) - source.X);
+            source.Height = uint32_t(std::min<uint64_t>(y + height + TileHalo, image.Height) - source.Y);
+
+            const Region interior{ uint32_t(x - source.X), uint32_t(y - source.Y), uint32_t(width), uint32_t(height) };
+            SubmitRegion(image, source, tiled, interior);
+        }
+    }
+}
+
+void VkNVSharpen::SubmitRegion(const HostImage& image, const Region& region, const std::shared_ptr<TiledOutput>& tiled, const Region& interior, StagingAllocation staged)
+{
+    // Recycling the slot finishes the image submitted framesInFlight images ago,
+    // while the more recent ones keep the GPU busy.
+    // Unscaled packed images are tiled below the limit, NV12 and scaled images are not
+    const bool nv12 = image.Layout == PixelLayout::NV12;
+    const bool scaled = !nv12 && UsesScaling();
+    const VkExtent2D outputSize = scaled ? GetOutputSize(region.Width, region.Height) : VkExtent2D{ region.Width, region.Height };
+    const uint32_t maxDimension = m_Device->PhysicalDeviceProperties.limits.maxImageDimension2D;
+    if (std::max(region.Width, outputSize.width) > maxDimension || std::max(region.Height, outputSize.height) > maxDimension)
+        throw std::runtime_error("Image larger than the device's image limit: " + image.OutputPath);
+    if (scaled && !NVScaler::SupportsScale(region.Width, region.Height, outputSize.width, outputSize.height))
+        throw std::runtime_error("Output size outside the 1x to 2x NVScaler supports: " + image.OutputPath);
+
+    FrameContext& frame = m_Frames[m_FrameIndex];
+    RetireFrame(frame);
+
+    frame.NV12 = nv12;
+    frame.Scaled = scaled;
+    frame.OutputWidth = outputSize.width;
+    frame.OutputHeight = outputSize.height;
+    frame.Direct = !frame.NV12 && UseDirectImages(region) && UseDirectImages({ 0, 0, outputSize.width, outputSize.height });
+    frame.BufferIO = !frame.NV12 && UseBufferIO(region);
+    // Whole images in images convert on the GPU, tiles and buffer I/O on the host
+    frame.YUV = m_YUVOutput && !frame.NV12 && !frame.BufferIO && !tiled;
+    frame.Channels = image.Channels;
+    frame.Compact = !frame.NV12 && image.Channels != 4 && !frame.Direct && !frame.BufferIO;
+    UploadInputImage(frame, image, region, staged);
+    frame.Tiled = tiled;
+    frame.TileInterior = interior;
+    frame.TileOriginX = region.X + interior.X;
+    frame.TileOriginY = region.Y + interior.Y;
+    if (!frame.BufferIO)
+        CreateTextures(frame);
+    if (frame.Direct)
+        WriteInputImage(frame, image, region);
+    else
+        AllocateReadback(frame);
+    UpdateNVSharpen(frame);
+    const auto submitStart = std::chrono::steady_clock::now();
+    RecordFrame(frame);
+    SubmitFrame(frame);
+    if (!m_FirstFrameSubmitted)
+    {
+        // Waited for right away so the startup breakdown sees the driver's deferred
+        // work; only this frame loses its overlap
+        m_FirstFrameSubmitted = true;
+        (UseTransferQueue(frame) ? frame.SharpenTicket : frame.Ticket).Wait();
+        m_Startup.FirstDispatch = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
     }
-    m_Device->EndSingleTimeCommand(cmdBuff);
 
-    vkFreeMemory(m_Device->GetDevice(), stagingBuffMem, nullptr);
-    vkDestroyBuffer(m_Device->GetDevice(), stagingBuff, nullptr);
-}
-
-void VkNVSharpen::CreateTexture2D(int w, int h, VkFormat format, VkImage* outImage, VkDeviceMemory* outDeviceMemory)
-{
-    auto width = static_cast<uint32_t>(w);
-    auto height = static_cast<uint32_t>(h);
-
-    // Create texture image object and backing memory
-    {
-        VkImageCreateInfo info{};
-        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-        info.imageType = VK_IMAGE_TYPE_2D;
-        info.extent.width = width;
-        info.extent.height = height;
-        info.extent.depth = 1;
-        info.mipLevels = 1;
-        info.arrayLayers = 1;
-        info.format = format;
-        info.tiling = VK_IMAGE_TILING_OPTIMAL;
-        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
-        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        info.samples = VK_SAMPLE_COUNT_1_BIT;
-
-        VK_CHECK_RESULT(vkCreateImage(m_Device->GetDevice(), &info, nullptr, outImage));
-    }
-    {
-        VkMemoryRequirements memReq{};
-        vkGetImageMemoryRequirements(m_Device->GetDevice(), *outImage, &memReq);
-
-        VkMemoryAllocateInfo info{};
-        info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        info.allocationSize = memReq.size;
-        info.memoryTypeIndex = m_Device->FindMemoryType(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        VK_CHECK_RESULT(vkAllocateMemory(m_Device->GetDevice(), &info, nullptr, outDeviceMemory));
-        VK_CHECK_RESULT(vkBindImageMemory(m_Device->GetDevice(), *outImage, *outDeviceMemory, 0));
-    }
-}
-
-void VkNVSharpen::CreateSRV(VkImage inputImage, VkFormat format, VkImageView* outSrv)
-{
-    VkImageViewCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    info.image = inputImage;
-    info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    info.format = format;
-    info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    info.subresourceRange.layerCount = 1;
-    info.subresourceRange.levelCount = 1;
-    VK_CHECK_RESULT(vkCreateImageView(m_Device->GetDevice(), &info, nullptr, outSrv));
+    // One wait per image, nothing is left in flight
+    if (m_LowLatency)
+        RetireFrame(frame);
+
+    m_FrameIndex = (m_FrameIndex + 1) % static_cast<uint32_t>(m_Frames.size());
 }
 
 void VkNVSharpen::TransitionImageLayout(
@@ -449,7 +1172,7 @@ void VkNVSharpen::TransitionImageLayout(
             {{VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL},
                     {0, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT}},
             {{VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
-                    {VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT}},
+                    {VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT}},
             {{VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
                     {VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT}},
             {{VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL},
@@ -481,13 +1204,60 @@ void VkNVSharpen::TransitionImageLayout(
     );
 }
 
-void VkNVSharpen::FreeImageResources()
+void VkNVSharpen::ImageBarrier(
+        VkCommandBuffer commandBuffer,
+        VkImage image,
+        VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+        VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
 {
-    vkDestroyImageView(m_Device->GetDevice(), m_InputImageView, nullptr);
-    vkDestroyImage(m_Device->GetDevice(), m_InputImage, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), m_InputImageMemory, nullptr);
+    QueueOwnershipBarrier(commandBuffer, image, oldLayout, newLayout, srcAccessMask, dstAccessMask, srcStage, dstStage,
+                          VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+}
+
+void VkNVSharpen::QueueOwnershipBarrier(
+        VkCommandBuffer commandBuffer,
+        VkImage image,
+        VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+        VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+        uint32_t srcQueueFamily, uint32_t dstQueueFamily)
+{
+    // Recorded once on each queue with identical layouts and families: the release
+    // leaves dstAccessMask empty, the acquire leaves srcAccessMask empty
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccessMask;
+    barrier.dstAccessMask = dstAccessMask;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = srcQueueFamily;
+    barrier.dstQueueFamilyIndex = dstQueueFamily;
+    barrier.image = image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
 
-    vkDestroyImageView(m_Device->GetDevice(), m_OutputImageView, nullptr);
-    vkDestroyImage(m_Device->GetDevice(), m_OutputImage, nullptr);
-    vkFreeMemory(m_Device->GetDevice(), m_OutputImageMemory, nullptr);
+void VkNVSharpen::FreeImageResources(FrameContext& frame)
+{
+    m_ImageCache->Release(frame.InputImage);
+    m_ImageCache->Release(frame.OutputImage);
+    frame.Imported.reset();
+}
+
+void VkNVSharpen::FreeFrame(FrameContext& frame)
+{
+    FreeImageResources(frame);
+
+    // Staging regions go back to the device's rings, which free their memory themselves
+    m_Device->GetUploadRing().Release(frame.Upload);
+    m_Device->GetReadbackRing().Release(frame.Readback);
+
+    vkFreeCommandBuffers(m_Device->GetDevice(), m_Device->GetComputeCommandPool(), 1, &frame.CommandBuffer);
+    if (frame.UploadCommandBuffer != VK_NULL_HANDLE)
+    {
+        VkCommandBuffer transferCommandBuffers[] = { frame.UploadCommandBuffer, frame.ReadbackCommandBuffer };
+        vkFreeCommandBuffers(m_Device->GetDevice(), m_Device->GetTransferCommandPool(), 2, transferCommandBuffers);
+    }
 }
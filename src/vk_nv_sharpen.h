@@ -1,57 +1,389 @@
 #pragma once
 
 #include <string>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ostream>
 #include "vulkan/vulkan_device.h"
+#include "vulkan/vulkan_staging_ring.h"
+#include "vulkan/vulkan_host_import.h"
+#include "vulkan/vulkan_image_cache.h"
 #include "nv/NVSharpen.h"
+#include "nv/NVScaler.h"
+#include "passes/channel_passes.h"
+#include "passes/nv12_pass.h"
+#include "pipeline/latency_stats.h"
+
+// How the pixels of an image are laid out in memory. Packed pixels have Channels 8-bit
+// channels each. NV12 is Height rows of luma followed by (Height + 1) / 2 rows of
+// interleaved U and V, all RowPitch bytes apart; Channels is 1.
+enum class PixelLayout
+{
+    Packed,
+    NV12
+};
+
+// Rows of memory an image of the given height takes up
+inline uint32_t GetRowCount(PixelLayout layout, uint32_t height)
+{
+    return layout == PixelLayout::NV12 ? height + (height + 1) / 2 : height;
+}
+
+// Decoded input image held in host memory, together with the path its sharpened
+// result is written to.
+struct HostImage
+{
+    std::string OutputPath;
+    // Pixels live in Data, in Staging when they were decoded straight into upload
+    // memory, or in Imported when the device reads host memory in place. Submitting a
+    // staged image as an rvalue hands the region to the GPU copy; an imported buffer
+    // stays alive for as long as any frame copies from it.
+    std::vector<uint8_t> Data;
+    StagingHandle Staging;
+    HostImportHandle Imported;
+    uint32_t Width{}, Height{};
+    uint32_t RowPitch{};
+    // 8-bit channels per pixel: 1 for grayscale, 3 for opaque color, 4 with alpha
+    uint32_t Channels = 4;
+    PixelLayout Layout = PixelLayout::Packed;
+    // When decoding started, the reference point for end-to-end latency
+    std::chrono::steady_clock::time_point StartTime{};
+
+    [[nodiscard]] const uint8_t* GetPixels() const
+    {
+        if (Staging)
+            return static_cast<const uint8_t*>(Staging.Get().Mapped);
+        return Imported ? Imported->Data : Data.data();
+    }
+    [[nodiscard]] bool IsEmpty() const { return !Staging && !Imported && Data.empty(); }
+};
+
+// Sharpened pixels of a retired frame. Data points into staging memory that is
+// recycled as soon as the completion handler returns, unless the handler moves
+// Staging out: Data then stays valid until that handle is destroyed, which lets an
+// encoder on another thread read it without a copy. Staging is null when Data is
+// not a readback region of its own (tiled and atlas images). Pixels have as many
+// channels and the same layout as the input image had.
+struct ReadbackResult
+{
+    const std::string& OutputPath;
+    const uint8_t* Data;
+    uint32_t Width, Height;
+    uint32_t RowPitch;
+    StagingHandle* Staging = nullptr;
+    uint32_t Channels = 4;
+    PixelLayout Layout = PixelLayout::Packed;
+};
+
+// Where the time before the first sharpened image went, in milliseconds
+struct StartupTimes
+{
+    double Instance = 0.0;
+    double Device = 0.0;
+    // Shader modules and the pipelines created at construction, compiled together
+    double Pipelines = 0.0;
+    // Submission to completion of the first frame
+    double FirstDispatch = 0.0;
+    // Pipeline cache data read from disk, 0 on a cold start
+    size_t PipelineCacheBytes = 0;
+};
 
 class VkNVSharpen
 {
 public:
-    VkNVSharpen();
+    static constexpr uint32_t DefaultFramesInFlight = 3;
+    static constexpr VkDeviceSize DefaultImageCacheBudget = 512ull * 1024 * 1024;
+    static constexpr uint32_t DefaultTileSize = 4096;
+    // Overlap between neighbouring tiles. NVSharpen reads a 5x5 neighbourhood, so 2
+    // pixels would do; the rest keeps clear of the edge of its shared memory tile.
+    static constexpr uint32_t TileHalo = 4;
+    using CompletionHandler = std::function<void(const ReadbackResult&)>;
+
+    // Compiled pipelines are kept in a file per device in pipelineCacheDirectory, so later
+    // processes skip the compile; without a directory they are kept in memory. Shaders are
+    // built into the executable, a .spv file of the same name in shaderDirectory replaces one.
+    explicit VkNVSharpen(uint32_t framesInFlight = DefaultFramesInFlight, VkDeviceSize imageCacheBudget = DefaultImageCacheBudget,
+                         const std::optional<std::string>& pipelineCacheDirectory = std::nullopt,
+                         const std::string& shaderDirectory = {});
     ~VkNVSharpen();
+
+    // Loads, uploads and submits the image, then returns without waiting for the GPU.
+    // The result is written once its frame slot is recycled or on Flush().
     void ProcessImage(const std::string& inputImagePath, const std::string& outputDirectoryPath);
+    // Waits for every frame still in flight and writes their outputs.
+    void Flush();
     void SetSharpness(float sharpness) { m_CurrentSharpness = sharpness;}
+    // Records each image as a single command buffer on the compute queue and waits for
+    // it before returning, trading throughput for the shortest time to a written file.
+    // Each image's end-to-end latency is printed.
+    void SetLowLatency(bool lowLatency) { m_LowLatency = lowLatency; }
+    // Images wider or taller than this are sharpened as overlapping tiles of at most
+    // tileSize x tileSize and stitched on the host, which bounds the device memory of
+    // one image. 0 only tiles images beyond maxImageDimension2D.
+    void SetTileSize(uint32_t tileSize) { m_TileSize = tileSize; }
+    // On unified memory devices images are linear and mapped, the host writes the input
+    // and reads the output in place and no staging copies are recorded. On by default
+    // where the device supports it; has no effect elsewhere.
+    void SetDirectImages(bool enable) { m_DirectImages = enable && m_DirectImagesSupported; }
+    [[nodiscard]] bool UsesDirectImages() const { return m_DirectImages; }
+    // Decode into host memory imported with VK_EXT_external_memory_host instead of the
+    // upload ring, so the GPU copies from the decoder's output. Falls back to staging
+    // where the extension is missing.
+    void SetHostImport(bool enable) { m_HostImport = enable && m_Device->SupportsHostImport(); }
+    [[nodiscard]] bool UsesHostImport() const { return m_HostImport; }
+    // Sharpen with the storage buffer variant of the shader: it reads the input straight
+    // from the upload ring and writes the output straight into the readback ring, so no
+    // images exist and no copies are recorded. Takes precedence over direct images and
+    // host import. Regions beyond maxStorageBufferRange still go through images.
+    void SetBufferIO(bool enable);
+    [[nodiscard]] bool UsesBufferIO() const { return m_BufferIO; }
+    // Loads .nv12 files as raw NV12 frames of this size. Only the luma plane is
+    // sharpened, chroma is copied through on the GPU and the output is a .nv12 file
+    // again. NV12 frames are always staged and never tiled. Throws when the device can
+    // not sample and store R8 images.
+    void SetNV12FrameSize(uint32_t width, uint32_t height);
+    // Writes sharpened images as raw NV12 .yuv files. Whole images are converted by a
+    // compute pass after the sharpen and only the YUV bytes are read back; tiles and
+    // buffer I/O frames read back RGBA and convert on the host. Turns direct images off.
+    void SetYUVOutput(bool enable);
+    [[nodiscard]] bool UsesYUVOutput() const { return m_YUVOutput; }
+    // Upscale while sharpening: NVScaler writes an output scale times the input size,
+    // or exactly width x height, in the same pass. Both axes must scale by 1x to 2x.
+    // Scaled images are never tiled or sharpened from buffers; NV12 frames are not
+    // scaled. A scale of 1 and a size of 0 x 0 turn scaling off.
+    void SetOutputScale(float scale);
+    void SetOutputSize(uint32_t width, uint32_t height);
+    [[nodiscard]] bool UsesScaling() const { return m_OutputScale != 1.0f || m_OutputSize.width != 0; }
+    // fp16 or fp32 builds of the NIS shaders, fp16 by default where the device supports
+    // it. Throws when fp16 is asked for on a device without it. Retires every frame in
+    // flight and rebuilds the pipelines that exist.
+    void SetPrecision(NISPrecision precision);
+    [[nodiscard]] NISPrecision GetPrecision() const { return m_Precision; }
+    [[nodiscard]] bool SupportsHalfPrecision() const { return m_Device->SupportsFloat16(); }
+    // Block and thread group size of the sharpen-only pipelines, NISOptimizer's sizes by
+    // default; an unset size goes back to those. Rebuilds the pipelines like
+    // SetPrecision. Throws when the size can't run, keeping the current pipelines.
+    void SetBlockSize(const NISBlockSize& blockSize);
+    [[nodiscard]] const NISBlockSize& GetBlockSize() const { return m_NVSharpen->GetBlockSize(); }
+    // Brackets every NIS dispatch with timestamp queries and adds its duration to
+    // GetGPUTime() when the frame retires, so Flush() before reading it. Throws when the
+    // compute queue has no timestamps.
+    void SetGPUTiming(bool enable);
+    // Milliseconds of NIS dispatches retired since the last ResetGPUTime()
+    [[nodiscard]] double GetGPUTime() const { return m_GPUTime; }
+    void ResetGPUTime() { m_GPUTime = 0.0; }
+    [[nodiscard]] const VkPhysicalDeviceProperties& GetDeviceProperties() const { return m_Device->PhysicalDeviceProperties; }
+
+    // Stage entry points for callers that decode and encode on other threads.
+    // LoadImage and SaveImage are thread safe; Submit and Flush must stay on one thread.
+    // By default pixels are decoded straight into upload staging memory. Callers that
+    // read the pixels back on the host (atlas packing) should pass intoStaging = false,
+    // staging memory is uncached on many devices. Grayscale and opaque images keep 1
+    // or 3 channels up to the GPU, which expands them to RGBA and packs the result back.
+    [[nodiscard]] HostImage LoadImage(const std::string& inputImagePath, const std::string& outputDirectoryPath, bool intoStaging = true) const;
+    [[nodiscard]] std::string GetOutputPath(const std::string& inputImagePath, const std::string& outputDirectoryPath) const;
+    void Submit(const HostImage& image);
+    void Submit(HostImage&& image);
+    static void SaveImage(const std::string& outputPath, const uint8_t* data, uint32_t width, uint32_t height, uint32_t rowPitch,
+                          uint32_t channels = 4, PixelLayout layout = PixelLayout::Packed);
+    // Replaces the default PNG write of retired frames. Runs on the submitting thread.
+    void SetCompletionHandler(CompletionHandler handler) { m_CompletionHandler = std::move(handler); }
+
+    [[nodiscard]] const ImageCacheStats& GetImageCacheStats() const { return m_ImageCache->GetStats(); }
+    // Filled in once the first frame completed
+    [[nodiscard]] const StartupTimes& GetStartupTimes() const { return m_Startup; }
+    // Startup breakdown, latency summary, image cache counters, per-heap device memory
+    // usage and peak host memory
+    void PrintStats(std::ostream& os) const;
 
 private:
-    void Initialize();
-    void LoadInputImage();
-    void CreateTextures();
-    void CreateCommandBufferAndFence();
-    void UpdateNVSharpen();
-    void DispatchComputeShader();
-    void SubmitAndWait();
-    void SaveOutputImage();
-    void Cleanup();
+    struct Region
+    {
+        uint32_t X{}, Y{};
+        uint32_t Width{}, Height{};
+    };
 
+    // Host side output of a tiled image, complete once every tile has been stored
+    struct TiledOutput
+    {
+        std::string OutputPath;
+        std::vector<uint8_t> Data;
+        uint32_t Width{}, Height{};
+        uint32_t RowPitch{};
+        uint32_t Channels = 4;
+        uint64_t RemainingTiles{};
+        std::chrono::steady_clock::time_point StartTime{};
+    };
 
-    void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags buffUsage, VkMemoryPropertyFlags memProps, VkBuffer* outBuffer, VkDeviceMemory* outBuffMem);
-    void CreateTexture2D(int w, int h, VkFormat format, VkImage* outImage, VkDeviceMemory* outDeviceMemory);
-    void CreateTexture2D(int w, int h, VkFormat format, const void* data, uint32_t rowPitch, uint32_t imageSize, VkImage* outImage, VkDeviceMemory* outDeviceMemory);
-    void CreateSRV(VkImage inputImage, VkFormat format, VkImageView* outSrv);
+    // Everything one image needs while it travels through the GPU. A ring of these
+    // lets image k+1 be recorded and submitted while image k is still executing.
+    struct FrameContext
+    {
+        uint32_t Index{};
+        bool InFlight = false;
+
+        // With a dedicated transfer queue the copies get their own command buffers,
+        // otherwise CommandBuffer holds the whole frame
+        VkCommandBuffer CommandBuffer{};
+        VkCommandBuffer UploadCommandBuffer{};
+        VkCommandBuffer ReadbackCommandBuffer{};
+        // Completion of the frame's last submission; the command buffers and staging
+        // regions are reused only after it
+        QueueTicket Ticket;
+        QueueTicket SharpenTicket;
+
+        StagingAllocation Upload;
+        StagingAllocation Readback;
+        // Upload source instead of Upload when the input was decoded into imported memory
+        HostImportHandle Imported;
+
+        CachedImage InputImage;
+        CachedImage OutputImage;
+        // Input and output are host mapped, Upload and Readback stay empty
+        bool Direct = false;
+        // The shader binds Upload and Readback as storage buffers, there are no images
+        bool BufferIO = false;
+        // Channels of the source image. Compact frames stage that many and convert on
+        // the GPU, direct and buffer I/O frames stage RGBA and convert on the host.
+        uint32_t Channels = 4;
+        bool Compact = false;
+        // Luma plane of an NV12 frame in R8 images; the chroma plane is copied from
+        // Upload to Readback behind the luma rows
+        bool NV12 = false;
+        // The output image is converted to NV12 into Readback by m_NV12Pass, there is
+        // no readback copy
+        bool YUV = false;
+        // Sharpened by m_NVScaler into a larger output image
+        bool Scaled = false;
+        // The NIS dispatch wrote timestamps 2 * Index and 2 * Index + 1
+        bool Timed = false;
+
+        [[nodiscard]] uint32_t GetStagingChannels() const { return Compact || NV12 ? Channels : 4; }
+
+        uint32_t InputWidth{}, InputHeight{};
+        uint32_t InputRowPitch{};
+        uint32_t OutputWidth{}, OutputHeight{};
+        uint32_t OutputRowPitch{};
+        std::string OutputPath;
+        std::chrono::steady_clock::time_point StartTime{};
+
+        // Set when the frame holds one tile of a larger image. TileInterior is the part
+        // of the output written back, in tile coordinates; TileOrigin is where it goes.
+        std::shared_ptr<TiledOutput> Tiled;
+        Region TileInterior;
+        uint32_t TileOriginX{}, TileOriginY{};
+    };
+
+    void Initialize(uint32_t framesInFlight, VkDeviceSize imageCacheBudget, const std::optional<std::string>& pipelineCacheDirectory,
+                    const std::string& shaderDirectory);
+    void QueryDirectImageSupport();
+    [[nodiscard]] bool UseDirectImages(const Region& region) const;
+    [[nodiscard]] bool UseBufferIO(const Region& region) const;
+    [[nodiscard]] VkExtent2D GetOutputSize(uint32_t inputWidth, uint32_t inputHeight) const;
+    void CreateScaler();
+    // Flushes, then replaces every NIS pipeline that exists
+    void RecreateNISPipelines(NISPrecision precision, const NISBlockSize& blockSize);
+    void BeginTimestamp(VkCommandBuffer cmd, FrameContext& frame);
+    void EndTimestamp(VkCommandBuffer cmd, const FrameContext& frame);
+    // Staging layout a frame needs. Shaders that bind regions as storage buffers index
+    // packed rows at the region's offset, copies take the device's preferred layout.
+    [[nodiscard]] uint32_t GetStagingRowPitch(const VulkanStagingRing& ring, uint32_t width, uint32_t channels, bool bufferIO) const;
+    [[nodiscard]] VkDeviceSize GetStagingAlignment(bool storage) const;
+    [[nodiscard]] bool CanBindStaged(const HostImage& image) const;
+    [[nodiscard]] static bool IsNV12File(const std::string& path);
+    void WriteInputImage(FrameContext& frame, const HostImage& image, const Region& region);
+    [[nodiscard]] const uint8_t* MapOutput(FrameContext& frame);
+    void UploadInputImage(FrameContext& frame, const HostImage& image, const Region& region, StagingAllocation staged);
+    void CreateTextures(FrameContext& frame);
+    void CreateFrames(uint32_t count);
+    void UpdateNVSharpen(FrameContext& frame);
+    void RecordFrame(FrameContext& frame);
+    void RecordUpload(VkCommandBuffer cmd, FrameContext& frame);
+    void RecordSharpen(VkCommandBuffer cmd, FrameContext& frame);
+    void RecordReadback(VkCommandBuffer cmd, FrameContext& frame);
+    void SubmitRegion(const HostImage& image, const Region& region, const std::shared_ptr<TiledOutput>& tiled, const Region& interior, StagingAllocation staged = {});
+    void SubmitTiled(const HostImage& image, uint32_t tileSize);
+    [[nodiscard]] uint32_t GetTileSize() const;
+    void SubmitFrame(FrameContext& frame);
+    void SubmitReadback(FrameContext& frame);
+    // Direct images and buffer I/O have nothing to copy, compact and YUV frames convert
+    // in compute passes; all of them stay on the compute queue
+    [[nodiscard]] bool UseTransferQueue(const FrameContext& frame) const
+    {
+        return m_Device->HasDedicatedTransferQueue() && !m_LowLatency && !frame.Direct && !frame.BufferIO && !frame.Compact && !frame.YUV;
+    }
+    void RetireFrame(FrameContext& frame);
+    void SaveOutputImage(FrameContext& frame);
+    void StoreTile(FrameContext& frame);
+    void CompleteImage(const ReadbackResult& result, std::chrono::steady_clock::time_point startTime);
+    void Cleanup();
+
+    void AllocateReadback(FrameContext& frame);
     void TransitionImageLayout(
             VkCommandBuffer commandBuffer,
             VkImage image,
             VkImageLayout oldLayout, VkImageLayout newLayout);
+    // Explicit masks for transitions the table in TransitionImageLayout does not cover
+    void ImageBarrier(
+            VkCommandBuffer commandBuffer,
+            VkImage image,
+            VkImageLayout oldLayout, VkImageLayout newLayout,
+            VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+            VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage);
+    void QueueOwnershipBarrier(
+            VkCommandBuffer commandBuffer,
+            VkImage image,
+            VkImageLayout oldLayout, VkImageLayout newLayout,
+            VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+            VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+            uint32_t srcQueueFamily, uint32_t dstQueueFamily);
+    void FreeImageResources(FrameContext& frame);
+    void FreeFrame(FrameContext& frame);
+
 private:
-    std::string m_CurrentFilePath;
-    std::string m_CurrentInputImageName;
-    std::string m_OutputDirectory;
     VulkanDevice* m_Device{};
     NVSharpen* m_NVSharpen{};
-    std::vector<uint8_t> m_CurrentImageData;
-    uint32_t m_CurrentImageWidth{}, m_CurrentImageHeight{};
-    uint32_t m_CurrentImageRowPitchAlignment{};
-    uint32_t m_CurrentImageOutputWidth{}, m_CurrentImageOutputHeight{};
-    VkCommandBuffer m_ComputeCommandBuffer{};
-    VkFence m_ComputeFence{};
+    // Storage buffer variant, created by the first SetBufferIO(true)
+    NVSharpen* m_NVSharpenBuffer{};
+    ChannelPasses* m_ChannelPasses{};
+    // Luma-only NV12 variant, created by SetNV12FrameSize
+    NVSharpen* m_NVSharpenNV12{};
+    // RGBA to NV12 conversion, created by the first SetYUVOutput(true)
+    NV12Pass* m_NV12Pass{};
+    // Upscaling variant, created by SetOutputScale or SetOutputSize
+    NVScaler* m_NVScaler{};
+    VulkanImageCache* m_ImageCache{};
     float m_CurrentSharpness = 100.0f;
+    bool m_LowLatency = false;
+    uint32_t m_TileSize = DefaultTileSize;
+    bool m_DirectImagesSupported = false;
+    bool m_DirectImages = false;
+    bool m_HostImport = false;
+    bool m_BufferIO = false;
+    bool m_YUVOutput = false;
+    float m_OutputScale = 1.0f;
+    NISPrecision m_Precision = NISPrecision::Full;
+    // Sharpen block size asked for by SetBlockSize, unset for NISOptimizer's
+    NISBlockSize m_BlockSize;
+    // Created by the first SetGPUTiming(true), two queries per frame
+    VkQueryPool m_TimestampPool{};
+    bool m_GPUTiming = false;
+    // Nanoseconds per tick and the bits of a timestamp that count
+    double m_TimestampPeriod = 1.0;
+    uint64_t m_TimestampMask = ~0ull;
+    double m_GPUTime = 0.0;
+    VkExtent2D m_OutputSize{};
+    VkExtent2D m_DirectImageMaxExtent{};
+    VkExtent2D m_NV12FrameSize{};
+    LatencyStats m_Latency;
+    StartupTimes m_Startup;
+    bool m_FirstFrameSubmitted = false;
+    CompletionHandler m_CompletionHandler;
 
-    VkImage m_InputImage{};
-    VkDeviceMemory m_InputImageMemory{};
-    VkImageView m_InputImageView{};
-    VkImage m_OutputImage{};
-    VkDeviceMemory m_OutputImageMemory{};
-    VkImageView m_OutputImageView{};
-
-    void FreeImageResources();
-};
\ No newline at end of file
+    std::vector<FrameContext> m_Frames;
+    uint32_t m_FrameIndex = 0;
+    // Frame whose readback is recorded but not yet submitted to the transfer queue
+    FrameContext* m_PendingReadback{};
+};
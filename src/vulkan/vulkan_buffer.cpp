@@ -34,37 +34,40 @@ VulkanBuffer::VulkanBuffer(
 VulkanBuffer::~VulkanBuffer()
 {
     Unmap();
-    vkDestroyBuffer(m_VulkanDevice.GetDevice(), m_Buffer, nullptr);
-    vkFreeMemory(m_VulkanDevice.GetDevice(), m_Memory, nullptr);
+    m_VulkanDevice.DestroyBuffer(m_Buffer, m_Memory);
 }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+ * Host visible memory stays mapped by the allocator, so this only checks the range and hands out
+ * the pointer.
  *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
  * @param offset (Optional) Byte offset from beginning
  *
- * @return VkResult of the buffer mapping call
+ * @return VkResult of the buffer mapping call, VK_ERROR_MEMORY_MAP_FAILED for memory the host can't
+ * map or a range outside the buffer
  */
 VkResult VulkanBuffer::Map(VkDeviceSize size, VkDeviceSize offset)
 {
-    assert(m_Buffer && m_Memory && "Called map on buffer before create");
-    return vkMapMemory(m_VulkanDevice.GetDevice(), m_Memory, offset, size, 0, &m_Mapped);
+    assert(m_Buffer && m_Memory.IsValid() && "Called map on buffer before create");
+    if (!m_Memory.Mapped)
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    if (offset > m_BufferSize || (size != VK_WHOLE_SIZE && size > m_BufferSize - offset))
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    m_Mapped = static_cast<char*>(m_Memory.Mapped) + offset;
+    return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note Does not return a result as the allocator keeps the memory mapped
  */
 void VulkanBuffer::Unmap()
 {
-    if (m_Mapped)
-    {
-        vkUnmapMemory(m_VulkanDevice.GetDevice(), m_Memory);
-        m_Mapped = nullptr;
-    }
+    m_Mapped = nullptr;
 }
 
 /**
@@ -105,12 +108,7 @@ void VulkanBuffer::WriteToBuffer(const void* data, VkDeviceSize size, VkDeviceSi
  */
 VkResult VulkanBuffer::Flush(VkDeviceSize size, VkDeviceSize offset) const
 {
-    VkMappedMemoryRange mappedRange = {};
-    mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    mappedRange.memory = m_Memory;
-    mappedRange.offset = offset;
-    mappedRange.size = size;
-    return vkFlushMappedMemoryRanges(m_VulkanDevice.GetDevice(), 1, &mappedRange);
+    return m_VulkanDevice.GetAllocator().Flush(m_Memory, offset, size);
 }
 
 /**
@@ -126,12 +124,7 @@ VkResult VulkanBuffer::Flush(VkDeviceSize size, VkDeviceSize offset) const
  */
 VkResult VulkanBuffer::Invalidate(VkDeviceSize size, VkDeviceSize offset)
 {
-    VkMappedMemoryRange mappedRange = {};
-    mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    mappedRange.memory = m_Memory;
-    mappedRange.offset = offset;
-    mappedRange.size = size;
-    return vkInvalidateMappedMemoryRanges(m_VulkanDevice.GetDevice(), 1, &mappedRange);
+    return m_VulkanDevice.GetAllocator().Invalidate(m_Memory, offset, size);
 }
 
 /**
@@ -1,7 +1,15 @@
 #include "vulkan_device.h"
 #include "vulkan_utils.h"
+#include "vulkan_staging_ring.h"
+#include "vulkan_host_import.h"
+#include "vulkan_pipeline_cache.h"
+#include "vulkan_shaders.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -106,13 +114,22 @@ void VulkanDevice::SetupDebugMessenger()
     }
 }
 
-VulkanDevice::VulkanDevice()
+VulkanDevice::VulkanDevice(const std::optional<std::string>& pipelineCacheDirectory, const std::string& shaderDirectory)
+    : m_ShaderDirectory(shaderDirectory)
 {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    const auto start = std::chrono::steady_clock::now();
     CreateInstance();
     SetupDebugMessenger();
+    const auto instanceCreated = std::chrono::steady_clock::now();
+    m_InstanceCreationTime = Milliseconds(instanceCreated - start).count();
+
     SelectPhysicalDevice();
     CreateLogicalDevice();
+    m_PipelineCache = std::make_unique<VulkanPipelineCache>(m_LogicalDevice, PhysicalDeviceProperties, pipelineCacheDirectory);
     CreateComputeCommandPool();
+    CreateTransferCommandPool();
+    m_Allocator = std::make_unique<VulkanMemoryAllocator>(m_PhysicalDevice, m_LogicalDevice);
     {
         const uint32_t POOL_COUNT = 1000;
 
@@ -139,11 +156,32 @@ VulkanDevice::VulkanDevice()
         pool_info.pPoolSizes = pool_sizes;
         VK_CHECK_RESULT(vkCreateDescriptorPool(m_LogicalDevice, &pool_info, nullptr, &m_DescriptorPool));
     }
+
+    // Enough for a few 4K RGBA8 images per block; the rings add blocks on demand.
+    // Shaders may also bind ring regions as storage buffers.
+    const VkDeviceSize STAGING_BLOCK_SIZE = 64ull * 1024 * 1024;
+    m_UploadRing = std::make_unique<VulkanStagingRing>(*this, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryUsage::Upload, STAGING_BLOCK_SIZE);
+    m_ReadbackRing = std::make_unique<VulkanStagingRing>(*this, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryUsage::Readback, STAGING_BLOCK_SIZE);
+
+    // Idle imported buffers kept for the next decode, a few 4K images' worth
+    const VkDeviceSize HOST_IMPORT_IDLE_BUDGET = 256ull * 1024 * 1024;
+    m_HostImportPool = std::make_unique<VulkanHostImportPool>(*this, HOST_IMPORT_IDLE_BUDGET);
+    m_DeviceCreationTime = Milliseconds(std::chrono::steady_clock::now() - instanceCreated).count();
 }
 
 VulkanDevice::~VulkanDevice()
 {
+    m_Transfer.reset();
+    m_Compute.reset();
+    m_UploadRing.reset();
+    m_ReadbackRing.reset();
+    m_HostImportPool.reset();
+    m_Allocator.reset();
+    m_PipelineCache.reset();
+
     vkDestroyCommandPool(m_LogicalDevice, m_ComputeCommandPool, nullptr);
+    if (m_TransferCommandPool != VK_NULL_HANDLE)
+        vkDestroyCommandPool(m_LogicalDevice, m_TransferCommandPool, nullptr);
     vkDestroyDescriptorPool(m_LogicalDevice, m_DescriptorPool, nullptr);
     vkDestroyDevice(m_LogicalDevice, nullptr);
 
@@ -153,6 +191,51 @@ VulkanDevice::~VulkanDevice()
     vkDestroyInstance(m_Instance, nullptr);
 }
 
+VkShaderModule VulkanDevice::CreateShaderModule(const std::string& name)
+{
+    // The override directory is only looked at when one was given, the embedded shaders
+    // need no file system access
+    std::vector<uint32_t> overrideCode;
+    if (!m_ShaderDirectory.empty())
+    {
+        const std::filesystem::path path = std::filesystem::path(m_ShaderDirectory) / name;
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (file.is_open())
+        {
+            const auto sizeBytes = static_cast<size_t>(file.tellg());
+            if (sizeBytes == 0 || sizeBytes % sizeof(uint32_t) != 0)
+                throw std::runtime_error("Shader file is not SPIR-V " + path.string());
+            overrideCode.resize(sizeBytes / sizeof(uint32_t));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(overrideCode.data()), std::streamsize(sizeBytes));
+            if (!file)
+                throw std::runtime_error("Failed to read shader file " + path.string());
+            std::cout << "Shader " << name << " overridden by " << path.string() << std::endl;
+        }
+    }
+
+    VkShaderModuleCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    if (!overrideCode.empty())
+    {
+        info.codeSize = overrideCode.size() * sizeof(uint32_t);
+        info.pCode = overrideCode.data();
+    }
+    else
+    {
+        const EmbeddedShader* shader = std::find_if(EmbeddedShaders, EmbeddedShaders + EmbeddedShaderCount,
+                                                    [&](const EmbeddedShader& e) { return name == e.Name; });
+        if (shader == EmbeddedShaders + EmbeddedShaderCount)
+            throw std::runtime_error("Shader not built into the executable " + name);
+        info.codeSize = shader->WordCount * sizeof(uint32_t);
+        info.pCode = shader->Code;
+    }
+
+    VkShaderModule module;
+    VK_CHECK_RESULT(vkCreateShaderModule(m_LogicalDevice, &info, nullptr, &module));
+    return module;
+}
+
 void VulkanDevice::CreateInstance()
 {
     if (m_EnableValidationLayers && !CheckValidationLayerSupport())
@@ -166,7 +249,7 @@ void VulkanDevice::CreateInstance()
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_2;
 
     VkInstanceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -291,6 +374,17 @@ bool VulkanDevice::CheckDeviceExtensionSupport(VkPhysicalDevice device)
     return requiredExtensions.empty();
 }
 
+bool VulkanDevice::HasDeviceExtension(VkPhysicalDevice device, const char* name)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    return std::any_of(availableExtensions.begin(), availableExtensions.end(),
+                       [&](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, name) == 0; });
+}
+
 void VulkanDevice::CreateLogicalDevice()
 {
     auto computeIndex = FindComputeQueueFamily(m_PhysicalDevice);
@@ -304,8 +398,42 @@ void VulkanDevice::CreateLogicalDevice()
     queueCreateInfo.pQueuePriorities = &queuePriority;
     queueCreateInfos.push_back(queueCreateInfo);
 
-    VkPhysicalDeviceFeatures deviceFeatures = {};
-    deviceFeatures.samplerAnisotropy = VK_TRUE;
+    // Copies go to a transfer-only family when the device has one, so they overlap with
+    // the dispatches on the compute queue
+    m_TransferFamily = FindTransferQueueFamily(m_PhysicalDevice);
+    if (m_TransferFamily.has_value())
+    {
+        queueCreateInfo.queueFamilyIndex = m_TransferFamily.value();
+        queueCreateInfos.push_back(queueCreateInfo);
+    }
+
+    // The fp16 NIS variants need 16-bit arithmetic and 16-bit storage; both are enabled
+    // when the device has them, otherwise the fp32 variants run
+    VkPhysicalDeviceVulkan11Features supported11 = {};
+    supported11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    VkPhysicalDeviceVulkan12Features supported12 = {};
+    supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    supported12.pNext = &supported11;
+    VkPhysicalDeviceFeatures2 supported = {};
+    supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported.pNext = &supported12;
+    vkGetPhysicalDeviceFeatures2(m_PhysicalDevice, &supported);
+    m_SupportsFloat16 = supported12.shaderFloat16 && supported11.storageBuffer16BitAccess;
+
+    VkPhysicalDeviceVulkan11Features features11 = {};
+    features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    features11.storageBuffer16BitAccess = m_SupportsFloat16;
+
+    VkPhysicalDeviceVulkan12Features features12 = {};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.pNext = &features11;
+    features12.timelineSemaphore = VK_TRUE;
+    features12.shaderFloat16 = m_SupportsFloat16;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures = {};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.pNext = &features12;
+    deviceFeatures.features.samplerAnisotropy = VK_TRUE;
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -313,9 +441,24 @@ void VulkanDevice::CreateLogicalDevice()
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-    createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(m_DeviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = m_DeviceExtensions.data();
+    // Optional: decoded images are uploaded straight out of host memory when available
+    std::vector<const char*> extensions = m_DeviceExtensions;
+    if (HasDeviceExtension(m_PhysicalDevice, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
+    {
+        extensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+
+        VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProperties{};
+        hostProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &hostProperties;
+        vkGetPhysicalDeviceProperties2(m_PhysicalDevice, &properties2);
+        m_HostImportAlignment = hostProperties.minImportedHostPointerAlignment;
+    }
+
+    createInfo.pNext = &deviceFeatures;
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     if (m_EnableValidationLayers)
     {
@@ -332,11 +475,28 @@ void VulkanDevice::CreateLogicalDevice()
         throw std::runtime_error("failed to create logical device!");
     }
 
+    if (m_HostImportAlignment != 0)
+    {
+        m_GetMemoryHostPointerProperties = reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(
+                vkGetDeviceProcAddr(m_LogicalDevice, "vkGetMemoryHostPointerPropertiesEXT"));
+        if (m_GetMemoryHostPointerProperties == nullptr)
+            m_HostImportAlignment = 0;
+    }
+
     if(m_ComputeFamily.has_value())
     {
         std::string name = "Compute Queue";
         vkGetDeviceQueue(m_LogicalDevice, m_ComputeFamily.value(), 0, &m_ComputeQueue);
         SetDebugUtilsObjectName(m_LogicalDevice, VK_OBJECT_TYPE_QUEUE, (uint64_t)m_ComputeQueue, name.c_str());
+        m_Compute = std::make_unique<VulkanQueue>(m_LogicalDevice, m_ComputeQueue, m_ComputeFamily.value());
+    }
+
+    if (m_TransferFamily.has_value())
+    {
+        std::string name = "Transfer Queue";
+        vkGetDeviceQueue(m_LogicalDevice, m_TransferFamily.value(), 0, &m_TransferQueue);
+        SetDebugUtilsObjectName(m_LogicalDevice, VK_OBJECT_TYPE_QUEUE, (uint64_t)m_TransferQueue, name.c_str());
+        m_Transfer = std::make_unique<VulkanQueue>(m_LogicalDevice, m_TransferQueue, m_TransferFamily.value());
     }
 }
 
@@ -355,6 +515,22 @@ void VulkanDevice::CreateComputeCommandPool()
     }
 }
 
+void VulkanDevice::CreateTransferCommandPool()
+{
+    if (!m_TransferFamily.has_value())
+        return;
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = m_TransferFamily.value();
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if (vkCreateCommandPool(m_LogicalDevice, &poolInfo, nullptr, &m_TransferCommandPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create transfer command pool!");
+    }
+}
+
 bool VulkanDevice::IsDeviceSuitable(VkPhysicalDevice device)
 {
     auto computeFamily = FindComputeQueueFamily(device);
@@ -362,7 +538,20 @@ bool VulkanDevice::IsDeviceSuitable(VkPhysicalDevice device)
     VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
-    return computeFamily.has_value() && extensionsSupported;
+    // Submission tracking is built on timeline semaphores
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_2)
+        return false;
+
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &features12;
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+
+    return computeFamily.has_value() && extensionsSupported && features12.timelineSemaphore;
 }
 
 std::optional<uint32_t> VulkanDevice::FindComputeQueueFamily(VkPhysicalDevice device)
@@ -387,6 +576,27 @@ std::optional<uint32_t> VulkanDevice::FindComputeQueueFamily(VkPhysicalDevice de
     return m_ComputeFamily;
 }
 
+std::optional<uint32_t> VulkanDevice::FindTransferQueueFamily(VkPhysicalDevice device)
+{
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+    // Only a family without graphics or compute is backed by the copy engines
+    for (uint32_t i = 0; i < queueFamilyCount; i++)
+    {
+        const auto& queueFamily = queueFamilies[i];
+        if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+            !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+        {
+            return i;
+        }
+    }
+
+    return std::nullopt;
+}
+
 
 uint32_t VulkanDevice::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
 {
@@ -426,13 +636,7 @@ void VulkanDevice::EndSingleTimeCommand(VkCommandBuffer commandBuffer)
 {
     vkEndCommandBuffer(commandBuffer);
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(m_ComputeQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(m_ComputeQueue);
+    m_Compute->Submit(commandBuffer).Wait();
 
     vkFreeCommandBuffers(m_LogicalDevice, m_ComputeCommandPool, 1, &commandBuffer);
 }
@@ -440,7 +644,7 @@ void VulkanDevice::EndSingleTimeCommand(VkCommandBuffer commandBuffer)
 void VulkanDevice::CreateBuffer(
         VkDeviceSize size,
         VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-        VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+        VkBuffer& buffer, MemoryAllocation& bufferMemory)
 {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -451,16 +655,90 @@ void VulkanDevice::CreateBuffer(
     if (vkCreateBuffer(m_LogicalDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
         throw std::runtime_error("Failed to create vertex buffer!");
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(m_LogicalDevice, buffer, &memRequirements);
+    bufferMemory = m_Allocator->AllocateForBuffer(buffer, properties);
+}
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+void VulkanDevice::CreateBuffer(
+        VkDeviceSize size,
+        VkBufferUsageFlags usage, MemoryUsage memoryUsage,
+        VkBuffer& buffer, MemoryAllocation& bufferMemory)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VK_CHECK_RESULT(vkCreateBuffer(m_LogicalDevice, &bufferInfo, nullptr, &buffer));
+    bufferMemory = m_Allocator->AllocateForBuffer(buffer, memoryUsage);
+}
+
+bool VulkanDevice::ImportHostMemory(void* pointer, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& memory)
+{
+    if (!SupportsHostImport())
+        return false;
+
+    VkMemoryHostPointerPropertiesEXT pointerProperties{};
+    pointerProperties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+    if (m_GetMemoryHostPointerProperties(m_LogicalDevice, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, pointer, &pointerProperties) != VK_SUCCESS)
+        return false;
+
+    VkExternalMemoryBufferCreateInfo externalInfo{};
+    externalInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+    externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = &externalInfo;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VK_CHECK_RESULT(vkCreateBuffer(m_LogicalDevice, &bufferInfo, nullptr, &buffer));
+
+    // Imported memory can not be mapped for a flush, only coherent types are usable
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(m_LogicalDevice, buffer, &requirements);
+    std::optional<uint32_t> memoryType = m_Allocator->FindMemoryType(requirements.memoryTypeBits & pointerProperties.memoryTypeBits, MemoryUsage::Upload);
+    if (!memoryType || !(m_Allocator->GetMemoryProperties().memoryTypes[*memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+    {
+        vkDestroyBuffer(m_LogicalDevice, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkImportMemoryHostPointerInfoEXT importInfo{};
+    importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+    importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    importInfo.pHostPointer = pointer;
+
+    VkMemoryAllocateInfo allocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.pNext = &importInfo;
+    allocateInfo.allocationSize = size;
+    allocateInfo.memoryTypeIndex = *memoryType;
+    if (vkAllocateMemory(m_LogicalDevice, &allocateInfo, nullptr, &memory) != VK_SUCCESS)
+    {
+        vkDestroyBuffer(m_LogicalDevice, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        return false;
+    }
+    VK_CHECK_RESULT(vkBindBufferMemory(m_LogicalDevice, buffer, memory, 0));
+    return true;
+}
 
-    if (vkAllocateMemory(m_LogicalDevice, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-        throw std::runtime_error("Failed to allocate vertex buffer memory!");
+bool VulkanDevice::HasUnifiedMemory() const
+{
+    // Discrete GPUs with resizable BAR also have device local host visible memory, but
+    // host reads go over PCIe there, staging through cached system memory is faster
+    const VkPhysicalDeviceType type = PhysicalDeviceProperties.deviceType;
+    if (type != VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU && type != VK_PHYSICAL_DEVICE_TYPE_CPU)
+        return false;
+    return m_Allocator->FindMemoryType(~0u, MemoryUsage::HostMapped).has_value();
+}
 
-    vkBindBufferMemory(m_LogicalDevice, buffer, bufferMemory, 0);
+void VulkanDevice::DestroyBuffer(VkBuffer& buffer, MemoryAllocation& bufferMemory)
+{
+    vkDestroyBuffer(m_LogicalDevice, buffer, nullptr);
+    m_Allocator->Free(bufferMemory);
+    buffer = VK_NULL_HANDLE;
 }
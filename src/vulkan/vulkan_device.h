@@ -3,7 +3,14 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <memory>
 #include <vulkan/vulkan.h>
+#include "vulkan_memory_allocator.h"
+#include "vulkan_queue.h"
+
+class VulkanStagingRing;
+class VulkanHostImportPool;
+class VulkanPipelineCache;
 
 struct SwapchainSupportDetails
 {
@@ -15,7 +22,11 @@ struct SwapchainSupportDetails
 class VulkanDevice
 {
 public:
-    explicit VulkanDevice();
+    // Compute pipelines are cached in a file per device in pipelineCacheDirectory, without
+    // one the cache is kept in memory. Shaders come from the executable unless
+    // shaderDirectory has a file of the same name.
+    explicit VulkanDevice(const std::optional<std::string>& pipelineCacheDirectory = std::nullopt,
+                          const std::string& shaderDirectory = {});
     ~VulkanDevice();
 
     VulkanDevice(const VulkanDevice&) = delete;
@@ -25,23 +36,60 @@ public:
 
     VkCommandPool GetGraphicsCommandPool() { return m_GraphicsCommandPool; }
     VkCommandPool GetComputeCommandPool() { return m_ComputeCommandPool; }
+    // Falls back to the compute pool and queue when there is no dedicated transfer family
+    VkCommandPool GetTransferCommandPool() { return m_Transfer ? m_TransferCommandPool : m_ComputeCommandPool; }
     VkDevice GetDevice() { return m_LogicalDevice; }
-    VkQueue GetComputeQueue() { return m_ComputeQueue; }
+    VulkanQueue& GetComputeQueue() { return *m_Compute; }
+    VulkanQueue& GetTransferQueue() { return m_Transfer ? *m_Transfer : *m_Compute; }
+    [[nodiscard]] bool HasDedicatedTransferQueue() const { return m_Transfer != nullptr; }
     VkPhysicalDevice GetPhysicalDevice() { return m_PhysicalDevice; }
     VkDescriptorPool GetDescriptorPool() { return m_DescriptorPool; }
+    VulkanMemoryAllocator& GetAllocator() { return *m_Allocator; }
+    VulkanStagingRing& GetUploadRing() { return *m_UploadRing; }
+    VulkanStagingRing& GetReadbackRing() { return *m_ReadbackRing; }
+    VulkanHostImportPool& GetHostImportPool() { return *m_HostImportPool; }
+    VulkanPipelineCache& GetPipelineCache() { return *m_PipelineCache; }
+    // Module of a shader by its .spv file name, embedded at build time or overridden from
+    // the shader directory. Throws when neither has it.
+    VkShaderModule CreateShaderModule(const std::string& name);
+    // Milliseconds spent creating the instance, and then the device with its pools,
+    // rings and pipeline cache
+    [[nodiscard]] double GetInstanceCreationTime() const { return m_InstanceCreationTime; }
+    [[nodiscard]] double GetDeviceCreationTime() const { return m_DeviceCreationTime; }
 
     std::optional<uint32_t> FindComputeQueueFamily(VkPhysicalDevice device);
+    std::optional<uint32_t> FindTransferQueueFamily(VkPhysicalDevice device);
     uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    // Integrated and CPU devices whose device local memory the host can map, so images
+    // can be read and written in place instead of through staging buffers
+    [[nodiscard]] bool HasUnifiedMemory() const;
+
+    // shaderFloat16 and storageBuffer16BitAccess, enabled together for the fp16 NIS shaders
+    [[nodiscard]] bool SupportsFloat16() const { return m_SupportsFloat16; }
+
+    // VK_EXT_external_memory_host is enabled when the device offers it
+    [[nodiscard]] bool SupportsHostImport() const { return m_HostImportAlignment != 0; }
+    // minImportedHostPointerAlignment, the alignment of both the pointer and the size of an import
+    [[nodiscard]] VkDeviceSize GetHostImportAlignment() const { return m_HostImportAlignment; }
+    // Wraps host memory in a buffer the device reads in place. The memory must outlive the
+    // buffer. Returns false when the driver can not import the pointer into coherent memory.
+    bool ImportHostMemory(void* pointer, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& memory);
 
     VkPhysicalDeviceProperties PhysicalDeviceProperties{};
 
     VkCommandBuffer BeginSingleTimeCommands();
+    // Submits and waits for this command buffer only, other work on the queue keeps running
     void EndSingleTimeCommand(VkCommandBuffer commandBuffer);
 
     void CreateBuffer(
             VkDeviceSize size,
             VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-            VkBuffer &buffer, VkDeviceMemory &bufferMemory);
+            VkBuffer &buffer, MemoryAllocation &bufferMemory);
+    void CreateBuffer(
+            VkDeviceSize size,
+            VkBufferUsageFlags usage, MemoryUsage memoryUsage,
+            VkBuffer &buffer, MemoryAllocation &bufferMemory);
+    void DestroyBuffer(VkBuffer &buffer, MemoryAllocation &bufferMemory);
 
 private:
     void CreateInstance();
@@ -49,6 +97,7 @@ private:
     void SelectPhysicalDevice();
     void CreateLogicalDevice();
     void CreateComputeCommandPool();
+    void CreateTransferCommandPool();
 
     bool IsDeviceSuitable(VkPhysicalDevice device);
     [[nodiscard]] std::vector<const char*> GetRequiredExtensions() const;
@@ -57,8 +106,10 @@ private:
     void PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
     void HasGLFWRequiredInstanceExtensions();
     bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
+    bool HasDeviceExtension(VkPhysicalDevice device, const char* name);
 
     std::optional<uint32_t> m_ComputeFamily;
+    std::optional<uint32_t> m_TransferFamily;
     VkDescriptorPool m_DescriptorPool;
 #ifdef VULKAN_DEBUG
     bool m_EnableValidationLayers = true;
@@ -70,12 +121,29 @@ private:
     VkPhysicalDevice m_PhysicalDevice = VK_NULL_HANDLE;
     VkCommandPool m_GraphicsCommandPool{};
     VkCommandPool m_ComputeCommandPool{};
+    VkCommandPool m_TransferCommandPool{};
 
     VkDevice m_LogicalDevice{};
     VkSurfaceKHR m_Surface{};
     VkQueue m_GraphicsQueue{};
     VkQueue m_PresentQueue{};
     VkQueue m_ComputeQueue{};
+    VkQueue m_TransferQueue{};
+    std::unique_ptr<VulkanQueue> m_Compute;
+    std::unique_ptr<VulkanQueue> m_Transfer;
+
+    std::unique_ptr<VulkanMemoryAllocator> m_Allocator;
+    std::unique_ptr<VulkanStagingRing> m_UploadRing;
+    std::unique_ptr<VulkanStagingRing> m_ReadbackRing;
+    std::unique_ptr<VulkanHostImportPool> m_HostImportPool;
+    std::unique_ptr<VulkanPipelineCache> m_PipelineCache;
+    std::string m_ShaderDirectory;
+    double m_InstanceCreationTime = 0.0;
+    double m_DeviceCreationTime = 0.0;
+
+    VkDeviceSize m_HostImportAlignment = 0;
+    bool m_SupportsFloat16 = false;
+    PFN_vkGetMemoryHostPointerPropertiesEXT m_GetMemoryHostPointerProperties = nullptr;
 
     const std::vector<const char *> m_ValidationLayers = {"VK_LAYER_KHRONOS_validation"};
     const std::vector<const char *> m_DeviceExtensions = {};
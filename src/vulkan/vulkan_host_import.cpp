@@ -0,0 +1,89 @@
+#include "vulkan_host_import.h"
+#include "vulkan_device.h"
+
+#include <new>
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+VulkanHostImportPool::VulkanHostImportPool(VulkanDevice& device, VkDeviceSize idleBudget)
+    : m_Device(device), m_IdleBudget(idleBudget)
+{
+}
+
+VulkanHostImportPool::~VulkanHostImportPool()
+{
+    for (auto& [size, buffer] : m_Idle)
+        Destroy(buffer);
+}
+
+bool VulkanHostImportPool::IsSupported() const
+{
+    return m_Device.SupportsHostImport();
+}
+
+HostImportHandle VulkanHostImportPool::Acquire(VkDeviceSize size)
+{
+    if (!IsSupported())
+        return nullptr;
+
+    size = AlignUp(size, m_Device.GetHostImportAlignment());
+    HostImportBuffer* buffer = nullptr;
+    {
+        // Smallest idle buffer that fits, unless it would waste more than the request
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto it = m_Idle.lower_bound(size);
+        if (it != m_Idle.end() && it->first <= 2 * size)
+        {
+            buffer = it->second;
+            m_IdleBytes -= it->first;
+            m_Idle.erase(it);
+        }
+    }
+
+    if (buffer == nullptr)
+        buffer = Create(size);
+    if (buffer == nullptr)
+        return nullptr;
+    return HostImportHandle(buffer, [this](HostImportBuffer* released) { Recycle(released); });
+}
+
+HostImportBuffer* VulkanHostImportPool::Create(VkDeviceSize size)
+{
+    const auto alignment = std::align_val_t(m_Device.GetHostImportAlignment());
+    auto* data = static_cast<uint8_t*>(::operator new(size, alignment));
+
+    VkBuffer vkBuffer;
+    VkDeviceMemory memory;
+    if (!m_Device.ImportHostMemory(data, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vkBuffer, memory))
+    {
+        ::operator delete(data, alignment);
+        return nullptr;
+    }
+    return new HostImportBuffer{ data, size, vkBuffer, memory };
+}
+
+void VulkanHostImportPool::Destroy(HostImportBuffer* buffer)
+{
+    // The import goes first, the host memory must outlive it
+    vkDestroyBuffer(m_Device.GetDevice(), buffer->Buffer, nullptr);
+    vkFreeMemory(m_Device.GetDevice(), buffer->Memory, nullptr);
+    ::operator delete(buffer->Data, std::align_val_t(m_Device.GetHostImportAlignment()));
+    delete buffer;
+}
+
+void VulkanHostImportPool::Recycle(HostImportBuffer* buffer)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_IdleBytes + buffer->Size <= m_IdleBudget)
+        {
+            m_Idle.emplace(buffer->Size, buffer);
+            m_IdleBytes += buffer->Size;
+            return;
+        }
+    }
+    Destroy(buffer);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vulkan/vulkan.h>
+
+class VulkanDevice;
+
+// Host memory the device reads in place through VK_EXT_external_memory_host. Data and
+// Size are multiples of minImportedHostPointerAlignment, as imports require.
+struct HostImportBuffer
+{
+    uint8_t* Data = nullptr;
+    VkDeviceSize Size = 0;
+    VkBuffer Buffer = VK_NULL_HANDLE;
+    VkDeviceMemory Memory = VK_NULL_HANDLE;
+};
+
+// Returns the buffer to its pool when the last reference goes away
+using HostImportHandle = std::shared_ptr<HostImportBuffer>;
+
+// Hands out imported host buffers for decoders to write into, so an upload copies from
+// the decoded pixels with no staging copy in between. Buffers released by earlier
+// images are reused, idle ones are kept up to a memory budget. Acquire returns null when
+// the device can not import host memory; callers then stage the pixels as before.
+// Thread safe. Every handle must be gone before the pool is destroyed.
+class VulkanHostImportPool
+{
+public:
+    VulkanHostImportPool(VulkanDevice& device, VkDeviceSize idleBudget);
+    ~VulkanHostImportPool();
+
+    VulkanHostImportPool(const VulkanHostImportPool&) = delete;
+    VulkanHostImportPool& operator=(const VulkanHostImportPool&) = delete;
+
+    [[nodiscard]] bool IsSupported() const;
+    // A buffer of at least size bytes, usable as a transfer source and storage buffer
+    HostImportHandle Acquire(VkDeviceSize size);
+
+private:
+    HostImportBuffer* Create(VkDeviceSize size);
+    void Destroy(HostImportBuffer* buffer);
+    void Recycle(HostImportBuffer* buffer);
+
+    VulkanDevice& m_Device;
+    VkDeviceSize m_IdleBudget;
+
+    std::mutex m_Mutex;
+    std::multimap<VkDeviceSize, HostImportBuffer*> m_Idle; // by size
+    VkDeviceSize m_IdleBytes = 0;
+};
@@ -0,0 +1,134 @@
+#include "vulkan_image_cache.h"
+#include "vulkan_device.h"
+#include "vulkan_utils.h"
+
+#include <algorithm>
+#include <cassert>
+
+VulkanImageCache::VulkanImageCache(VulkanDevice& device, VkDeviceSize budget)
+    : m_Device(device), m_Budget(budget)
+{
+}
+
+VulkanImageCache::~VulkanImageCache()
+{
+    for (auto& image : m_Idle)
+        DestroyImage(image);
+}
+
+CachedImage VulkanImageCache::Acquire(const ImageKey& key)
+{
+    auto it = m_IdleIndex.find(key);
+    if (it != m_IdleIndex.end())
+    {
+        CachedImage image = *it->second;
+        m_Idle.erase(it->second);
+        m_IdleIndex.erase(it);
+        m_Stats.Hits++;
+        return image;
+    }
+
+    m_Stats.Misses++;
+    CachedImage image = CreateImage(key);
+    m_Stats.BytesAllocated += image.Size;
+    m_Stats.PeakBytesAllocated = std::max(m_Stats.PeakBytesAllocated, m_Stats.BytesAllocated);
+    Trim();
+    return image;
+}
+
+void VulkanImageCache::Release(CachedImage& image)
+{
+    if (!image.IsValid())
+        return;
+
+    m_Idle.push_front(image);
+    m_IdleIndex.emplace(image.Key, m_Idle.begin());
+    image = {};
+    Trim();
+}
+
+void VulkanImageCache::Trim()
+{
+    while (m_Stats.BytesAllocated > m_Budget && !m_Idle.empty())
+    {
+        auto oldest = std::prev(m_Idle.end());
+        auto range = m_IdleIndex.equal_range(oldest->Key);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == oldest)
+            {
+                m_IdleIndex.erase(it);
+                break;
+            }
+        }
+
+        m_Stats.BytesAllocated -= oldest->Size;
+        m_Stats.Evictions++;
+        DestroyImage(*oldest);
+        m_Idle.erase(oldest);
+    }
+}
+
+CachedImage VulkanImageCache::CreateImage(const ImageKey& key)
+{
+    CachedImage image;
+    image.Key = key;
+
+    // Create texture image object and backing memory
+    {
+        VkImageCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.extent.width = key.Width;
+        info.extent.height = key.Height;
+        info.extent.depth = 1;
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.format = key.Format;
+        // Host writes are only defined in PREINITIALIZED or GENERAL layout
+        info.tiling = key.HostMapped ? VK_IMAGE_TILING_LINEAR : VK_IMAGE_TILING_OPTIMAL;
+        info.initialLayout = key.HostMapped ? VK_IMAGE_LAYOUT_PREINITIALIZED : VK_IMAGE_LAYOUT_UNDEFINED;
+        info.usage = key.Usage;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+
+        VK_CHECK_RESULT(vkCreateImage(m_Device.GetDevice(), &info, nullptr, &image.Image));
+    }
+    image.Layout = key.HostMapped ? VK_IMAGE_LAYOUT_PREINITIALIZED : VK_IMAGE_LAYOUT_UNDEFINED;
+    if (key.HostMapped)
+    {
+        image.Memory = m_Device.GetAllocator().AllocateForImage(image.Image, MemoryUsage::HostMapped, VK_IMAGE_TILING_LINEAR);
+
+        VkImageSubresource subresource{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
+        VkSubresourceLayout layout;
+        vkGetImageSubresourceLayout(m_Device.GetDevice(), image.Image, &subresource, &layout);
+        image.PixelOffset = layout.offset;
+        image.RowPitch = layout.rowPitch;
+    }
+    else
+    {
+        image.Memory = m_Device.GetAllocator().AllocateForImage(image.Image, MemoryUsage::GpuOnly);
+    }
+    image.Size = image.Memory.Size;
+    // Create image view
+    {
+        VkImageViewCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        info.image = image.Image;
+        info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        info.format = key.Format;
+        info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        info.subresourceRange.layerCount = 1;
+        info.subresourceRange.levelCount = 1;
+        VK_CHECK_RESULT(vkCreateImageView(m_Device.GetDevice(), &info, nullptr, &image.View));
+    }
+    return image;
+}
+
+void VulkanImageCache::DestroyImage(CachedImage& image)
+{
+    vkDestroyImageView(m_Device.GetDevice(), image.View, nullptr);
+    vkDestroyImage(m_Device.GetDevice(), image.Image, nullptr);
+    m_Device.GetAllocator().Free(image.Memory);
+    image = {};
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+#include "vulkan_memory_allocator.h"
+
+class VulkanDevice;
+
+struct ImageKey
+{
+    uint32_t Width = 0, Height = 0;
+    VkFormat Format = VK_FORMAT_UNDEFINED;
+    VkImageUsageFlags Usage = 0;
+    // Linear tiling in memory the host maps, for devices with unified memory
+    bool HostMapped = false;
+
+    bool operator==(const ImageKey& other) const
+    {
+        return Width == other.Width && Height == other.Height && Format == other.Format && Usage == other.Usage &&
+               HostMapped == other.HostMapped;
+    }
+};
+
+struct ImageKeyHash
+{
+    size_t operator()(const ImageKey& key) const
+    {
+        size_t hash = std::hash<uint64_t>()((uint64_t(key.Width) << 32) | key.Height);
+        hash ^= std::hash<uint64_t>()((uint64_t(key.Format) << 32) | key.Usage) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        hash ^= size_t(key.HostMapped);
+        return hash;
+    }
+};
+
+// Device local 2D image with its backing memory and a full view.
+struct CachedImage
+{
+    ImageKey Key;
+    VkImage Image = VK_NULL_HANDLE;
+    MemoryAllocation Memory;
+    VkImageView View = VK_NULL_HANDLE;
+    VkDeviceSize Size = 0;
+
+    // Host mapped images only: where the pixels start in Memory.Mapped, the distance
+    // between rows, and the layout the last user left the image in. Their contents
+    // outlive a trip through the cache, so the next user must not discard them.
+    VkDeviceSize PixelOffset = 0;
+    VkDeviceSize RowPitch = 0;
+    VkImageLayout Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    [[nodiscard]] bool IsValid() const { return Image != VK_NULL_HANDLE; }
+    [[nodiscard]] uint8_t* GetPixels() const { return static_cast<uint8_t*>(Memory.Mapped) + PixelOffset; }
+};
+
+struct ImageCacheStats
+{
+    uint64_t Hits = 0;
+    uint64_t Misses = 0;
+    uint64_t Evictions = 0;
+    VkDeviceSize BytesAllocated = 0;
+    VkDeviceSize PeakBytesAllocated = 0;
+};
+
+// Keeps released images around so the next image of the same size, format and usage
+// reuses them instead of going through vkCreateImage and the allocator again.
+// Idle images are evicted least recently used first whenever the memory held by the
+// cache, in use or idle, exceeds the budget. Not thread safe.
+class VulkanImageCache
+{
+public:
+    VulkanImageCache(VulkanDevice& device, VkDeviceSize budget);
+    ~VulkanImageCache();
+
+    VulkanImageCache(const VulkanImageCache&) = delete;
+    VulkanImageCache& operator=(const VulkanImageCache&) = delete;
+
+    CachedImage Acquire(const ImageKey& key);
+    // The caller guarantees the GPU no longer uses the image.
+    void Release(CachedImage& image);
+
+    [[nodiscard]] const ImageCacheStats& GetStats() const { return m_Stats; }
+    [[nodiscard]] VkDeviceSize GetBudget() const { return m_Budget; }
+
+private:
+    CachedImage CreateImage(const ImageKey& key);
+    void DestroyImage(CachedImage& image);
+    void Trim();
+
+    VulkanDevice& m_Device;
+    VkDeviceSize m_Budget;
+    ImageCacheStats m_Stats;
+
+    // Front is the most recently released image
+    std::list<CachedImage> m_Idle;
+    std::unordered_multimap<ImageKey, std::list<CachedImage>::iterator, ImageKeyHash> m_IdleIndex;
+};
@@ -0,0 +1,437 @@
+#include "vulkan_memory_allocator.h"
+#include "vulkan_utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <stdexcept>
+
+struct MemoryBlock
+{
+    VkDeviceMemory Memory = VK_NULL_HANDLE;
+    VkDeviceSize Size = 0;
+    uint8_t* Mapped = nullptr;
+    uint32_t MemoryType = 0;
+    AllocationLayout Layout = AllocationLayout::Linear;
+
+    // Free ranges, offset -> size, never adjacent to each other
+    std::map<VkDeviceSize, VkDeviceSize> FreeRanges;
+    VkDeviceSize BytesUsed = 0;
+    uint32_t AllocationCount = 0;
+};
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+VulkanMemoryAllocator::VulkanMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize preferredBlockSize)
+    : m_Device(device), m_PreferredBlockSize(preferredBlockSize)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_NonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+    m_MaxAllocationCount = properties.limits.maxMemoryAllocationCount;
+}
+
+VulkanMemoryAllocator::~VulkanMemoryAllocator()
+{
+    for (auto& blocks : m_Blocks)
+    {
+        for (auto& block : blocks)
+        {
+            assert(block->AllocationCount == 0 && "Memory block still has live allocations");
+            vkFreeMemory(m_Device, block->Memory, nullptr);
+        }
+    }
+}
+
+uint32_t VulkanMemoryAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+    for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+    {
+        if ((typeFilter & (1 << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+// Higher is better, negative rules the type out
+static int ScoreMemoryType(VkMemoryPropertyFlags flags, MemoryUsage usage)
+{
+    if (flags & (VK_MEMORY_PROPERTY_PROTECTED_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+        return -1;
+
+    const bool deviceLocal = flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    const bool hostVisible = flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    const bool coherent = flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    const bool cached = flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+    switch (usage)
+    {
+    case MemoryUsage::GpuOnly:
+        // Leave the host visible device memory (the BAR window) to resources that map it
+        return (deviceLocal ? 4 : 0) + (hostVisible ? 0 : 2);
+    case MemoryUsage::Upload:
+        // Sequential writes go through write combining at full speed, caching only costs
+        // snooping. System memory keeps the small BAR heap free on discrete GPUs.
+        if (!hostVisible)
+            return -1;
+        return (coherent ? 4 : 0) + (cached ? 0 : 2) + (deviceLocal ? 0 : 1);
+    case MemoryUsage::Readback:
+        // Reads from uncached memory bypass the CPU caches and are an order of magnitude
+        // slower, a non-coherent cached type with an invalidate beats a coherent uncached one
+        if (!hostVisible)
+            return -1;
+        return (cached ? 4 : 0) + (coherent ? 2 : 0) + (deviceLocal ? 0 : 1);
+    case MemoryUsage::HostMapped:
+        if (!deviceLocal || !hostVisible)
+            return -1;
+        return (cached ? 2 : 0) + (coherent ? 1 : 0);
+    }
+    return -1;
+}
+
+std::optional<uint32_t> VulkanMemoryAllocator::FindMemoryType(uint32_t typeFilter, MemoryUsage usage) const
+{
+    std::optional<uint32_t> best;
+    int bestScore = -1;
+    for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+    {
+        if (!(typeFilter & (1 << i)))
+            continue;
+
+        // Ties go to the lower index, the order drivers list their preferred types in
+        int score = ScoreMemoryType(m_MemoryProperties.memoryTypes[i].propertyFlags, usage);
+        if (score > bestScore)
+        {
+            best = i;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+bool VulkanMemoryAllocator::IsCoherent(const MemoryAllocation& allocation) const
+{
+    return m_MemoryProperties.memoryTypes[allocation.MemoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+VkDeviceSize VulkanMemoryAllocator::GetBlockSize(uint32_t memoryType) const
+{
+    // Small heaps (e.g. the 256 MiB BAR window) get smaller blocks so one block can't take the whole heap
+    VkDeviceSize heapSize = m_MemoryProperties.memoryHeaps[m_MemoryProperties.memoryTypes[memoryType].heapIndex].size;
+    return std::min(m_PreferredBlockSize, std::max<VkDeviceSize>(AlignUp(heapSize / 8, 1024 * 1024), 1024 * 1024));
+}
+
+VkDeviceMemory VulkanMemoryAllocator::AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped)
+{
+    if (m_DeviceMemoryCount >= m_MaxAllocationCount)
+        throw std::runtime_error("maxMemoryAllocationCount exceeded!");
+
+    VkMemoryAllocateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    info.allocationSize = size;
+    info.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    VK_CHECK_RESULT(vkAllocateMemory(m_Device, &info, nullptr, &memory));
+    m_DeviceMemoryCount++;
+
+    *mapped = nullptr;
+    if (m_MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        VK_CHECK_RESULT(vkMapMemory(m_Device, memory, 0, VK_WHOLE_SIZE, 0, mapped));
+    return memory;
+}
+
+bool VulkanMemoryAllocator::TryAllocateFromBlock(MemoryBlock& block, const VkMemoryRequirements& requirements, MemoryAllocation& allocation)
+{
+    const VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+    // Best fit: the range that leaves the least space behind
+    auto best = block.FreeRanges.end();
+    VkDeviceSize bestWaste = ~VkDeviceSize(0);
+    for (auto it = block.FreeRanges.begin(); it != block.FreeRanges.end(); ++it)
+    {
+        VkDeviceSize alignedOffset = AlignUp(it->first, alignment);
+        VkDeviceSize padding = alignedOffset - it->first;
+        if (padding + requirements.size > it->second)
+            continue;
+
+        VkDeviceSize waste = it->second - requirements.size;
+        if (waste < bestWaste)
+        {
+            best = it;
+            bestWaste = waste;
+            if (waste == padding)
+                break;
+        }
+    }
+    if (best == block.FreeRanges.end())
+        return false;
+
+    VkDeviceSize rangeOffset = best->first;
+    VkDeviceSize rangeSize = best->second;
+    VkDeviceSize offset = AlignUp(rangeOffset, alignment);
+    block.FreeRanges.erase(best);
+
+    // Alignment padding stays free, so freeing the allocation later coalesces it again
+    if (offset > rangeOffset)
+        block.FreeRanges.emplace(rangeOffset, offset - rangeOffset);
+    VkDeviceSize end = offset + requirements.size;
+    if (end < rangeOffset + rangeSize)
+        block.FreeRanges.emplace(end, rangeOffset + rangeSize - end);
+
+    block.BytesUsed += requirements.size;
+    block.AllocationCount++;
+
+    allocation.Memory = block.Memory;
+    allocation.Offset = offset;
+    allocation.Size = requirements.size;
+    allocation.Mapped = block.Mapped ? block.Mapped + offset : nullptr;
+    allocation.MemoryType = block.MemoryType;
+    allocation.Block = &block;
+    return true;
+}
+
+MemoryAllocation VulkanMemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, AllocationLayout layout)
+{
+    return AllocateFromType(requirements, FindMemoryType(requirements.memoryTypeBits, properties), layout);
+}
+
+MemoryAllocation VulkanMemoryAllocator::Allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, AllocationLayout layout)
+{
+    std::optional<uint32_t> memoryType = FindMemoryType(requirements.memoryTypeBits, usage);
+    if (!memoryType)
+        throw std::runtime_error("failed to find suitable memory type!");
+    return AllocateFromType(requirements, *memoryType, layout);
+}
+
+MemoryAllocation VulkanMemoryAllocator::AllocateFromType(const VkMemoryRequirements& requirements, uint32_t memoryType, AllocationLayout layout)
+{
+    VkDeviceSize blockSize = GetBlockSize(memoryType);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    MemoryAllocation allocation;
+    if (requirements.size >= blockSize / 2)
+    {
+        void* mapped;
+        allocation.Memory = AllocateDeviceMemory(requirements.size, memoryType, &mapped);
+        allocation.Size = requirements.size;
+        allocation.Mapped = mapped;
+        allocation.MemoryType = memoryType;
+        m_DedicatedCount[memoryType]++;
+        m_DedicatedBytes[memoryType] += requirements.size;
+        return allocation;
+    }
+
+    auto& blocks = m_Blocks[memoryType];
+    for (auto& block : blocks)
+    {
+        if (block->Layout == layout && TryAllocateFromBlock(*block, requirements, allocation))
+            return allocation;
+    }
+
+    auto block = std::make_unique<MemoryBlock>();
+    void* mapped;
+    block->Memory = AllocateDeviceMemory(blockSize, memoryType, &mapped);
+    block->Mapped = static_cast<uint8_t*>(mapped);
+    block->Size = blockSize;
+    block->MemoryType = memoryType;
+    block->Layout = layout;
+    block->FreeRanges.emplace(0, blockSize);
+    blocks.push_back(std::move(block));
+
+    bool allocated = TryAllocateFromBlock(*blocks.back(), requirements, allocation);
+    assert(allocated);
+    (void)allocated;
+    return allocation;
+}
+
+MemoryAllocation VulkanMemoryAllocator::AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties)
+{
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(m_Device, buffer, &requirements);
+
+    MemoryAllocation allocation = Allocate(requirements, properties, AllocationLayout::Linear);
+    VK_CHECK_RESULT(vkBindBufferMemory(m_Device, buffer, allocation.Memory, allocation.Offset));
+    return allocation;
+}
+
+MemoryAllocation VulkanMemoryAllocator::AllocateForBuffer(VkBuffer buffer, MemoryUsage usage)
+{
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(m_Device, buffer, &requirements);
+
+    MemoryAllocation allocation = Allocate(requirements, usage, AllocationLayout::Linear);
+    VK_CHECK_RESULT(vkBindBufferMemory(m_Device, buffer, allocation.Memory, allocation.Offset));
+    return allocation;
+}
+
+MemoryAllocation VulkanMemoryAllocator::AllocateForImage(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling)
+{
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(m_Device, image, &requirements);
+
+    AllocationLayout layout = tiling == VK_IMAGE_TILING_OPTIMAL ? AllocationLayout::Optimal : AllocationLayout::Linear;
+    MemoryAllocation allocation = Allocate(requirements, properties, layout);
+    VK_CHECK_RESULT(vkBindImageMemory(m_Device, image, allocation.Memory, allocation.Offset));
+    return allocation;
+}
+
+MemoryAllocation VulkanMemoryAllocator::AllocateForImage(VkImage image, MemoryUsage usage, VkImageTiling tiling)
+{
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(m_Device, image, &requirements);
+
+    AllocationLayout layout = tiling == VK_IMAGE_TILING_OPTIMAL ? AllocationLayout::Optimal : AllocationLayout::Linear;
+    MemoryAllocation allocation = Allocate(requirements, usage, layout);
+    VK_CHECK_RESULT(vkBindImageMemory(m_Device, image, allocation.Memory, allocation.Offset));
+    return allocation;
+}
+
+void VulkanMemoryAllocator::Free(MemoryAllocation& allocation)
+{
+    if (!allocation.IsValid())
+        return;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (allocation.Block == nullptr)
+    {
+        vkFreeMemory(m_Device, allocation.Memory, nullptr);
+        m_DeviceMemoryCount--;
+        m_DedicatedCount[allocation.MemoryType]--;
+        m_DedicatedBytes[allocation.MemoryType] -= allocation.Size;
+        allocation = {};
+        return;
+    }
+
+    MemoryBlock& block = *allocation.Block;
+    VkDeviceSize offset = allocation.Offset;
+    VkDeviceSize size = allocation.Size;
+
+    // Merge with the free ranges on either side
+    auto next = block.FreeRanges.lower_bound(offset);
+    if (next != block.FreeRanges.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = block.FreeRanges.erase(next);
+    }
+    if (next != block.FreeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            offset = prev->first;
+            size += prev->second;
+            block.FreeRanges.erase(prev);
+        }
+    }
+    block.FreeRanges.emplace(offset, size);
+
+    block.BytesUsed -= allocation.Size;
+    block.AllocationCount--;
+
+    // Keep one empty block per memory type around for the next allocation, release the rest
+    auto& blocks = m_Blocks[allocation.MemoryType];
+    if (block.AllocationCount == 0)
+    {
+        bool otherEmpty = std::any_of(blocks.begin(), blocks.end(), [&](const auto& other)
+        {
+            return other.get() != &block && other->AllocationCount == 0;
+        });
+        if (otherEmpty)
+        {
+            vkFreeMemory(m_Device, block.Memory, nullptr);
+            m_DeviceMemoryCount--;
+            blocks.erase(std::find_if(blocks.begin(), blocks.end(), [&](const auto& other) { return other.get() == &block; }));
+        }
+    }
+    allocation = {};
+}
+
+VkMappedMemoryRange VulkanMemoryAllocator::GetMappedRange(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (size == VK_WHOLE_SIZE)
+        size = allocation.Size - offset;
+
+    VkDeviceSize memorySize = allocation.Block ? allocation.Block->Size : allocation.Size;
+    VkDeviceSize begin = (allocation.Offset + offset) / m_NonCoherentAtomSize * m_NonCoherentAtomSize;
+    VkDeviceSize end = std::min(AlignUp(allocation.Offset + offset + size, m_NonCoherentAtomSize), memorySize);
+
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation.Memory;
+    range.offset = begin;
+    range.size = end == memorySize ? VK_WHOLE_SIZE : end - begin;
+    return range;
+}
+
+VkResult VulkanMemoryAllocator::Flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (IsCoherent(allocation))
+        return VK_SUCCESS;
+    VkMappedMemoryRange range = GetMappedRange(allocation, offset, size);
+    return vkFlushMappedMemoryRanges(m_Device, 1, &range);
+}
+
+VkResult VulkanMemoryAllocator::Invalidate(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (IsCoherent(allocation))
+        return VK_SUCCESS;
+    VkMappedMemoryRange range = GetMappedRange(allocation, offset, size);
+    return vkInvalidateMappedMemoryRanges(m_Device, 1, &range);
+}
+
+std::vector<MemoryHeapStats> VulkanMemoryAllocator::GetHeapStats() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::vector<MemoryHeapStats> stats(m_MemoryProperties.memoryHeapCount);
+    for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; ++i)
+    {
+        stats[i].HeapIndex = i;
+        stats[i].HeapSize = m_MemoryProperties.memoryHeaps[i].size;
+    }
+
+    for (uint32_t type = 0; type < m_MemoryProperties.memoryTypeCount; ++type)
+    {
+        MemoryHeapStats& heap = stats[m_MemoryProperties.memoryTypes[type].heapIndex];
+        for (const auto& block : m_Blocks[type])
+        {
+            heap.BlockCount++;
+            heap.BytesReserved += block->Size;
+            heap.BytesUsed += block->BytesUsed;
+            heap.AllocationCount += block->AllocationCount;
+            for (const auto& range : block->FreeRanges)
+                heap.LargestFreeRange = std::max(heap.LargestFreeRange, range.second);
+        }
+        heap.BytesReserved += m_DedicatedBytes[type];
+        heap.BytesUsed += m_DedicatedBytes[type];
+        heap.AllocationCount += m_DedicatedCount[type];
+        heap.DedicatedAllocationCount += m_DedicatedCount[type];
+    }
+    return stats;
+}
+
+void VulkanMemoryAllocator::PrintStats(std::ostream& os) const
+{
+    for (const auto& heap : GetHeapStats())
+    {
+        if (heap.BytesReserved == 0)
+            continue;
+
+        os << "Memory heap " << heap.HeapIndex << ": "
+           << (heap.BytesUsed >> 20) << " / " << (heap.BytesReserved >> 20) << " MiB used in "
+           << heap.BlockCount << " blocks, "
+           << heap.AllocationCount << " allocations (" << heap.DedicatedAllocationCount << " dedicated), "
+           << std::fixed << std::setprecision(1) << heap.GetFragmentation() * 100.0f << "% fragmented" << std::endl;
+    }
+}
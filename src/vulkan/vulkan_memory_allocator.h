@@ -0,0 +1,119 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct MemoryBlock;
+
+// Sub-range of a VkDeviceMemory handed out by VulkanMemoryAllocator. Host visible
+// memory is mapped once per block; Mapped points at Offset.
+struct MemoryAllocation
+{
+    VkDeviceMemory Memory = VK_NULL_HANDLE;
+    VkDeviceSize Offset = 0;
+    VkDeviceSize Size = 0;
+    void* Mapped = nullptr;
+    uint32_t MemoryType = 0;
+    MemoryBlock* Block = nullptr; // null for dedicated allocations
+
+    [[nodiscard]] bool IsValid() const { return Memory != VK_NULL_HANDLE; }
+};
+
+// Buffers and linear images never share a block with optimal tiling images, so
+// bufferImageGranularity can not put a linear and an optimal resource on one page.
+enum class AllocationLayout
+{
+    Linear,
+    Optimal
+};
+
+// What the host does with a resource's memory. Each usage scores the memory types
+// instead of taking the first one that has the required flags.
+enum class MemoryUsage
+{
+    GpuOnly,   // DEVICE_LOCAL, preferring types the host can not map
+    Upload,    // written once by the host: uncached write-combined memory is fine
+    Readback,  // read by the host: HOST_CACHED, invalidated before every read if not coherent
+    HostMapped // DEVICE_LOCAL and HOST_VISIBLE, only offered by UMA devices and resizable BAR
+};
+
+struct MemoryHeapStats
+{
+    uint32_t HeapIndex = 0;
+    VkDeviceSize HeapSize = 0;
+    VkDeviceSize BytesReserved = 0;
+    VkDeviceSize BytesUsed = 0;
+    VkDeviceSize LargestFreeRange = 0;
+    uint32_t BlockCount = 0;
+    uint32_t AllocationCount = 0;
+    uint32_t DedicatedAllocationCount = 0;
+
+    // 0 when all free space in the heap's blocks is one range, approaching 1 as it splinters
+    [[nodiscard]] float GetFragmentation() const
+    {
+        VkDeviceSize free = BytesReserved - BytesUsed;
+        return free > 0 ? 1.0f - float(LargestFreeRange) / float(free) : 0.0f;
+    }
+};
+
+// Places buffers and images in large vkAllocateMemory blocks, one set of blocks per
+// memory type, instead of giving each resource its own allocation. Free space in a
+// block is kept as an offset ordered free list that coalesces on free, allocations
+// take the best fitting range. Resources of at least half a block get a dedicated
+// allocation. Thread safe.
+class VulkanMemoryAllocator
+{
+public:
+    VulkanMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize preferredBlockSize = 256ull * 1024 * 1024);
+    ~VulkanMemoryAllocator();
+
+    VulkanMemoryAllocator(const VulkanMemoryAllocator&) = delete;
+    VulkanMemoryAllocator& operator=(const VulkanMemoryAllocator&) = delete;
+
+    MemoryAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, AllocationLayout layout);
+    MemoryAllocation Allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, AllocationLayout layout);
+    // Allocate and bind in one step
+    MemoryAllocation AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+    MemoryAllocation AllocateForBuffer(VkBuffer buffer, MemoryUsage usage);
+    MemoryAllocation AllocateForImage(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL);
+    MemoryAllocation AllocateForImage(VkImage image, MemoryUsage usage, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL);
+    void Free(MemoryAllocation& allocation);
+
+    // Best scoring memory type in typeFilter for the usage, none if no type qualifies
+    [[nodiscard]] std::optional<uint32_t> FindMemoryType(uint32_t typeFilter, MemoryUsage usage) const;
+    [[nodiscard]] bool IsCoherent(const MemoryAllocation& allocation) const;
+
+    // Ranges are relative to the allocation and widened to nonCoherentAtomSize. Both
+    // return immediately for HOST_COHERENT memory, so callers need not check.
+    VkResult Flush(const MemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+    VkResult Invalidate(const MemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+
+    [[nodiscard]] const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const { return m_MemoryProperties; }
+    [[nodiscard]] std::vector<MemoryHeapStats> GetHeapStats() const;
+    void PrintStats(std::ostream& os) const;
+
+private:
+    uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+    MemoryAllocation AllocateFromType(const VkMemoryRequirements& requirements, uint32_t memoryType, AllocationLayout layout);
+    VkDeviceSize GetBlockSize(uint32_t memoryType) const;
+    VkDeviceMemory AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped);
+    bool TryAllocateFromBlock(MemoryBlock& block, const VkMemoryRequirements& requirements, MemoryAllocation& allocation);
+    VkMappedMemoryRange GetMappedRange(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+    VkDevice m_Device;
+    VkPhysicalDeviceMemoryProperties m_MemoryProperties{};
+    VkDeviceSize m_PreferredBlockSize;
+    VkDeviceSize m_NonCoherentAtomSize;
+    uint32_t m_MaxAllocationCount;
+
+    mutable std::mutex m_Mutex;
+    std::vector<std::unique_ptr<MemoryBlock>> m_Blocks[VK_MAX_MEMORY_TYPES];
+    uint32_t m_DeviceMemoryCount = 0;
+    uint32_t m_DedicatedCount[VK_MAX_MEMORY_TYPES]{};
+    VkDeviceSize m_DedicatedBytes[VK_MAX_MEMORY_TYPES]{};
+};
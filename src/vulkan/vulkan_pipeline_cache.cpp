@@ -0,0 +1,158 @@
+#include "vulkan_pipeline_cache.h"
+#include "vulkan_utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+static bool IsCompatible(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties)
+{
+    VkPipelineCacheHeaderVersionOne header{};
+    if (data.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+    return header.headerSize >= sizeof(header) && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+           && header.vendorID == properties.vendorID && header.deviceID == properties.deviceID
+           && std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VulkanPipelineCache::VulkanPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::optional<std::string>& directory)
+    : m_Device(device)
+{
+    std::vector<char> data;
+    if (directory)
+    {
+        std::ostringstream name;
+        name << "pipeline_cache_" << std::hex << properties.vendorID << "_" << properties.deviceID << ".bin";
+        m_Path = (std::filesystem::path(*directory) / name.str()).string();
+
+        std::ifstream file(m_Path, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (!IsCompatible(data, properties))
+            data.clear();
+    }
+
+    VkPipelineCacheCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.initialDataSize = data.size();
+    info.pInitialData = data.empty() ? nullptr : data.data();
+    VK_CHECK_RESULT(vkCreatePipelineCache(m_Device, &info, nullptr, &m_Cache));
+    m_LoadedSize = data.size();
+}
+
+VulkanPipelineCache::~VulkanPipelineCache()
+{
+    Save();
+    vkDestroyPipelineCache(m_Device, m_Cache, nullptr);
+}
+
+void VulkanPipelineCache::Save()
+{
+    if (m_Path.empty())
+        return;
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(m_Device, m_Cache, &size, nullptr) != VK_SUCCESS || size == m_LoadedSize)
+        return;
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(m_Device, m_Cache, &size, data.data()) != VK_SUCCESS)
+        return;
+    data.resize(size);
+
+    // Runs from a destructor, a cache that can't be written is only reported
+    const std::string temporaryPath = m_Path + "." + std::to_string(std::random_device{}()) + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), std::streamsize(data.size()));
+        if (!file)
+        {
+            std::cerr << "Failed to write the pipeline cache " << temporaryPath << std::endl;
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, m_Path, error);
+    if (error)
+    {
+        std::cerr << "Failed to replace the pipeline cache " << m_Path << ": " << error.message() << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
+
+void VulkanPipelineCache::CreateComputePipeline(const VkComputePipelineCreateInfo& info, VkPipeline* pipeline)
+{
+    if (!m_Batching)
+    {
+        VK_CHECK_RESULT(vkCreateComputePipelines(m_Device, m_Cache, 1, &info, nullptr, pipeline));
+        return;
+    }
+
+    PendingPipeline pending;
+    pending.Info = info;
+    pending.EntryPoint = info.stage.pName;
+    if (const VkSpecializationInfo* specialization = info.stage.pSpecializationInfo)
+    {
+        pending.Specialization = *specialization;
+        pending.MapEntries.assign(specialization->pMapEntries, specialization->pMapEntries + specialization->mapEntryCount);
+        const auto* data = static_cast<const uint8_t*>(specialization->pData);
+        pending.SpecializationData.assign(data, data + specialization->dataSize);
+    }
+    pending.Pipeline = pipeline;
+    m_Pending.push_back(std::move(pending));
+}
+
+void VulkanPipelineCache::BeginBatch()
+{
+    m_Batching = true;
+}
+
+void VulkanPipelineCache::EndBatch()
+{
+    m_Batching = false;
+
+    // Point the copies at their own storage, m_Pending no longer moves
+    for (PendingPipeline& pending : m_Pending)
+    {
+        pending.Info.stage.pName = pending.EntryPoint.c_str();
+        if (pending.Info.stage.pSpecializationInfo != nullptr)
+        {
+            pending.Specialization.pMapEntries = pending.MapEntries.data();
+            pending.Specialization.pData = pending.SpecializationData.data();
+            pending.Info.stage.pSpecializationInfo = &pending.Specialization;
+        }
+    }
+
+    std::vector<VkResult> results(m_Pending.size(), VK_SUCCESS);
+    std::atomic<size_t> next{ 0 };
+    auto compile = [&]
+    {
+        for (size_t i = next++; i < m_Pending.size(); i = next++)
+            results[i] = vkCreateComputePipelines(m_Device, m_Cache, 1, &m_Pending[i].Info, nullptr, m_Pending[i].Pipeline);
+    };
+
+    // The calling thread compiles too
+    const size_t threadCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), m_Pending.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; ++i)
+        threads.emplace_back(compile);
+    compile();
+    for (auto& thread : threads)
+        thread.join();
+
+    m_Pending.clear();
+    for (VkResult result : results)
+        VK_CHECK_RESULT(result);
+}
+
+void VulkanPipelineCache::DiscardBatch()
+{
+    m_Batching = false;
+    m_Pending.clear();
+}
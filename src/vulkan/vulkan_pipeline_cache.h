@@ -0,0 +1,75 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// VkPipelineCache kept in a file per device, plus batched compute pipeline creation.
+// The file is used at startup only when its VkPipelineCacheHeaderVersionOne matches the
+// device: vendor, device and pipelineCacheUUID, which changes with the driver. It is
+// written back at destruction when pipelines were added, through a temporary file and
+// a rename so processes starting at the same time never read a torn cache.
+class VulkanPipelineCache
+{
+public:
+    // Without a directory the cache is kept in memory only. An empty one is the current
+    // directory.
+    VulkanPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::optional<std::string>& directory);
+    ~VulkanPipelineCache();
+
+    VulkanPipelineCache(const VulkanPipelineCache&) = delete;
+    VulkanPipelineCache& operator=(const VulkanPipelineCache&) = delete;
+
+    // Creates the pipeline against the cache. While a batch is open it is only recorded
+    // and *pipeline is written by EndBatch, nothing may use it before.
+    void CreateComputePipeline(const VkComputePipelineCreateInfo& info, VkPipeline* pipeline);
+    void BeginBatch();
+    // Compiles the recorded pipelines on worker threads; the cache is internally
+    // synchronized, so they all share it
+    void EndBatch();
+    // Forgets the recorded pipelines, for owners that threw before EndBatch
+    void DiscardBatch();
+
+    [[nodiscard]] VkPipelineCache GetCache() const { return m_Cache; }
+    // Bytes of cache data accepted from the file, 0 when it was missing or stale
+    [[nodiscard]] size_t GetLoadedSize() const { return m_LoadedSize; }
+
+private:
+    // A create info with everything it points at copied, so the caller's may go away
+    struct PendingPipeline
+    {
+        VkComputePipelineCreateInfo Info{};
+        std::string EntryPoint;
+        VkSpecializationInfo Specialization{};
+        std::vector<VkSpecializationMapEntry> MapEntries;
+        std::vector<uint8_t> SpecializationData;
+        VkPipeline* Pipeline = nullptr;
+    };
+
+    void Save();
+
+    VkDevice m_Device;
+    std::string m_Path;
+    VkPipelineCache m_Cache = VK_NULL_HANDLE;
+    size_t m_LoadedSize = 0;
+    bool m_Batching = false;
+    std::vector<PendingPipeline> m_Pending;
+};
+
+// Batches the pipelines created on the cache while it lives. Create() compiles them;
+// a scope left without it, by a throw, discards them.
+class ScopedPipelineBatch
+{
+public:
+    explicit ScopedPipelineBatch(VulkanPipelineCache& cache) : m_Cache(cache) { m_Cache.BeginBatch(); }
+    ~ScopedPipelineBatch() { m_Cache.DiscardBatch(); }
+
+    ScopedPipelineBatch(const ScopedPipelineBatch&) = delete;
+    ScopedPipelineBatch& operator=(const ScopedPipelineBatch&) = delete;
+
+    void Create() { m_Cache.EndBatch(); }
+
+private:
+    VulkanPipelineCache& m_Cache;
+};
@@ -0,0 +1,111 @@
+#include "vulkan_queue.h"
+#include "vulkan_utils.h"
+
+#include <cassert>
+
+bool QueueTicket::IsComplete() const
+{
+    return Value == 0 || Queue->IsComplete(Value);
+}
+
+void QueueTicket::Wait() const
+{
+    if (Value != 0)
+        Queue->Wait(Value);
+}
+
+VulkanQueue::VulkanQueue(VkDevice device, VkQueue queue, uint32_t familyIndex)
+    : m_Device(device), m_Queue(queue), m_FamilyIndex(familyIndex)
+{
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    info.pNext = &typeInfo;
+    VK_CHECK_RESULT(vkCreateSemaphore(m_Device, &info, nullptr, &m_Timeline));
+}
+
+VulkanQueue::~VulkanQueue()
+{
+    WaitIdle();
+    vkDestroySemaphore(m_Device, m_Timeline, nullptr);
+}
+
+QueueTicket VulkanQueue::Submit(VkCommandBuffer commandBuffer, const std::vector<SemaphoreWait>& waits)
+{
+    return Submit(&commandBuffer, 1, waits);
+}
+
+QueueTicket VulkanQueue::Submit(const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount, const std::vector<SemaphoreWait>& waits)
+{
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStages;
+    for (const auto& wait : waits)
+    {
+        waitSemaphores.push_back(wait.Semaphore);
+        waitValues.push_back(wait.Value);
+        waitStages.push_back(wait.Stage);
+    }
+
+    std::lock_guard<std::mutex> lock(m_SubmitMutex);
+    uint64_t signalValue = m_LastSubmitted.load(std::memory_order_relaxed) + 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = commandBufferCount;
+    submitInfo.pCommandBuffers = commandBuffers;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_Timeline;
+    VK_CHECK_RESULT(vkQueueSubmit(m_Queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+    m_LastSubmitted.store(signalValue, std::memory_order_release);
+    return { this, signalValue };
+}
+
+uint64_t VulkanQueue::GetCompletedValue() const
+{
+    uint64_t value = 0;
+    VK_CHECK_RESULT(vkGetSemaphoreCounterValue(m_Device, m_Timeline, &value));
+
+    uint64_t known = m_Completed.load(std::memory_order_relaxed);
+    while (known < value && !m_Completed.compare_exchange_weak(known, value, std::memory_order_relaxed)) {}
+    return value;
+}
+
+bool VulkanQueue::IsComplete(uint64_t value) const
+{
+    if (value <= m_Completed.load(std::memory_order_relaxed))
+        return true;
+    return GetCompletedValue() >= value;
+}
+
+void VulkanQueue::Wait(uint64_t value) const
+{
+    if (IsComplete(value))
+        return;
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_Timeline;
+    waitInfo.pValues = &value;
+    VK_CHECK_RESULT(vkWaitSemaphores(m_Device, &waitInfo, UINT64_MAX));
+
+    uint64_t known = m_Completed.load(std::memory_order_relaxed);
+    while (known < value && !m_Completed.compare_exchange_weak(known, value, std::memory_order_relaxed)) {}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+class VulkanQueue;
+
+// Point on a queue's timeline. Value 0 is always complete, so a default constructed
+// ticket stands for work that needs no waiting.
+struct QueueTicket
+{
+    const VulkanQueue* Queue = nullptr;
+    uint64_t Value = 0;
+
+    [[nodiscard]] bool IsComplete() const;
+    void Wait() const;
+};
+
+struct SemaphoreWait
+{
+    VkSemaphore Semaphore;
+    uint64_t Value;
+    VkPipelineStageFlags Stage;
+};
+
+// VkQueue plus a timeline semaphore that every submission signals with the next
+// value. Callers wait on the value of the work they depend on instead of draining the
+// whole queue, and recycle resources once the completed value has passed them.
+// Submission is serialized internally, so any thread may submit.
+class VulkanQueue
+{
+public:
+    VulkanQueue(VkDevice device, VkQueue queue, uint32_t familyIndex);
+    ~VulkanQueue();
+
+    VulkanQueue(const VulkanQueue&) = delete;
+    VulkanQueue& operator=(const VulkanQueue&) = delete;
+
+    QueueTicket Submit(VkCommandBuffer commandBuffer, const std::vector<SemaphoreWait>& waits = {});
+    QueueTicket Submit(const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount, const std::vector<SemaphoreWait>& waits = {});
+
+    [[nodiscard]] bool IsComplete(uint64_t value) const;
+    void Wait(uint64_t value) const;
+    // Waits for everything submitted so far
+    void WaitIdle() const { Wait(m_LastSubmitted.load(std::memory_order_acquire)); }
+
+    [[nodiscard]] uint64_t GetCompletedValue() const;
+    [[nodiscard]] uint64_t GetLastSubmittedValue() const { return m_LastSubmitted.load(std::memory_order_acquire); }
+
+    [[nodiscard]] VkQueue GetQueue() const { return m_Queue; }
+    [[nodiscard]] uint32_t GetFamilyIndex() const { return m_FamilyIndex; }
+    [[nodiscard]] VkSemaphore GetTimeline() const { return m_Timeline; }
+
+private:
+    VkDevice m_Device;
+    VkQueue m_Queue;
+    uint32_t m_FamilyIndex;
+    VkSemaphore m_Timeline = VK_NULL_HANDLE;
+
+    std::mutex m_SubmitMutex;
+    std::atomic<uint64_t> m_LastSubmitted{0};
+    // Last value seen signalled, saves a driver call for tickets known to be done
+    mutable std::atomic<uint64_t> m_Completed{0};
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+// A SPIR-V module compiled into the executable
+struct EmbeddedShader
+{
+    // File name the build compiled it to, e.g. "nis_sharpen_fp32_glsl.spv"
+    const char* Name;
+    const uint32_t* Code;
+    size_t WordCount;
+};
+
+// Every shader of the build, generated from the .spv files by cmake/EmbedSPIRV.cmake
+extern const EmbeddedShader EmbeddedShaders[];
+extern const size_t EmbeddedShaderCount;
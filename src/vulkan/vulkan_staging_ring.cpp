@@ -0,0 +1,211 @@
+#include "vulkan_staging_ring.h"
+#include "vulkan_device.h"
+#include "vulkan_utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+VulkanStagingRing::VulkanStagingRing(VulkanDevice& device, VkBufferUsageFlags usage, MemoryUsage memoryUsage, VkDeviceSize blockSize)
+    : m_Device(device), m_Usage(usage), m_MemoryUsage(memoryUsage), m_BlockSize(blockSize)
+{
+    const VkPhysicalDeviceLimits& limits = device.PhysicalDeviceProperties.limits;
+    // Copy offsets must also be a multiple of the texel size (4 bytes for RGBA8)
+    m_OffsetAlignment = std::lcm<VkDeviceSize>(std::max<VkDeviceSize>(limits.optimalBufferCopyOffsetAlignment, 1), 4);
+    m_RowPitchAlignment = std::max<VkDeviceSize>(limits.optimalBufferCopyRowPitchAlignment, 1);
+    CreateBlock(m_BlockSize);
+}
+
+VulkanStagingRing::~VulkanStagingRing()
+{
+    for (auto& block : m_Blocks)
+        m_Device.DestroyBuffer(block.Buffer, block.Memory);
+}
+
+void VulkanStagingRing::CreateBlock(VkDeviceSize size)
+{
+    Block block;
+    block.Size = size;
+    m_Device.CreateBuffer(size, m_Usage, m_MemoryUsage, block.Buffer, block.Memory);
+    block.Mapped = static_cast<uint8_t*>(block.Memory.Mapped);
+    m_Blocks.push_back(std::move(block));
+}
+
+uint32_t VulkanStagingRing::GetRowPitch(uint32_t width, uint32_t bytesPerPixel) const
+{
+    return static_cast<uint32_t>(AlignUp(VkDeviceSize(width) * bytesPerPixel, std::lcm<VkDeviceSize>(m_RowPitchAlignment, bytesPerPixel)));
+}
+
+void VulkanStagingRing::Reclaim(Block& block)
+{
+    // Regions free up strictly in allocation order so the live range stays contiguous
+    while (!block.Regions.empty())
+    {
+        Region& front = block.Regions.front();
+        if (!front.Released)
+            break;
+        if (!front.Ticket.IsComplete())
+            break;
+        block.Regions.pop_front();
+    }
+
+    if (block.Regions.empty())
+        block.Head = 0;
+}
+
+bool VulkanStagingRing::TryAllocate(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset) const
+{
+    if (size > block.Size)
+        return false;
+
+    if (block.Regions.empty())
+    {
+        outOffset = 0;
+        return true;
+    }
+
+    VkDeviceSize tail = block.Regions.front().Offset;
+    VkDeviceSize offset = AlignUp(block.Head, alignment);
+    if (tail < block.Head)
+    {
+        // Live range is [tail, head): use the space after it, or wrap to the start
+        if (offset + size <= block.Size)
+        {
+            outOffset = offset;
+            return true;
+        }
+        if (size <= tail)
+        {
+            outOffset = 0;
+            return true;
+        }
+        return false;
+    }
+
+    // Wrapped, live range is [tail, end) + [0, head): only the gap in between is free
+    if (offset + size <= tail)
+    {
+        outOffset = offset;
+        return true;
+    }
+    return false;
+}
+
+StagingAllocation VulkanStagingRing::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    assert(size > 0);
+    alignment = std::lcm(std::max<VkDeviceSize>(alignment, 1), m_OffsetAlignment);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    VkDeviceSize offset = 0;
+    auto blockCount = static_cast<uint32_t>(m_Blocks.size());
+    uint32_t blockIndex = blockCount;
+    for (uint32_t i = 0; i < blockCount; ++i)
+    {
+        uint32_t candidate = (m_CurrentBlock + i) % blockCount;
+        Reclaim(m_Blocks[candidate]);
+        if (TryAllocate(m_Blocks[candidate], size, alignment, offset))
+        {
+            blockIndex = candidate;
+            break;
+        }
+    }
+
+    if (blockIndex == blockCount)
+    {
+        CreateBlock(std::max(m_BlockSize, AlignUp(size, m_OffsetAlignment)));
+        offset = 0;
+    }
+
+    m_CurrentBlock = blockIndex;
+    Block& block = m_Blocks[blockIndex];
+    block.Head = offset + size;
+    block.Regions.push_back({ m_NextId, offset, {}, false });
+
+    StagingAllocation allocation;
+    allocation.Buffer = block.Buffer;
+    allocation.Offset = offset;
+    allocation.Size = size;
+    allocation.Mapped = block.Mapped + offset;
+    allocation.Block = blockIndex;
+    allocation.Id = m_NextId++;
+    return allocation;
+}
+
+void VulkanStagingRing::Release(const StagingAllocation& allocation, const QueueTicket& ticket)
+{
+    if (!allocation.IsValid())
+        return;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    Block& block = m_Blocks[allocation.Block];
+    auto it = std::find_if(block.Regions.begin(), block.Regions.end(),
+                           [&](const Region& region) { return region.Id == allocation.Id; });
+    assert(it != block.Regions.end() && "Released a staging region twice");
+    it->Ticket = ticket;
+    it->Released = true;
+}
+
+void VulkanStagingRing::Flush(const StagingAllocation& allocation) const
+{
+    if (!allocation.IsValid())
+        return;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    VK_CHECK_RESULT(m_Device.GetAllocator().Flush(m_Blocks[allocation.Block].Memory, allocation.Offset, allocation.Size));
+}
+
+void VulkanStagingRing::Invalidate(const StagingAllocation& allocation) const
+{
+    if (!allocation.IsValid())
+        return;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    VK_CHECK_RESULT(m_Device.GetAllocator().Invalidate(m_Blocks[allocation.Block].Memory, allocation.Offset, allocation.Size));
+}
+
+VkDeviceSize VulkanStagingRing::GetCapacity() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    VkDeviceSize capacity = 0;
+    for (const auto& block : m_Blocks)
+        capacity += block.Size;
+    return capacity;
+}
+
+size_t VulkanStagingRing::GetBlockCount() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Blocks.size();
+}
+
+StagingHandle& StagingHandle::operator=(StagingHandle&& other) noexcept
+{
+    if (this != &other)
+    {
+        Reset();
+        m_Ring = other.m_Ring;
+        m_Allocation = other.Detach();
+    }
+    return *this;
+}
+
+StagingAllocation StagingHandle::Detach()
+{
+    StagingAllocation allocation = m_Allocation;
+    m_Allocation = {};
+    return allocation;
+}
+
+void StagingHandle::Reset()
+{
+    if (m_Allocation.IsValid())
+        m_Ring->Release(m_Allocation);
+    m_Allocation = {};
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan_memory_allocator.h"
+#include "vulkan_queue.h"
+
+class VulkanDevice;
+
+// Region of a staging ring handed out for one transfer. Mapped points at Offset.
+struct StagingAllocation
+{
+    VkBuffer Buffer = VK_NULL_HANDLE;
+    VkDeviceSize Offset = 0;
+    VkDeviceSize Size = 0;
+    void* Mapped = nullptr;
+
+    uint32_t Block = 0;
+    uint64_t Id = 0;
+
+    [[nodiscard]] bool IsValid() const { return Buffer != VK_NULL_HANDLE; }
+};
+
+class VulkanStagingRing;
+
+// Owns a staging region until Detach() hands it on, releasing it as unused otherwise.
+// For regions filled on the host long before a submission picks them up.
+class StagingHandle
+{
+public:
+    StagingHandle() = default;
+    StagingHandle(VulkanStagingRing& ring, const StagingAllocation& allocation) : m_Ring(&ring), m_Allocation(allocation) {}
+    ~StagingHandle() { Reset(); }
+
+    StagingHandle(StagingHandle&& other) noexcept { *this = std::move(other); }
+    StagingHandle& operator=(StagingHandle&& other) noexcept;
+    StagingHandle(const StagingHandle&) = delete;
+    StagingHandle& operator=(const StagingHandle&) = delete;
+
+    [[nodiscard]] const StagingAllocation& Get() const { return m_Allocation; }
+    [[nodiscard]] explicit operator bool() const { return m_Allocation.IsValid(); }
+    // The caller becomes responsible for releasing the region
+    StagingAllocation Detach();
+    void Reset();
+
+private:
+    VulkanStagingRing* m_Ring = nullptr;
+    StagingAllocation m_Allocation;
+};
+
+// Persistently mapped host visible memory that is sub-allocated linearly, wrapping
+// around like a ring. Regions are given back with the ticket of the submission that
+// reads or writes them and become reusable once that ticket has completed, in
+// allocation order. A request that does not fit anywhere adds another block, so the
+// ring only grows to the working set of the images actually in flight. The memory
+// type follows the usage, so readback rings land in cached memory where available.
+class VulkanStagingRing
+{
+public:
+    VulkanStagingRing(VulkanDevice& device, VkBufferUsageFlags usage, MemoryUsage memoryUsage, VkDeviceSize blockSize);
+    ~VulkanStagingRing();
+
+    VulkanStagingRing(const VulkanStagingRing&) = delete;
+    VulkanStagingRing& operator=(const VulkanStagingRing&) = delete;
+
+    // Offsets are aligned to at least optimalBufferCopyOffsetAlignment and the texel size.
+    StagingAllocation Allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+    // An empty ticket releases a region whose transfer is already known to be complete.
+    void Release(const StagingAllocation& allocation, const QueueTicket& ticket = {});
+    // Make host writes visible to the device before submitting, and device writes
+    // visible to the host before reading. No-ops on coherent memory.
+    void Flush(const StagingAllocation& allocation) const;
+    void Invalidate(const StagingAllocation& allocation) const;
+    // Row pitch to use for a copy of the given width, aligned to optimalBufferCopyRowPitchAlignment.
+    [[nodiscard]] uint32_t GetRowPitch(uint32_t width, uint32_t bytesPerPixel) const;
+
+    [[nodiscard]] VkDeviceSize GetCapacity() const;
+    [[nodiscard]] size_t GetBlockCount() const;
+
+private:
+    struct Region
+    {
+        uint64_t Id;
+        VkDeviceSize Offset;
+        QueueTicket Ticket;
+        bool Released;
+    };
+
+    struct Block
+    {
+        VkBuffer Buffer = VK_NULL_HANDLE;
+        MemoryAllocation Memory;
+        uint8_t* Mapped = nullptr;
+        VkDeviceSize Size = 0;
+        VkDeviceSize Head = 0;
+        std::deque<Region> Regions;
+    };
+
+    bool TryAllocate(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset) const;
+    void Reclaim(Block& block);
+    void CreateBlock(VkDeviceSize size);
+
+    VulkanDevice& m_Device;
+    VkBufferUsageFlags m_Usage;
+    MemoryUsage m_MemoryUsage;
+    VkDeviceSize m_BlockSize;
+    VkDeviceSize m_OffsetAlignment;
+    VkDeviceSize m_RowPitchAlignment;
+
+    mutable std::mutex m_Mutex;
+    std::vector<Block> m_Blocks;
+    uint32_t m_CurrentBlock = 0;
+    uint64_t m_NextId = 1;
+};